@@ -243,4 +243,23 @@ void	DSFGetWriterCallbacks(DSFCallbacks_t * ioCallbacks);
 void	DSFWriteToFile(const char * inPath, void * inRef);
 void	DSFDestroyWriter(void * inRef);
 
+/*
+ * Patch primitive generation.  The writer rebuilds every patch's triangles before
+ * encoding them; these pick how.  Strips are the smallest on disk, cache-ordered
+ * triangles are the cheapest for the sim to draw.  Writers default to the old
+ * tri_stripper, so existing output doesn't change unless a tool opts in.
+ *
+ * With stats on, DSFWriteToFile prints primitive counts and command-atom bytes per
+ * command type.
+ *
+ */
+enum {
+	dsf_PatchPrims_Strip = 0,		/* Linear-time greedy strips, loose tris batched	*/
+	dsf_PatchPrims_CacheTris,		/* Plain triangles, vertex-cache ordered			*/
+	dsf_PatchPrims_TriStripper		/* The tri_stripper library						*/
+};
+
+void	DSFSetWriterPatchPrimitives(void * inRef, int inMode);
+void	DSFSetWriterStats(void * inRef, int inStats);
+
 #endif
@@ -45,6 +45,11 @@
 // Define this to 1 to see statistics about the encoded DSF file.
 #define ENCODING_STATS 0
 
+// Define this to 1 to see how many command bytes each command type takes.  DSFSetWriterStats turns both on at runtime.
+#ifndef DSF_WRITE_STATS
+#define DSF_WRITE_STATS 0
+#endif
+
 #if BIG
 	#if APL
 		#include <libkern/OSByteOrder.h>
@@ -176,6 +181,8 @@ public:
 	double	mElevMax;
 	
 	int					mCurrentFilter;
+	int					mPatchPrims;		// dsf_PatchPrims_ mode for rebuilding patch triangles
+	int					mPrintStats;
 
 	vector<string>		terrainDefs;
 	vector<string>		objectDefs;
@@ -395,6 +402,16 @@ void	DSFDestroyWriter(void * inRef)
 	DSFFileWriterImp * imp = (DSFFileWriterImp *) inRef;
 	delete imp;
 }
+void	DSFSetWriterPatchPrimitives(void * inRef, int inMode)
+{
+	REF(inRef)->mPatchPrims = inMode;
+}
+
+void	DSFSetWriterStats(void * inRef, int inStats)
+{
+	REF(inRef)->mPrintStats = inStats;
+}
+
 void	DSFGetWriterCallbacks(DSFCallbacks_t * ioCallbacks)
 {
 	ioCallbacks->AcceptTerrainDef_f = DSFFileWriterImp::AcceptTerrainDef;
@@ -436,6 +453,8 @@ DSFFileWriterImp::DSFFileWriterImp(double inWest, double inSouth, double inEast,
 	mElevMin = inElevMin;
 	mElevMax = inElevMax;
 	mCurrentFilter = -1;
+	mPatchPrims = dsf_PatchPrims_TriStripper;
+	mPrintStats = 0;
 
 	// BUILD VECTOR POOLS
 	DSFTuple	vecRangeMin, vecRangeMax;
@@ -750,28 +769,29 @@ void DSFFileWriterImp::WriteToFile(const char * inPath)
 	ObjectSpecVector::iterator			objSpec;
 	ChainSpecIndex::iterator			csIndex;
 
-#if ENCODING_STATS
 	// Start by outputing some stats on our primitives - useful to test how the optimizer is doing!
-	int num_prim = 0;
-	int num_strip = 0;
-	int num_fan = 0;
-	int num_v = 0;
-	int num_strip_v = 0;
-	int num_fan_v = 0;
-
-	for(patchSpec = patches.begin(); patchSpec != patches.end(); ++patchSpec)
-	for(primIter = patchSpec->primitives.begin(); primIter != patchSpec->primitives.end(); ++primIter)
+	if(ENCODING_STATS || mPrintStats)
 	{
-											++num_prim;
-		if(primIter->type == dsf_TriStrip)	++num_strip;
-		if(primIter->type == dsf_TriFan  )	++num_fan;
-											num_v += primIter->vertices.size();
-		if(primIter->type == dsf_TriStrip)	num_strip_v += primIter->vertices.size();
-		if(primIter->type == dsf_TriFan  )	num_fan_v += primIter->vertices.size();
+		int num_prim = 0;
+		int num_strip = 0;
+		int num_fan = 0;
+		int num_v = 0;
+		int num_strip_v = 0;
+		int num_fan_v = 0;
+
+		for(patchSpec = patches.begin(); patchSpec != patches.end(); ++patchSpec)
+		for(primIter = patchSpec->primitives.begin(); primIter != patchSpec->primitives.end(); ++primIter)
+		{
+												++num_prim;
+			if(primIter->type == dsf_TriStrip)	++num_strip;
+			if(primIter->type == dsf_TriFan  )	++num_fan;
+												num_v += primIter->vertices.size();
+			if(primIter->type == dsf_TriStrip)	num_strip_v += primIter->vertices.size();
+			if(primIter->type == dsf_TriFan  )	num_fan_v += primIter->vertices.size();
+		}
+		printf("Vertices: total = %d, strip = %d, fan = %d.\n",num_v,num_strip_v, num_fan_v);
+		printf("Primitives: total = %d, strip = %d, fan = %d.\n", num_prim, num_strip, num_fan);
 	}
-	printf("Vertices: total = %d, strip = %d, fan = %d.\n",num_v,num_strip_v, num_fan_v);
-	printf("Primitives: total = %d, strip = %d, fan = %d.\n", num_prim, num_strip, num_fan);
-#endif
 
 	// Build up a list of all primitives, sorted by depth
 	TPVM	all_primitives;
@@ -1518,30 +1538,30 @@ void DSFFileWriterImp::WriteToFile(const char * inPath)
 	noCrappyFiles.release();
 	fclose(fi);
 
-	#if DSF_WRITE_STATS
-	
-	fi = fopen(inPath,"r");
-	
-	fseek(fi,cmnd_start,SEEK_SET);
-	
-	XAtomHeader_t	h;
-	fread(&h,sizeof(h),1,fi);
-	h.id = SWAP32(h.id);
-	h.length = SWAP32(h.length);
-	
-	char * buf = (char *) malloc(h.length);
-	fread(buf,h.length,1,fi);
-	fclose(fi);
-	
-	XAtomPackedData cmdsAtom;
-	cmdsAtom.begin = buf - sizeof(XAtomHeader_t);
-	cmdsAtom.position = buf;
-	cmdsAtom.end = cmdsAtom.begin + h.length;
-	analyze_cmd_mem_use(cmdsAtom);
-	
-	free(buf);
+	if(DSF_WRITE_STATS || mPrintStats)
+	{
+		fi = fopen(inPath,"rb");
 
-	#endif
+		fseek(fi,cmnd_start,SEEK_SET);
+
+		XAtomHeader_t	h;
+		fread(&h,sizeof(h),1,fi);
+		h.id = SWAP32(h.id);
+		h.length = SWAP32(h.length);
+
+		char * buf = (char *) malloc(h.length);
+		fread(buf,h.length,1,fi);
+		fclose(fi);
+
+		XAtomPackedData cmdsAtom;
+		cmdsAtom.begin = buf - sizeof(XAtomHeader_t);
+		cmdsAtom.position = buf;
+		cmdsAtom.end = cmdsAtom.begin + h.length;
+		printf("%s: command atom is %d bytes.\n", inPath, h.length);
+		analyze_cmd_mem_use(cmdsAtom);
+
+		free(buf);
+	}
 
 	DSFSignMD5(inPath);
 }
@@ -1702,7 +1722,7 @@ void	DSFFileWriterImp::EndPatch(
 		}
 
 		me->primitives.clear();
-		DSFOptimizePrimitives(prims);
+		DSFOptimizePrimitives(prims, REF(inRef)->mPatchPrims);
 		for(vector<DSFPrimitive>::iterator pp = prims.begin(); pp != prims.end(); ++pp)
 		{
 			me->primitives.push_back(TriPrimitive());
@@ -33,6 +33,7 @@
 #include "tri_stripper.h"
 using namespace	triangle_stripper;
 #endif
+#include "VertexCacheUtils.h"
 #include <utility>
 using std::pair;
 
@@ -643,8 +644,158 @@ static unsigned short * strip_break(unsigned short * idx_start, unsigned short *
 	return idx_start;
 }
 
+// Emits plain triangles in batches that fit a single DSF triangle command.
+static void emit_tri_batches(const vector<unsigned int>& tris, const vector<DSFTuple>& vertices, vector<DSFPrimitive>& out_prims)
+{
+	for(int offset = 0; offset < tris.size(); )
+	{
+		int num = min(tris.size() - offset, (size_t)255);
+		out_prims.push_back(DSFPrimitive());
+		out_prims.back().kind = dsf_Tri;
+		while(num--)
+			out_prims.back().vertices.push_back(vertices[tris[offset++]]);
+	}
+}
+
+/*
+	Greedy strip builder: find each tri's neighbor across every edge by sorting the edges, then walk
+	tris in input order, starting a strip at each unused one and extending it across the shared edge of
+	its last two vertices for as long as the next tri is unused and winds the right way.  Nothing is ever
+	revisited, so after the sort it is linear.  Strips of one tri go into plain triangle batches.
+*/
+template <class IDX>
+static void strip_tris(const vector<IDX>& indices, const vector<DSFTuple>& vertices, vector<DSFPrimitive>& out_prims)
+{
+	int tri_count = indices.size() / 3;
+	vector<unsigned int>	loose;
+
+	typedef pair<unsigned long long, int>	edge_t;			// sorted vertex pair, half-edge (tri * 3 + edge)
+	vector<edge_t>	edges;
+	edges.reserve(indices.size());
+	for(int t = 0; t < tri_count; ++t)
+	{
+		const IDX * v = &indices[t*3];
+		if(v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+			continue;
+		for(int k = 0; k < 3; ++k)
+		{
+			unsigned long long a = v[k], b = v[(k+1)%3];
+			edges.push_back(edge_t(a < b ? (a << 32) | b : (b << 32) | a, t*3+k));
+		}
+	}
+	sort(edges.begin(), edges.end());
+
+	// Only a manifold edge walked in opposite directions links two tris - anything else is a strip boundary.
+	vector<int>	neighbor(indices.size(), -1);
+	for(int e = 0; e < edges.size(); )
+	{
+		int g = e + 1;
+		while(g < edges.size() && edges[g].first == edges[e].first) ++g;
+		if(g - e == 2)
+		{
+			int h1 = edges[e].second, h2 = edges[e+1].second;
+			if(indices[h1] == indices[(h2/3)*3 + (h2%3+1)%3])
+			{
+				neighbor[h1] = h2 / 3;
+				neighbor[h2] = h1 / 3;
+			}
+		}
+		e = g;
+	}
+
+	vector<char>	used(tri_count, 0);
+	vector<unsigned int>	strip;
+	for(int t = 0; t < tri_count; ++t)
+	if(!used[t])
+	{
+		const IDX * v = &indices[t*3];
+		used[t] = 1;
+		if(v[0] == v[1] || v[1] == v[2] || v[0] == v[2])
+		{
+			loose.insert(loose.end(), v, v+3);
+			continue;
+		}
+
+		// Rotate the first tri so the edge we leave by has an unused neighbor.
+		int r = 0;
+		for(int k = 0; k < 3; ++k)
+		{
+			int n = neighbor[t*3+(k+1)%3];
+			if(n != -1 && !used[n]) { r = k; break; }
+		}
+
+		strip.clear();
+		strip.push_back(v[r]);
+		strip.push_back(v[(r+1)%3]);
+		strip.push_back(v[(r+2)%3]);
+
+		int cur = t;
+		while(strip.size() < 255)
+		{
+			unsigned int p = strip[strip.size()-2], q = strip[strip.size()-1];
+			int next = -1, k;
+			for(k = 0; k < 3; ++k)
+			{
+				unsigned int a = indices[cur*3+k], b = indices[cur*3+(k+1)%3];
+				if((a == p && b == q) || (a == q && b == p))
+				{
+					next = neighbor[cur*3+k];
+					break;
+				}
+			}
+			if(next == -1 || used[next]) break;
+
+			// Odd tris in a strip are wound (q, p, w), even ones (p, q, w) - check that matches the tri's own winding.
+			const IDX * nv = &indices[next*3];
+			int odd = strip.size() % 2 == 1;
+			unsigned int first = odd ? q : p, second = odd ? p : q;
+			int s;
+			for(s = 0; s < 3; ++s)
+				if(nv[s] == first && nv[(s+1)%3] == second) break;
+			if(s == 3) break;
+
+			strip.push_back(nv[(s+2)%3]);
+			used[next] = 1;
+			cur = next;
+		}
+
+		if(strip.size() == 3)
+			loose.insert(loose.end(), strip.begin(), strip.end());
+		else
+		{
+			out_prims.push_back(DSFPrimitive());
+			out_prims.back().kind = dsf_TriStrip;
+			for(vector<unsigned int>::iterator i = strip.begin(); i != strip.end(); ++i)
+				out_prims.back().vertices.push_back(vertices[*i]);
+		}
+	}
+
+	emit_tri_batches(loose, vertices, out_prims);
+}
+
+// Plain triangles, reordered for the post-transform vertex cache.  Degenerate tris are kept, at the end.
+template <class IDX>
+static void cache_order_tris(const vector<IDX>& indices, const vector<DSFTuple>& vertices, vector<DSFPrimitive>& out_prims)
+{
+	vector<int>	ok;
+	vector<unsigned int> tris;
+	for(int n = 0; n + 2 < indices.size(); n += 3)
+	if(indices[n] != indices[n+1] && indices[n+1] != indices[n+2] && indices[n] != indices[n+2])
+		ok.insert(ok.end(), &indices[n], &indices[n] + 3);
+
+	VCACHE_OrderTris(ok);
+
+	tris.assign(ok.begin(), ok.end());
+	for(int n = 0; n + 2 < indices.size(); n += 3)
+	if(indices[n] == indices[n+1] || indices[n+1] == indices[n+2] || indices[n] == indices[n+2])
+		tris.insert(tris.end(), &indices[n], &indices[n] + 3);
+
+	emit_tri_batches(tris, vertices, out_prims);
+}
+
 void DSFOptimizePrimitives(
-					vector<DSFPrimitive>& io_primitives)
+					vector<DSFPrimitive>& io_primitives,
+					int					  inMode)
 {
 	typedef	hash_map<DSFTuple, int>		idx_t;
 	vector<DSFPrimitive>				out_prims;
@@ -678,6 +829,19 @@ void DSFOptimizePrimitives(
 
 //	printf("input: %d indices.\n", indices.size());
 
+	if(inMode == dsf_PatchPrims_Strip)
+	{
+		strip_tris(indices, vertices, out_prims);
+		swap(io_primitives,out_prims);
+		return;
+	}
+	if(inMode == dsf_PatchPrims_CacheTris)
+	{
+		cache_order_tris(indices, vertices, out_prims);
+		swap(io_primitives,out_prims);
+		return;
+	}
+
 #if !USE_PVRTC
 	tri_stripper stripper_thingie(indices);
 	tri_stripper::primitives_vector	stripped_primitives;
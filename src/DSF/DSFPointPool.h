@@ -270,8 +270,10 @@ struct DSFPrimitive {
 	DSFTupleVector		vertices;
 };
 
+// Rebuilds the triangles of a patch into strips and/or triangle batches - inMode is one of the dsf_PatchPrims_ modes.
 void DSFOptimizePrimitives(
-					vector<DSFPrimitive>& io_primitives);
+					vector<DSFPrimitive>& io_primitives,
+					int					  inMode);
 
 /************************************************************************************************************************************************************
  *
@@ -14,10 +14,10 @@
 
 #include "curl/curl.h"
 #include "AssertUtils.h"
-#if !IBM
-#include <pthread.h>
-#endif
 #include <errno.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 int atomic_load(volatile int * a) { return *a; }
 void atomic_store(volatile int * a, int v) { *a = v; }
@@ -27,6 +27,8 @@ void atomic_store(volatile int * a, int v) { *a = v; }
 
 const time_t TIMEOUT_SEC = (30);
 
+#define DEFAULT_MAX_TRANSFERS	6
+
 void	UTL_http_encode_url(string& io_url)
 {
 	string::size_type p;
@@ -34,6 +36,187 @@ void	UTL_http_encode_url(string& io_url)
 		io_url.replace(p,1,"%20");
 }
 
+/*
+ * curl_http_engine - the one I/O thread behind all curl_http_get_files.
+ *
+ * New requests wait in m_queue until a transfer slot is free, then get an easy handle and go into the multi
+ * handle, which does the connection caching for us.  Everything but m_queue, m_cancel and m_max is touched
+ * by the I/O thread only.  The engine lives for the rest of the program once the first request is made.
+ *
+ */
+class	curl_http_engine {
+public:
+
+	static	curl_http_engine&	get(void);
+
+			void	add(curl_http_get_file * f);
+			void	remove(curl_http_get_file * f);		// blocks until the I/O thread is done with f
+			void	set_priority(curl_http_get_file * f, float priority);
+			void	set_max_transfers(int n);
+
+private:
+
+					curl_http_engine();
+
+			void	run(void);
+			void	wake(void);
+
+	CURLM *								m_multi;
+	std::mutex							m_lock;
+	std::condition_variable				m_released;
+	vector<curl_http_get_file *>		m_queue;		// waiting for a slot
+	vector<curl_http_get_file *>		m_cancel;		// on the wire and about to be deleted
+	map<CURL *, curl_http_get_file *>	m_running;
+	int									m_max;
+};
+
+curl_http_engine&	curl_http_engine::get(void)
+{
+	static curl_http_engine * the_engine = new curl_http_engine;		// never deleted - the thread may still be in curl at exit
+	return *the_engine;
+}
+
+curl_http_engine::curl_http_engine() : m_max(DEFAULT_MAX_TRANSFERS)
+{
+	m_multi = curl_multi_init();
+	std::thread(&curl_http_engine::run, this).detach();
+}
+
+void	curl_http_engine::wake(void)
+{
+#if LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(m_multi);
+#endif
+}
+
+void	curl_http_engine::add(curl_http_get_file * f)
+{
+	{
+		lock_guard<mutex> lock(m_lock);
+		f->m_in_engine = true;
+		m_queue.push_back(f);
+	}
+	wake();
+}
+
+void	curl_http_engine::remove(curl_http_get_file * f)
+{
+	unique_lock<mutex> lock(m_lock);
+	if(!f->m_in_engine)
+		return;
+	vector<curl_http_get_file *>::iterator q = find(m_queue.begin(), m_queue.end(), f);
+	if(q != m_queue.end())
+	{
+		m_queue.erase(q);
+		f->m_in_engine = false;
+		return;
+	}
+	m_cancel.push_back(f);
+	wake();
+	m_released.wait(lock, [f] { return !f->m_in_engine; });
+}
+
+void	curl_http_engine::set_priority(curl_http_get_file * f, float priority)
+{
+	lock_guard<mutex> lock(m_lock);
+	f->m_priority = priority;
+}
+
+void	curl_http_engine::set_max_transfers(int n)
+{
+	{
+		lock_guard<mutex> lock(m_lock);
+		m_max = max(n, 1);
+	}
+	wake();
+}
+
+void	curl_http_engine::run(void)
+{
+	while(1)
+	{
+		{
+			lock_guard<mutex> lock(m_lock);
+
+			if(!m_cancel.empty())
+			{
+				for(vector<curl_http_get_file *>::iterator c = m_cancel.begin(); c != m_cancel.end(); ++c)
+				{
+					CURL * curl = (*c)->m_curl;
+					curl_multi_remove_handle(m_multi, curl);
+					m_running.erase(curl);
+					(*c)->end_transfer(CURLE_ABORTED_BY_CALLBACK);
+					(*c)->m_in_engine = false;
+				}
+				m_cancel.clear();
+				m_released.notify_all();
+			}
+
+			while((int) m_running.size() < m_max && !m_queue.empty())
+			{
+				vector<curl_http_get_file *>::iterator next = m_queue.begin();
+				for(vector<curl_http_get_file *>::iterator q = m_queue.begin(); q != m_queue.end(); ++q)
+				if((*q)->m_priority < (*next)->m_priority)
+					next = q;
+				curl_http_get_file * f = *next;
+				m_queue.erase(next);
+
+				CURL * curl = f->begin_transfer();
+				curl_multi_add_handle(m_multi, curl);
+				m_running[curl] = f;
+			}
+		}
+
+		int still_running;
+		curl_multi_perform(m_multi, &still_running);
+
+		CURLMsg * msg;
+		int msgs_left;
+		bool freed = false;
+		while((msg = curl_multi_info_read(m_multi, &msgs_left)) != NULL)
+		if(msg->msg == CURLMSG_DONE)
+		{
+			CURL * curl = msg->easy_handle;
+			CURLcode res = msg->data.result;
+			curl_multi_remove_handle(m_multi, curl);
+
+			curl_http_get_file * f;
+			{
+				lock_guard<mutex> lock(m_lock);
+				f = m_running[curl];
+				m_running.erase(curl);
+			}
+			// f can't go away before we clear m_in_engine, so the result and the callback go out without the lock.
+			f->end_transfer(res);
+			if(f->m_done_cb)
+				f->m_done_cb(f->m_done_ref);
+
+			freed = true;
+			lock_guard<mutex> lock(m_lock);
+			f->m_in_engine = false;
+			vector<curl_http_get_file *>::iterator c = find(m_cancel.begin(), m_cancel.end(), f);
+			if(c != m_cancel.end())
+			{
+				m_cancel.erase(c);
+				m_released.notify_all();
+			}
+		}
+
+		if(freed)
+			continue;		// refill the slots right away
+
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_poll(m_multi, NULL, 0, 1000, NULL);
+#else
+		curl_multi_wait(m_multi, NULL, 0, 50, NULL);
+#endif
+	}
+}
+
+void	curl_http_set_max_transfers(int n)
+{
+	curl_http_engine::get().set_max_transfers(n);
+}
 
 curl_http_get_file::curl_http_get_file(
 							const string&			inURL,
@@ -41,52 +224,38 @@ curl_http_get_file::curl_http_get_file(
 	m_progress(-1),
 	m_status(in_progress),
 	m_halt(0),
+	m_errcode(0),
+	m_priority(0.0f),
+	m_done_cb(NULL),
+	m_done_ref(NULL),
+	m_dest_buffer(NULL),
 	m_dest_path(outDestFile),
 	m_url(inURL),
-	m_dest_buffer(NULL),
-	m_errcode(0),
 	m_last_dl_amount(0.0)
 {
-	UTL_http_encode_url(m_url);
-
-	DebugAssert(inURL.size() > 7);
-	DebugAssert(
-		strncmp(inURL.c_str(),"http://",7) == 0 ||
-		strncmp(inURL.c_str(),"https://",8) == 0);
-	
-	#if IBM
-	m_thread = CreateThread(NULL,0,thread_proc,this,0,NULL);
-	#else
-	pthread_create(&m_thread, NULL, thread_proc, this);
-	#endif
-
+	start();
 }
 
 curl_http_get_file::curl_http_get_file(
 							const string&			inURL,
-							vector<char>*		outDestBuffer) :
+							vector<char>*			outDestBuffer,
+							float					inPriority,
+							curl_http_done_f		inDoneCB,
+							void *					inDoneRef) :
 	m_progress(-1),
 	m_status(in_progress),
 	m_halt(0),
-	m_url(inURL),
-	m_dest_buffer(outDestBuffer),
 	m_errcode(0),
+	m_priority(inPriority),
+	m_done_cb(inDoneCB),
+	m_done_ref(inDoneRef),
+	m_dest_buffer(outDestBuffer),
+	m_url(inURL),
 	m_last_dl_amount(0.0)
 {
-	UTL_http_encode_url(m_url);
-
-	DebugAssert(inURL.size() > 7);
-	DebugAssert(
-		strncmp(inURL.c_str(),"http://",7) == 0 ||
-		strncmp(inURL.c_str(),"https://",8) == 0);
-	
-	#if IBM
-	m_thread = CreateThread(NULL,0,thread_proc,this,0,NULL);
-	#else
-	pthread_create(&m_thread, NULL, thread_proc, this);
-	#endif
-
+	start();
 }
+
 curl_http_get_file::curl_http_get_file(
 							const string&			inURL,
 							const string *			post_data,
@@ -95,37 +264,38 @@ curl_http_get_file::curl_http_get_file(
 	m_progress(-1),
 	m_status(in_progress),
 	m_halt(0),
+	m_errcode(0),
+	m_priority(0.0f),
+	m_done_cb(NULL),
+	m_done_ref(NULL),
+	m_dest_buffer(outBuffer),
 	m_url(inURL),
 	m_post(post_data ? *post_data : string()),
 	m_put(put_data ? *put_data : string()),
-	m_dest_buffer(outBuffer)
+	m_last_dl_amount(0.0)
+{
+	start();
+}
+
+void	curl_http_get_file::start(void)
 {
 	UTL_http_encode_url(m_url);
 
-	DebugAssert(inURL.size() > 7);
+	DebugAssert(m_url.size() > 7);
 	DebugAssert(
-		strncmp(inURL.c_str(),"http://",7) == 0 ||
-		strncmp(inURL.c_str(),"https://",8) == 0);
-	 
-	#if IBM
-	m_thread = CreateThread(NULL,0,thread_proc,this,0,NULL);
-	#else
-	pthread_create(&m_thread, NULL, thread_proc, this);
-	#endif
+		strncmp(m_url.c_str(),"http://",7) == 0 ||
+		strncmp(m_url.c_str(),"https://",8) == 0);
+
+	m_curl = NULL;
+	m_headers = NULL;
+	m_in_engine = false;
+	curl_http_engine::get().add(this);
 }
 
-				
 curl_http_get_file::~curl_http_get_file()
 {
 	atomic_store(&m_halt,1);
-
-	#if IBM
-	WaitForSingleObject(m_thread,INFINITE);
-	CloseHandle(m_thread);
-	#else
-	void * ret;
-	pthread_join(m_thread, &ret);
-	#endif
+	curl_http_engine::get().remove(this);
 }
 	
 float		curl_http_get_file::get_progress(void)
@@ -167,6 +337,11 @@ const string&	curl_http_get_file::get_url() const
 	return m_url;
 }
 
+void	curl_http_get_file::set_priority(float priority)
+{
+	curl_http_engine::get().set_priority(this, priority);
+}
+
 size_t		curl_http_get_file::read_cb(void *contents, size_t size, size_t nmemb, void *userp)
 {
 	curl_http_get_file * me = (curl_http_get_file *) userp;
@@ -232,29 +407,21 @@ int			curl_http_get_file::progress_cb(void* ptr, double TotalToDownload, double
 	return 0;
 }
 
-#if IBM
-DWORD WINAPI
-#else
-void *
-#endif
-curl_http_get_file::thread_proc(void * param)
+void *	curl_http_get_file::begin_transfer(void)
 {
-	curl_http_get_file * me = (curl_http_get_file *) param;
-
-	struct  curl_slist * chunk = NULL;	
-
-	me->m_last_data_time = time(NULL);
+	m_last_data_time = time(NULL);
 	
 	CURL *	curl = curl_easy_init();
+	m_curl = curl;
 
-	curl_easy_setopt(curl, CURLOPT_URL, me->m_url.c_str());
+	curl_easy_setopt(curl, CURLOPT_URL, m_url.c_str());
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, true);	// Required because we do a redirect to protect against URL/Server changes breaking URLs
 
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, param);
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
 		
 	curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progress_cb);	
-	curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, param);
+	curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, this);
 	curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
 	
 	curl_easy_setopt(curl, CURLOPT_ACCEPT_ENCODING, "");  // empty string is expanded into all methods supported by this version of curl.
@@ -271,21 +438,26 @@ curl_http_get_file::thread_proc(void * param)
 //	curl_easy_setopt(curl, CURLOPT_TIMEOUT, 0);
 	curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 60.0);
 
-	if(!me->m_post.empty())
-		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, me->m_post.c_str());
+	if(!m_post.empty())
+		curl_easy_setopt(curl, CURLOPT_POSTFIELDS, m_post.c_str());
 	
-	if(!me->m_put.empty())
+	if(!m_put.empty())
 	{
-		chunk = curl_slist_append(chunk, "Content-Type: application/json");
+		m_headers = curl_slist_append(m_headers, "Content-Type: application/json");
 		
-		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, chunk);	
+		curl_easy_setopt(curl, CURLOPT_HTTPHEADER, m_headers);	
 		curl_easy_setopt(curl, CURLOPT_UPLOAD, 1);
 		curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_cb);
-		curl_easy_setopt(curl, CURLOPT_READDATA, param);
-		curl_easy_setopt(curl, CURLOPT_INFILESIZE, me->m_put.size());
+		curl_easy_setopt(curl, CURLOPT_READDATA, this);
+		curl_easy_setopt(curl, CURLOPT_INFILESIZE, m_put.size());
 	}
-	
-	CURLcode res = curl_easy_perform(curl);
+	return curl;
+}
+
+void	curl_http_get_file::end_transfer(int result)
+{
+	CURL * curl = m_curl;
+	CURLcode res = (CURLcode) result;
 
 #if WED
 	LOG_MSG("I/CURL perform() done\n");
@@ -302,8 +474,8 @@ curl_http_get_file::thread_proc(void * param)
 
 	if(res != CURLE_OK)
 	{
-		me->m_errcode = res;
-		atomic_store(&me->m_status, done_error);
+		m_errcode = res;
+		atomic_store(&m_status, done_error);
 	}
 	else
 	{
@@ -314,44 +486,44 @@ curl_http_get_file::thread_proc(void * param)
 		{
 			DebugAssert(http_code != 0);
 			
-			me->m_errcode = http_code;
-			atomic_store(&me->m_status, done_error);
+			m_errcode = http_code;
+			atomic_store(&m_status, done_error);
 		}
 		else
 		{
-			if(me->m_dest_buffer)
+			if(m_dest_buffer)
 			{
-				me->m_dest_buffer->swap(me->m_dl_buffer);
-				atomic_store(&me->m_status, done_OK);
+				m_dest_buffer->swap(m_dl_buffer);
+				atomic_store(&m_status, done_OK);
 			}
 			else
 			{
-				FILE * fi = fopen(me->m_dest_path.c_str(),"wb");
+				FILE * fi = fopen(m_dest_path.c_str(),"wb");
 				if(fi == NULL)
 				{
-					me->m_errcode = errno;
+					m_errcode = errno;
 				} 
 				else
 				{
-					size_t ws = fwrite(&me->m_dl_buffer[0], 0, me->m_dl_buffer.size(), fi);
-					if(ws != me->m_dl_buffer.size())
+					size_t ws = fwrite(&m_dl_buffer[0], 1, m_dl_buffer.size(), fi);
+					if(ws != m_dl_buffer.size())
 					{
-						me->m_errcode = ferror(fi);
+						m_errcode = ferror(fi);
 					}
 					fclose(fi);
 				}
-				atomic_store(&me->m_status, me->m_errcode == 0 ? done_OK : done_error);
+				atomic_store(&m_status, m_errcode == 0 ? done_OK : done_error);
 			
 			}
 		}
 	}
 
 	/* always cleanup */ 
-	if(chunk)
-		curl_slist_free_all(chunk);
+	if(m_headers)
+		curl_slist_free_all(m_headers);
+	m_headers = NULL;
 	curl_easy_cleanup(curl);
-
-	return NULL;
+	m_curl = NULL;
 }
 
 bool	UTL_http_is_error_bad_net(int err)
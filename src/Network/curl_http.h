@@ -8,18 +8,16 @@
 
 #if HAS_GATEWAY
 
-#if !IBM
-#include <pthread.h>
-#endif
-
 /*
  * curl_http_get_file
  *
  * curl_http_get_file runs a single asynchronous HTTP request for one file.  It provides delivery
  * in memory or on disk, and can unzip a delivery to disk.  
  *
- * Operation is truly async - a worker thread is spawned, and the worker thread blocks on network
- * I/O; the worker is destroyed once the connection is completed.
+ * Operation is truly async - all requests are run by one I/O thread that drives a curl multi handle.
+ * Connections to a host stay open between requests, so a burst of small downloads (map tiles) doesn't pay
+ * for a connect and TLS handshake each.  At most curl_http_set_max_transfers requests are on the wire at
+ * once; the others wait and start lowest priority value first - see set_priority.
  *
  * Asynchronous progress can be queried from any thread via get_status and get_progress; a request to
  * abort is made by deleting the file.  Note that deleting the file is a -blocking- operation until
@@ -29,8 +27,17 @@
  * To determine: asynchronuos service is provided by CURL callbacks - mailing lists imply it's about
  * 1 per second.
  *
+ * A done callback can be passed in to hear about completion without polling.  It is called on the I/O
+ * thread right after is_done() turns true: keep it short, don't touch the GUI and don't call back into
+ * curl_http - flag something the main thread looks at.
+ *
  */
 
+typedef void (* curl_http_done_f)(void * ref);
+
+// How many requests may transfer at the same time - the rest queue up.  Default 6.
+void	curl_http_set_max_transfers(int n);
+
 class	curl_http_get_file {
 public:
 
@@ -46,7 +53,10 @@ public:
 
 				curl_http_get_file(
 							const string&			inURL,
-							vector<char>*			outDestBuffer);
+							vector<char>*			outDestBuffer,
+							float					inPriority = 0.0f,
+							curl_http_done_f		inDoneCB = NULL,
+							void *					inDoneRef = NULL);
 
 				curl_http_get_file(
 							const string&			inURL,
@@ -68,6 +78,9 @@ public:
 	void		get_error_data(vector<char>& out_data);	// If an error, any stuff the server sent -- might be text, HTML, who knows!
 	const string&	get_url() const; //The URL we are attempted to GET from
 
+	// Requests that haven't started yet go lowest value first - e.g. the distance from what the user looks at.
+	void		set_priority(float priority);
+
 private:
 
 		volatile	int			m_progress;		// Out of 100
@@ -75,21 +88,23 @@ private:
 		volatile	int			m_halt;
 		volatile	int			m_errcode;
 		
-		#if IBM
-		HANDLE					m_thread;
-		#else
-		pthread_t				m_thread;
-		#endif
-		
+		friend	class		curl_http_engine;
+
 		static	size_t		write_cb(void *contents, size_t size, size_t nmemb, void *userp);
 		static	size_t		read_cb(void *contents, size_t size, size_t nmemb, void *userp);
 		static	int			progress_cb(void* ptr, double TotalToDownload, double NowDownloaded, double TotalToUpload, double NowUploaded);
 
-		#if IBM
-		static	DWORD WINAPI	thread_proc(void * param);
-		#else
-		static	void *		thread_proc(void * param);
-		#endif
+				void		start(void);
+				void *		begin_transfer(void);		// I/O thread: make and set up the easy handle
+				void		end_transfer(int result);	// I/O thread: deliver the result, release the easy handle
+
+		// Owned by the I/O thread while we are in the engine
+		void *					m_curl;
+		struct curl_slist *		m_headers;
+		bool					m_in_engine;
+		float					m_priority;
+		curl_http_done_f		m_done_cb;
+		void *					m_done_ref;
 	
 		vector<char>			m_dl_buffer;
 		vector<char>*			m_dest_buffer;
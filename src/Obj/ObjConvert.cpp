@@ -24,10 +24,8 @@
 #include "XObjDefs.h"
 #include <math.h>
 #include <string.h>
+#include "VertexCacheUtils.h"
 
-#include "stdafx.h"
-#include "tri_stripper.h"
-using namespace	triangle_stripper;
 
 static bool operator==(const vec_tex& lhs, const vec_tex& rhs);
 bool operator==(const vec_tex& lhs, const vec_tex& rhs)
@@ -543,121 +541,26 @@ void	Obj8ToObj7(const XObj8& obj8, XObj& obj7)
 }
 
 
-#define INDEX_T unsigned int
+/****************************************************************************************
+ * VERTEX CACHE OPTIMIZATION
+ ****************************************************************************************/
 
-void make_strip_order(vector<INDEX_T>& indices)
+float	Obj8_CalcACMR(const XObj8& obj8)
 {
-	tri_stripper stripper_thingie(indices);
-	tri_stripper::primitives_vector	stripped_primitives;
-	stripper_thingie.Strip(&stripped_primitives);
-
-	indices.clear();
-
-	for(tri_stripper::primitives_vector::iterator new_prim = stripped_primitives.begin(); new_prim != stripped_primitives.end(); ++new_prim)
-	{
-		if(new_prim->m_Type == tri_stripper::PT_Triangles)
-		{
-			for(tri_stripper::indices::iterator idx = new_prim->m_Indices.begin(); idx != new_prim->m_Indices.end(); ++idx)
-				indices.push_back(*idx);
-		}
-		else
-		{
-			for(int n = 2; n < new_prim->m_Indices.size(); ++n)
-			{
-				if(n % 2)
-				{
-					indices.push_back(new_prim->m_Indices[n-1]);
-					indices.push_back(new_prim->m_Indices[n-2]);
-					indices.push_back(new_prim->m_Indices[n-0]);
-				}
-				else
-				{
-					indices.push_back(new_prim->m_Indices[n-2]);
-					indices.push_back(new_prim->m_Indices[n-1]);
-					indices.push_back(new_prim->m_Indices[n-0]);
-				}
-			}
-		}
-	}
-}
-
-void split_degen(const vector<INDEX_T>& all,
-					   vector<INDEX_T>& ok,
-					   vector<INDEX_T>& degen)
-{
-	for(int n = 0; n < all.size(); n += 3)
-	{
-		INDEX_T p1 = all[n  ];
-		INDEX_T p2 = all[n+1];
-		INDEX_T p3 = all[n+2];
-		if(p1 == p2 || p1 == p3 || p2 == p3)
-		{
-			degen.push_back(p1);
-			degen.push_back(p2);
-			degen.push_back(p3);
-		}
-		else
-		{
-			ok.push_back(p1);
-			ok.push_back(p2);
-			ok.push_back(p3);
-		}
-	}
-}
-
-bool find_tri_in(int p1, int p2, int p3, const vector<INDEX_T>& tl)
-{
-	for(int n = 0; n < tl.size(); n += 3)
-	{
-		if(p1 == tl[n  ] &&
-		   p2 == tl[n+1] &&
-		   p3 == tl[n+2])	return true;
-
-		if(p2 == tl[n  ] &&
-		   p3 == tl[n+1] &&
-		   p1 == tl[n+2])	return true;
-
-		if(p3 == tl[n  ] &&
-		   p1 == tl[n+1] &&
-		   p2 == tl[n+2])	return true;
-	}
-	printf("COULD NOT FIND: %d,%d,%d!\n", p1,p2,p3);
-	return false;
+	int transforms = 0, tris = 0;
+	for(vector<XObjLOD8>::const_iterator L = obj8.lods.begin(); L != obj8.lods.end(); ++L)
+	for(vector<XObjCmd8>::const_iterator C = L->cmds.begin(); C != L->cmds.end(); ++C)
+	if(C->cmd == obj8_Tris && C->idx_count > 0)
+		VCACHE_Simulate(&obj8.indices[C->idx_offset], C->idx_count, transforms, tris);
+	return tris ? (float) transforms / (float) tris : 0.0f;
 }
 
-void dump_vec(const char * bl, const char * al, const vector<INDEX_T>& b, const vector<INDEX_T>& a)
-{
-	printf("  %s   %s" , bl,al);
-	for(int n = 0; n < b.size(); n += 3)
-	printf("%d       %d,%d,%d      %d,%d,%d\n",
-				n,
-				b[n],b[n+1],b[n+2],
-				a[n],a[n+1],a[n+2]);
-
-}
-
-void compare_before_after(const vector<INDEX_T>& b, const vector<INDEX_T>& a)
-{
-	bool ok = true;
-	bool degen = false;
-	for(int n = 0; n < a.size(); n += 3)
-	{
-		if (!find_tri_in(b[n],b[n+1],b[n+2],a)) ok = false;
-		if(b[n] == b[n+1] ||
-		   b[n+1] == b[n+2] ||
-		b[n] == b[n+2]) degen = true;
-	}
-	if (!ok && !degen)
-	{
-		dump_vec("before", "after" ,b, a);
-	}
-}
 bool	Obj8_Optimize(XObj8& obj8)
 {
 	typedef	pair<int, int>		idx_range;
 	typedef vector<idx_range>	idx_range_vector;
 
-	idx_range_vector ranges;
+	idx_range_vector ranges, line_ranges;
 
 	for(vector<XObjLOD8>::iterator L = obj8.lods.begin(); L != obj8.lods.end(); ++L)
 	for(vector<XObjCmd8>::iterator C = L->cmds.begin(); C != L->cmds.end(); ++C)
@@ -677,8 +580,20 @@ bool	Obj8_Optimize(XObj8& obj8)
 			ranges.push_back(me);
 
 		}
+		if(C->cmd == obj8_Lines)
+			line_ranges.push_back(idx_range(C->idx_offset, C->idx_offset + C->idx_count));
+	}
+
+	// Line indices point into geo_lines, so a range used for both can't be renumbered.
+	for(idx_range_vector::iterator r = ranges.begin(); r != ranges.end(); ++r)
+	for(idx_range_vector::iterator l = line_ranges.begin(); l != line_ranges.end(); ++l)
+	if(l->first < r->second && l->second > r->first)
+	{
+		printf("Sorry, the IDX range [%d,%d] is used by both TRIS and LINES so we cannot optimize.\n",
+			r->first, r->second);
+		return false;
 	}
-	vector<INDEX_T>	idx16;
+
 	for(vector<int>::iterator idx_iter = obj8.indices.begin(); idx_iter != obj8.indices.end(); ++idx_iter)
 	{
 		if (*idx_iter > 65535)
@@ -686,26 +601,56 @@ bool	Obj8_Optimize(XObj8& obj8)
 			printf("Sorry, we cannot optimize because the indices cannot be reduced to 16 bits.\n");
 			return false;
 		}
-		idx16.push_back(*idx_iter);
 	}
 
+	sort(ranges.begin(), ranges.end());
+
+	// Triangle order: each range is reordered in place; degenerate tris are kept, at the end of their range.
 	for(idx_range_vector::iterator r = ranges.begin(); r != ranges.end(); ++r)
 	{
-		vector<INDEX_T> before(idx16.begin()+r->first, idx16.begin()+r->second);
-
-		vector<INDEX_T>	ok, degen;
-		split_degen(before, ok, degen);
+		vector<int>	ok, degen;
+		for(int n = r->first; n + 2 < r->second; n += 3)
+		{
+			int p1 = obj8.indices[n  ];
+			int p2 = obj8.indices[n+1];
+			int p3 = obj8.indices[n+2];
+			vector<int>& dst((p1 == p2 || p1 == p3 || p2 == p3) ? degen : ok);
+			dst.push_back(p1);
+			dst.push_back(p2);
+			dst.push_back(p3);
+		}
 
-		make_strip_order(ok);
+		VCACHE_OrderTris(ok);
 
-		vector<INDEX_T> after(ok.begin(), ok.end());
-		after.insert(after.end(),degen.begin(),degen.end());
+		copy(ok.begin(), ok.end(), obj8.indices.begin() + r->first);
+		copy(degen.begin(), degen.end(), obj8.indices.begin() + r->first + ok.size());
+	}
 
-		compare_before_after(before,after);
+	// Vertex order: number the VT pool in the order the tris first use it.  VTs no tri uses keep their relative order at the end.
+	int vert_count = obj8.geo_tri.count();
+	vector<int>	new_id(vert_count, -1);
+	int next_id = 0;
+	for(idx_range_vector::iterator r = ranges.begin(); r != ranges.end(); ++r)
+	for(int n = r->first; n < r->second; ++n)
+	{
+		int v = obj8.indices[n];
+		if(v >= 0 && v < vert_count && new_id[v] == -1)
+			new_id[v] = next_id++;
 	}
+	for(int v = 0; v < vert_count; ++v)
+	if(new_id[v] == -1)
+		new_id[v] = next_id++;
 
-	obj8.indices.clear();
-	obj8.indices.insert(obj8.indices.end(),idx16.begin(), idx16.end());
+	ObjPointPool	old_pool(obj8.geo_tri);
+	obj8.geo_tri.clear(8);
+	obj8.geo_tri.resize(vert_count);
+	for(int v = 0; v < vert_count; ++v)
+		obj8.geo_tri.set(new_id[v], old_pool.get(v));
+
+	for(idx_range_vector::iterator r = ranges.begin(); r != ranges.end(); ++r)
+	for(int n = r->first; n < r->second; ++n)
+	if(obj8.indices[n] >= 0 && obj8.indices[n] < vert_count)
+		obj8.indices[n] = new_id[obj8.indices[n]];
 
 	return true;
 }
@@ -37,6 +37,9 @@ void	Obj8ToObj7(const XObj8& obj8, XObj& obj7);
 void	Obj8_ConsolidateIndexCommands(XObj8& obj8);
 // This calculates OBJ8 normals frmo tris, editing the point pool.
 void	Obj8_CalcNormals(XObj8& obj8);
+// This reorders each TRIS range for the post-transform vertex cache and renumbers the VT pool in draw order.
 bool	Obj8_Optimize(XObj8& obj8);
+// Average vertex transforms per triangle over all TRIS commands, for a simulated FIFO vertex cache.
+float	Obj8_CalcACMR(const XObj8& obj8);
 
 #endif
\ No newline at end of file
@@ -37,24 +37,162 @@ ObjPointPool::~ObjPointPool()
 {
 }
 
+/************************************************************************************************************
+ * INDEX
+ ************************************************************************************************************/
+
+// Keys match when every float compares equal, the same rule the old lexicographic map used.  That means
+// -0.0 and 0.0 are the same key, so they have to hash the same, too.
+static inline unsigned int hash_float(unsigned int h, float f)
+{
+	unsigned int bits = 0;
+	if (f != 0.0f)
+		memcpy(&bits, &f, sizeof(bits));
+	h ^= bits;
+	h *= 16777619u;									// FNV-1a, a word at a time
+	return h;
+}
+
+static inline unsigned int finish_hash(unsigned int h)
+{
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+	return h;
+}
+
+template <int D>
+inline unsigned int ObjPointPool::hash_fixed(const float pt[]) const
+{
+	unsigned int h = 2166136261u;
+	for (int i = 0; i < D; ++i)
+		h = hash_float(h, pt[i]);
+	return finish_hash(h);
+}
+
+unsigned int ObjPointPool::hash_any(const float pt[]) const
+{
+	unsigned int h = 2166136261u;
+	for (int i = 0; i < mDepth; ++i)
+		h = hash_float(h, pt[i]);
+	return finish_hash(h);
+}
+
+template <int D>
+inline int	ObjPointPool::find_fixed(const float pt[], unsigned int h) const
+{
+	unsigned int mask = mSlots.size() - 1;
+	for (unsigned int s = h & mask; ; s = (s + 1) & mask)
+	{
+		int e = mSlots[s];
+		if (e == -1) return -1;
+		if (mKeyHash[e] != h) continue;
+		const float * k = &mKeys[e * D];
+		int i = 0;
+		while (i < D && k[i] == pt[i]) ++i;
+		if (i == D) return e;
+	}
+}
+
+int	ObjPointPool::find_any(const float pt[], unsigned int h) const
+{
+	unsigned int mask = mSlots.size() - 1;
+	for (unsigned int s = h & mask; ; s = (s + 1) & mask)
+	{
+		int e = mSlots[s];
+		if (e == -1) return -1;
+		if (mKeyHash[e] != h) continue;
+		const float * k = &mKeys[e * mDepth];
+		int i = 0;
+		while (i < mDepth && k[i] == pt[i]) ++i;
+		if (i == mDepth) return e;
+	}
+}
+
+unsigned int ObjPointPool::hash_key(const float pt[]) const
+{
+	switch(mDepth) {
+	case 8:		return hash_fixed<8>(pt);
+	case 6:		return hash_fixed<6>(pt);
+	default:	return hash_any(pt);
+	}
+}
+
+int	ObjPointPool::find_key(const float pt[], unsigned int h) const
+{
+	if (mSlots.empty()) return -1;
+	switch(mDepth) {
+	case 8:		return find_fixed<8>(pt, h);
+	case 6:		return find_fixed<6>(pt, h);
+	default:	return find_any(pt, h);
+	}
+}
+
+// Like map::insert - if the key is already indexed, the first point wins.
+void	ObjPointPool::index_key(const float pt[], int n)
+{
+	unsigned int h = hash_key(pt);
+	if (find_key(pt, h) != -1) return;
+
+	if ((mKeyPoint.size() + 1) * 2 > mSlots.size())
+		grow_index();
+
+	int e = mKeyPoint.size();
+	mKeys.insert(mKeys.end(), pt, pt + mDepth);
+	mKeyPoint.push_back(n);
+	mKeyHash.push_back(h);
+
+	unsigned int mask = mSlots.size() - 1;
+	unsigned int s = h & mask;
+	while (mSlots[s] != -1)
+		s = (s + 1) & mask;
+	mSlots[s] = e;
+}
+
+void	ObjPointPool::grow_index(void)
+{
+	vector<int>	slots(mSlots.empty() ? 256 : mSlots.size() * 2, -1);
+	unsigned int mask = slots.size() - 1;
+	for (int e = 0; e < mKeyPoint.size(); ++e)
+	{
+		unsigned int s = mKeyHash[e] & mask;
+		while (slots[s] != -1)
+			s = (s + 1) & mask;
+		slots[s] = e;
+	}
+	mSlots.swap(slots);
+}
+
+void	ObjPointPool::clear_index(void)
+{
+	mSlots.clear();
+	mKeys.clear();
+	mKeyPoint.clear();
+	mKeyHash.clear();
+}
+
+/************************************************************************************************************
+ * POOL
+ ************************************************************************************************************/
+
 void	ObjPointPool::clear(int depth)
 {
 	mData.clear();
-	mIndex.clear();
+	clear_index();
 	mDepth = depth;
 }
 
 void	ObjPointPool::resize(int pts)
 {
 	mData.resize(pts * mDepth);
-	mIndex.clear();
+	clear_index();
 }
 
 int		ObjPointPool::accumulate(const float pt[])
 {
-	index_type::iterator iter = mIndex.find(key_type(pt, pt + mDepth));
-	if (iter != mIndex.end())
-		return iter->second;
+	int e = find_key(pt, hash_key(pt));
+	if (e != -1)
+		return mKeyPoint[e];
 	return append(pt);
 }
 
@@ -62,14 +200,14 @@ int		ObjPointPool::append(const float pt[])
 {
 	int ret = mData.size() / mDepth;
 	mData.insert(mData.end(), pt, pt + mDepth);
-	mIndex.insert(index_type::value_type(key_type(pt,pt+mDepth), ret));
+	index_key(pt, ret);
 	return ret;
 }
 
 void	ObjPointPool::set(int n, float pt[])
 {
 	memcpy(&mData[n*mDepth], pt, mDepth * sizeof(float));
-	mIndex.insert(index_type::value_type(key_type(pt,pt+mDepth), n));
+	index_key(pt, n);
 }
 
 int		ObjPointPool::count(void) const
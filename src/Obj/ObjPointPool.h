@@ -25,19 +25,16 @@
 
 #include <vector>
 #include <map>
-#include <functional>
 
 using std::map;
 using std::vector;
-using std::binary_function;
 
-template <class T>
-struct lex_compare_vector : public binary_function<vector<T>, vector<T>, bool> {
-
-	bool operator()(const vector<T>& lhs, const vector<T>& rhs) const {
-		return lexicographical_compare(lhs.begin(), lhs.end(), rhs.begin(), rhs.end());
-	}
-};
+// ObjPointPool - a flat array of points, each "depth" floats wide, with an optional dedupe index.
+// accumulate() returns the first indexed point with exactly the same floats, or appends a new one.
+//
+// The index is an open-addressed hash table that keeps its own packed copy of each key - set() can
+// overwrite a point after it was indexed, and lookups have to keep finding it under its original
+// value.  Depths 6 and 8 (lines/lights and tris) get fixed-size hash/compare code.
 
 class ObjPointPool {
 public:
@@ -59,13 +56,25 @@ public:
 
 private:
 
-	typedef	vector<float>									key_type;
-	typedef map<key_type, int, lex_compare_vector<float> >	index_type;
+	template <int D>	int		find_fixed(const float pt[], unsigned int h) const;
+	template <int D>	unsigned int hash_fixed(const float pt[]) const;
+						int		find_any(const float pt[], unsigned int h) const;
+						unsigned int hash_any(const float pt[]) const;
+
+	unsigned int	hash_key(const float pt[]) const;
+	int				find_key(const float pt[], unsigned int h) const;
+	void			index_key(const float pt[], int n);
+	void			grow_index(void);
+	void			clear_index(void);
 
 	vector<float>	mData;
-	index_type		mIndex;
 	int				mDepth;
 
+	vector<int>		mSlots;			// Hash table: entry number or -1 for empty.  Size is a power of 2.
+	vector<float>	mKeys;			// Packed keys, mDepth floats per entry.
+	vector<int>		mKeyPoint;		// Point index for each entry.
+	vector<unsigned int> mKeyHash;	// Hash of each entry, so growing doesn't rehash the floats.
+
 };
 
 #endif
@@ -123,6 +123,14 @@ inline xint TXT_MAP_str_match_space(xbyt*& c,const xbyt* c_max,const char* input
 	return xfals;
 }
 
+// Powers of ten up to 10^10 are exact in a float, so the table gives the same result as pow() without the call.
+static const xflt	TXT_MAP_pow10[11] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+inline xint TXT_MAP_digit(const xbyt* c)
+{
+	return (unsigned) (*c - '0') < 10;
+}
+
 inline xflt TXT_MAP_flt_scan(xbyt*& c,const xbyt* c_max, bool go_next_line)
 {
 	while(c< c_max && (
@@ -130,10 +138,23 @@ inline xflt TXT_MAP_flt_scan(xbyt*& c,const xbyt* c_max, bool go_next_line)
 		(go_next_line && TXT_MAP_eoln(c))))	++c;
 
 	xflt ret_val	=0;
+	xint int_val	=0;		// Digits accumulate in an int while every step stays exact in a float - the result is bit-identical.
+	xint int_mode	=xtrue;
 	xint decimals	=0;
 	xint negative	=xfals;
 	xint has_decimal=xfals;
 
+	// Fast path for the plain [sign]digits[.digits] form that makes up nearly all of VT/IDX data.  Anything
+	// else just drops into the general loop below with the state so far.
+	if(c<c_max && (*c=='-' || *c=='+')) { negative = *c=='-'; ++c; }
+	while(c<c_max && TXT_MAP_digit(c) && int_val < 1000000) { int_val=(10*int_val)+*c-'0'; ++c; }
+	if(c<c_max && *c=='.')
+	{
+		has_decimal=xtrue;
+		++c;
+		while(c<c_max && TXT_MAP_digit(c) && int_val < 1000000) { int_val=(10*int_val)+*c-'0'; ++decimals; ++c; }
+	}
+
 	while(c<c_max && !TXT_MAP_space(c) && !TXT_MAP_eoln(c))
 	{
 			 if(*c=='-')negative	=xtrue;
@@ -141,12 +162,20 @@ inline xflt TXT_MAP_flt_scan(xbyt*& c,const xbyt* c_max, bool go_next_line)
 		else if(*c=='.')has_decimal	=xtrue;
 		else
 		{
-			ret_val=(10*ret_val)+*c-'0';
+			if(int_mode && int_val >= 0 && int_val < 1000000)
+				int_val=(10*int_val)+*c-'0';
+			else
+			{
+				if(int_mode) { ret_val = int_val; int_mode = xfals; }
+				ret_val=(10*ret_val)+*c-'0';
+			}
 			if(has_decimal)decimals++;
 		}
 		++c;
 	}
-	return ret_val/pow((xflt)10,(xflt)decimals)*((negative)?-1.0:1.0);
+	if(int_mode) ret_val = int_val;
+	xflt scale = decimals <= 10 ? TXT_MAP_pow10[decimals] : pow((xflt)10,(xflt)decimals);
+	return ret_val/scale*((negative)?-1.0:1.0);
 }
 
 inline xint TXT_MAP_int_scan(xbyt*& c,const xbyt* c_max, bool go_next_line)
@@ -161,6 +190,7 @@ inline xint TXT_MAP_int_scan(xbyt*& c,const xbyt* c_max, bool go_next_line)
 	if(c<c_max && *c=='-'){sign_mult=-1;	++c;}
 	if(c<c_max && *c=='+'){sign_mult= 1;	++c;}
 
+	while(c<c_max && TXT_MAP_digit(c)) { retval=(10*retval)+*c-'0'; ++c; }
 	while(c<c_max && !TXT_MAP_space(c) && !TXT_MAP_eoln(c))
 	{
 		retval=(10*retval)+*c-'0';
@@ -169,6 +199,21 @@ inline xint TXT_MAP_int_scan(xbyt*& c,const xbyt* c_max, bool go_next_line)
 	return sign_mult * retval;
 }
 
+// Indices are almost always short runs of plain digits - read those directly.  Anything else (or anything
+// long enough that the float scanner would round it) goes through TXT_MAP_flt_scan so it parses as it always has.
+inline unsigned int TXT_MAP_idx_scan(xbyt*& c,const xbyt* c_max)
+{
+	while(c<c_max && TXT_MAP_space(c)) ++c;
+
+	xbyt* c1=c;
+	unsigned int retval=0;
+	while(c<c_max && TXT_MAP_digit(c) && c-c1 < 7) { retval=(10*retval)+*c-'0'; ++c; }
+	if(c>c1 && (c==c_max || TXT_MAP_space(c) || TXT_MAP_eoln(c)))
+		return retval;
+	c=c1;
+	return TXT_MAP_flt_scan(c,c_max,xfals);
+}
+
 inline xint TXT_MAP_continue(const xbyt* c,const xbyt* c_max)
 {
 	return (c < c_max);
@@ -685,31 +730,15 @@ bool	XObj8Read(const char * inFile, XObj8& outObj)
 		// IDX <n>
 		else if (TXT_MAP_str_match_space(cur_ptr, end_ptr, "IDX", xfals))
 		{
-			if (idxcount >= idxmax)
-			{
-				LOG_MSG("E/Obj %s number of idx exceeds declared idx count %d\n", inFile, idxmax);
-				break;
-			}
-			unsigned int idx = TXT_MAP_flt_scan(cur_ptr, end_ptr, xfals);
-			if (idx < tricount)
-				outObj.indices[idxcount++] = idx;
-			else
-			{
-				LOG_MSG("E/Obj %s idx #%d points to index %d exceeding range of tris read %d\n", inFile, idxcount, idx, tricount);
-				outObj.indices[idxcount++] = 0;
-			}
-		}
-		// IDX10 <n> x 10
-		else if (TXT_MAP_str_match_space(cur_ptr, end_ptr, "IDX10", xfals))
-		{
-			if (idxcount+9 >= idxmax)
-			{
-				LOG_MSG("E/Obj %s number of idx exceeds declared idx count %d\n", inFile, idxmax);
-				break;
-			}
-			for (n = 0; n < 10; ++n)
-			{
-				unsigned int idx = TXT_MAP_flt_scan(cur_ptr, end_ptr, xfals);
+			// Indices come in long runs - eat the whole run here instead of going back through the command chain per line.
+			do {
+				if (idxcount >= idxmax)
+				{
+					LOG_MSG("E/Obj %s number of idx exceeds declared idx count %d\n", inFile, idxmax);
+					stop = true;
+					break;
+				}
+				unsigned int idx = TXT_MAP_idx_scan(cur_ptr, end_ptr);
 				if (idx < tricount)
 					outObj.indices[idxcount++] = idx;
 				else
@@ -717,7 +746,34 @@ bool	XObj8Read(const char * inFile, XObj8& outObj)
 					LOG_MSG("E/Obj %s idx #%d points to index %d exceeding range of tris read %d\n", inFile, idxcount, idx, tricount);
 					outObj.indices[idxcount++] = 0;
 				}
-			}
+				TXT_MAP_str_scan_eoln(cur_ptr, end_ptr, NULL);
+				ate_eoln = true;
+			} while (TXT_MAP_continue(cur_ptr, end_ptr) && TXT_MAP_str_match_space(cur_ptr, end_ptr, "IDX", xfals));
+		}
+		// IDX10 <n> x 10
+		else if (TXT_MAP_str_match_space(cur_ptr, end_ptr, "IDX10", xfals))
+		{
+			do {
+				if (idxcount+9 >= idxmax)
+				{
+					LOG_MSG("E/Obj %s number of idx exceeds declared idx count %d\n", inFile, idxmax);
+					stop = true;
+					break;
+				}
+				for (n = 0; n < 10; ++n)
+				{
+					unsigned int idx = TXT_MAP_idx_scan(cur_ptr, end_ptr);
+					if (idx < tricount)
+						outObj.indices[idxcount++] = idx;
+					else
+					{
+						LOG_MSG("E/Obj %s idx #%d points to index %d exceeding range of tris read %d\n", inFile, idxcount, idx, tricount);
+						outObj.indices[idxcount++] = 0;
+					}
+				}
+				TXT_MAP_str_scan_eoln(cur_ptr, end_ptr, NULL);
+				ate_eoln = true;
+			} while (TXT_MAP_continue(cur_ptr, end_ptr) && TXT_MAP_str_match_space(cur_ptr, end_ptr, "IDX10", xfals));
 		}
 		// TRIS offset count
 		else if (TXT_MAP_str_match_space(cur_ptr, end_ptr, "TRIS", xfals))
@@ -2043,3 +2099,346 @@ bool	XObj8Write(const char * inFile, const XObj8& outObj)
 	fclose(fi);
 	return true;
 }
+
+/****************************************************************************************
+ * OBJ 8 BINARY CACHE
+ ****************************************************************************************
+ *
+ * The whole file is one blob: a header that identifies the source file, then every field
+ * of the XObj8 in declaration order.  Plain-old-data arrays are stored as a count and raw
+ * bytes, strings as a length and chars.  Anything that doesn't check out - wrong magic,
+ * version, source size/time/path, or a count that runs off the end - makes the read fail
+ * and the caller falls back to the text parser.
+ *
+ * Bump XOBJ8_BIN_VERSION whenever XObj8 or any of its members change layout.
+ */
+
+#include <sys/stat.h>
+
+#define XOBJ8_BIN_MAGIC		0x58424F38		// 'XBO8'
+#define XOBJ8_BIN_VERSION	1
+
+struct	xobj8_bin_header {
+	int			magic;
+	int			version;
+	int			sizeof_ptr;				// Catches 32/64 bit caches sharing a dir, along with endianness via the magic
+	int			path_len;
+	long long	src_size;
+	long long	src_time;
+};
+
+class	xobj8_bin_writer {
+public:
+	vector<char>	buf;
+
+	void	raw(const void * p, size_t len) { buf.insert(buf.end(), (const char *) p, (const char *) p + len); }
+	void	i(int v) { raw(&v, sizeof(v)); }
+	void	f(float v) { raw(&v, sizeof(v)); }
+	void	fv(const float * v, int n) { raw(v, n * sizeof(float)); }
+	void	s(const string& v) { i(v.size()); raw(v.data(), v.size()); }
+	template <class T>
+	void	pod(const vector<T>& v) { i(v.size()); if(!v.empty()) raw(&v[0], v.size() * sizeof(T)); }
+	void	pool(const ObjPointPool& p, int depth) { i(p.count()); if(p.count()) raw(p.get(0), p.count() * depth * sizeof(float)); }
+};
+
+class	xobj8_bin_reader {
+public:
+	const char *	p;
+	const char *	e;
+	bool			ok;
+
+	xobj8_bin_reader(const char * b, const char * end) : p(b), e(end), ok(true) { }
+
+	bool	raw(void * d, size_t len) { if(!ok || (size_t) (e - p) < len) return ok = false; memcpy(d, p, len); p += len; return true; }
+	int		i(void) { int v = 0; raw(&v, sizeof(v)); return v; }
+	float	f(void) { float v = 0.0f; raw(&v, sizeof(v)); return v; }
+	void	fv(float * v, int n) { raw(v, n * sizeof(float)); }
+	int		count(size_t elem) { int n = i(); if(n < 0 || (size_t) (e - p) / elem < (size_t) n) { ok = false; return 0; } return n; }
+	void	s(string& v) { int n = count(1); v.assign(p, n); p += n; }
+	template <class T>
+	void	pod(vector<T>& v) { int n = count(sizeof(T)); v.resize(n); if(n) raw(&v[0], n * sizeof(T)); }
+	void	pool(ObjPointPool& pl, int depth)
+	{
+		int n = count(depth * sizeof(float));
+		pl.clear(depth);
+		pl.resize(n);
+		float pt[8];
+		for(int k = 0; k < n; ++k)						// set() rather than a block copy so the pool's dedupe index
+		{												// matches what the text parser would have built.
+			raw(pt, depth * sizeof(float));
+			pl.set(k, pt);
+		}
+	}
+};
+
+static void	xobj8_bin_keys(xobj8_bin_writer& w, const vector<XObjKey>& k)
+{
+	w.i(k.size());
+	for(vector<XObjKey>::const_iterator i = k.begin(); i != k.end(); ++i)
+	{
+		w.f(i->key);
+		w.fv(i->v, 3);
+	}
+}
+
+static void	xobj8_bin_keys(xobj8_bin_reader& r, vector<XObjKey>& k)
+{
+	k.resize(r.count(4 * sizeof(float)));
+	for(vector<XObjKey>::iterator i = k.begin(); i != k.end(); ++i)
+	{
+		i->key = r.f();
+		r.fv(i->v, 3);
+	}
+}
+
+bool	XObj8WriteBinary(const char * inFile, const XObj8& inObj, long long inSrcSize, long long inSrcTime, const char * inSrcPath)
+{
+	xobj8_bin_writer w;
+
+	xobj8_bin_header h;
+	memset(&h, 0, sizeof(h));
+	h.magic = XOBJ8_BIN_MAGIC;
+	h.version = XOBJ8_BIN_VERSION;
+	h.sizeof_ptr = sizeof(void *);
+	h.path_len = strlen(inSrcPath);
+	h.src_size = inSrcSize;
+	h.src_time = inSrcTime;
+	w.raw(&h, sizeof(h));
+	w.raw(inSrcPath, h.path_len);
+
+	w.s(inObj.texture);
+	w.s(inObj.texture_normal_map);
+	w.s(inObj.texture_lit);
+	w.s(inObj.texture_draped);
+	w.i(inObj.use_metalness);
+	w.i(inObj.glass_blending);
+	w.s(inObj.particle_system);
+	w.pod(inObj.regions);
+	w.pod(inObj.indices);
+	w.pool(inObj.geo_tri, 8);
+	w.pool(inObj.geo_lines, 6);
+	w.pool(inObj.geo_lights, 6);
+
+	w.i(inObj.animation.size());
+	for(vector<XObjAnim8>::const_iterator a = inObj.animation.begin(); a != inObj.animation.end(); ++a)
+	{
+		w.i(a->cmd);
+		w.s(a->dataref);
+		w.fv(a->axis, 3);
+		w.f(a->loop);
+		xobj8_bin_keys(w, a->keyframes);
+	}
+
+	w.i(inObj.manips.size());
+	for(vector<XObjManip8>::const_iterator m = inObj.manips.begin(); m != inObj.manips.end(); ++m)
+	{
+		w.s(m->dataref1);
+		w.s(m->dataref2);
+		w.fv(m->centroid, 3);
+		w.fv(m->axis, 3);
+		w.f(m->angle_min);
+		w.f(m->angle_max);
+		w.f(m->lift);
+		w.f(m->v1_min);
+		w.f(m->v1_max);
+		w.f(m->v2_min);
+		w.f(m->v2_max);
+		w.s(m->cursor);
+		w.s(m->tooltip);
+		w.f(m->mouse_wheel_delta);
+		xobj8_bin_keys(w, m->rotation_key_frames);
+		w.pod(m->detents);
+	}
+
+	w.i(inObj.emitters.size());
+	for(vector<XObjEmitter8>::const_iterator e = inObj.emitters.begin(); e != inObj.emitters.end(); ++e)
+	{
+		w.s(e->name);
+		w.s(e->dataref);
+		w.f(e->x);		w.f(e->y);		w.f(e->z);
+		w.f(e->psi);	w.f(e->the);	w.f(e->phi);
+		w.f(e->v_min);	w.f(e->v_max);
+	}
+
+	w.i(inObj.lods.size());
+	for(vector<XObjLOD8>::const_iterator l = inObj.lods.begin(); l != inObj.lods.end(); ++l)
+	{
+		w.f(l->lod_near);
+		w.f(l->lod_far);
+		w.i(l->cmds.size());
+		for(vector<XObjCmd8>::const_iterator c = l->cmds.begin(); c != l->cmds.end(); ++c)
+		{
+			w.i(c->cmd);
+			w.fv(c->params, 12);
+			w.s(c->name);
+			w.i(c->idx_offset);
+			w.i(c->idx_count);
+		}
+	}
+
+	w.fv(inObj.xyz_min, 3);
+	w.fv(inObj.xyz_max, 3);
+	w.f(inObj.fixed_heading);
+	w.s(inObj.description);
+
+	// Write to a temp file and move it into place, so a crash or a second writer never leaves a torn cache file.
+	string tmp_path(inFile);
+	tmp_path += ".tmp";
+	FILE * fi = fopen(tmp_path.c_str(), "wb");
+	if(fi == NULL) return false;
+	bool ok = fwrite(&w.buf[0], 1, w.buf.size(), fi) == w.buf.size();
+	if(fclose(fi) != 0) ok = false;
+	if(ok && rename(tmp_path.c_str(), inFile) != 0)
+	{
+		remove(inFile);										// Windows won't rename over an existing file.
+		ok = rename(tmp_path.c_str(), inFile) == 0;
+	}
+	if(!ok)
+		remove(tmp_path.c_str());
+	return ok;
+}
+
+bool	XObj8ReadBinary(const char * inFile, XObj8& outObj, long long inSrcSize, long long inSrcTime, const char * inSrcPath)
+{
+	FILE * fi = fopen(inFile, "rb");
+	if(fi == NULL) return false;
+	fseek(fi, 0L, SEEK_END);
+	long filesize = ftell(fi);
+	fseek(fi, 0L, SEEK_SET);
+	if(filesize < (long) sizeof(xobj8_bin_header)) { fclose(fi); return false; }
+	vector<char> mem(filesize);
+	bool got = fread(&mem[0], 1, filesize, fi) == filesize;
+	fclose(fi);
+	if(!got) return false;
+
+	xobj8_bin_reader r(&mem[0], &mem[0] + filesize);
+
+	xobj8_bin_header h;
+	r.raw(&h, sizeof(h));
+	if(h.magic != XOBJ8_BIN_MAGIC || h.version != XOBJ8_BIN_VERSION || h.sizeof_ptr != sizeof(void *) ||
+	   h.src_size != inSrcSize || h.src_time != inSrcTime || h.path_len != (int) strlen(inSrcPath))
+		return false;
+	if(filesize - (long) sizeof(h) < h.path_len || memcmp(r.p, inSrcPath, h.path_len) != 0)
+		return false;
+	r.p += h.path_len;
+
+	XObj8	obj;
+
+	r.s(obj.texture);
+	r.s(obj.texture_normal_map);
+	r.s(obj.texture_lit);
+	r.s(obj.texture_draped);
+	obj.use_metalness = r.i();
+	obj.glass_blending = r.i();
+	r.s(obj.particle_system);
+	r.pod(obj.regions);
+	r.pod(obj.indices);
+	r.pool(obj.geo_tri, 8);
+	r.pool(obj.geo_lines, 6);
+	r.pool(obj.geo_lights, 6);
+#if XOBJ8_USE_VBO
+	obj.geo_VBO = 0;
+	obj.idx_VBO = 0;
+#endif
+
+	obj.animation.resize(r.count(sizeof(int)));
+	for(vector<XObjAnim8>::iterator a = obj.animation.begin(); a != obj.animation.end(); ++a)
+	{
+		a->cmd = r.i();
+		r.s(a->dataref);
+		r.fv(a->axis, 3);
+		a->loop = r.f();
+		xobj8_bin_keys(r, a->keyframes);
+	}
+
+	obj.manips.resize(r.count(sizeof(int)));
+	for(vector<XObjManip8>::iterator m = obj.manips.begin(); m != obj.manips.end(); ++m)
+	{
+		r.s(m->dataref1);
+		r.s(m->dataref2);
+		r.fv(m->centroid, 3);
+		r.fv(m->axis, 3);
+		m->angle_min = r.f();
+		m->angle_max = r.f();
+		m->lift = r.f();
+		m->v1_min = r.f();
+		m->v1_max = r.f();
+		m->v2_min = r.f();
+		m->v2_max = r.f();
+		r.s(m->cursor);
+		r.s(m->tooltip);
+		m->mouse_wheel_delta = r.f();
+		xobj8_bin_keys(r, m->rotation_key_frames);
+		r.pod(m->detents);
+	}
+
+	obj.emitters.resize(r.count(sizeof(int)));
+	for(vector<XObjEmitter8>::iterator e = obj.emitters.begin(); e != obj.emitters.end(); ++e)
+	{
+		r.s(e->name);
+		r.s(e->dataref);
+		e->x = r.f();		e->y = r.f();		e->z = r.f();
+		e->psi = r.f();		e->the = r.f();		e->phi = r.f();
+		e->v_min = r.f();	e->v_max = r.f();
+	}
+
+	obj.lods.resize(r.count(2 * sizeof(float)));
+	for(vector<XObjLOD8>::iterator l = obj.lods.begin(); l != obj.lods.end(); ++l)
+	{
+		l->lod_near = r.f();
+		l->lod_far = r.f();
+		l->cmds.resize(r.count(sizeof(int)));
+		for(vector<XObjCmd8>::iterator c = l->cmds.begin(); c != l->cmds.end(); ++c)
+		{
+			c->cmd = r.i();
+			r.fv(c->params, 12);
+			r.s(c->name);
+			c->idx_offset = r.i();
+			c->idx_count = r.i();
+		}
+	}
+
+	r.fv(obj.xyz_min, 3);
+	r.fv(obj.xyz_max, 3);
+	obj.fixed_heading = r.f();
+	r.s(obj.description);
+
+	if(!r.ok || r.p != r.e)
+		return false;
+
+	outObj = obj;
+	return true;
+}
+
+bool	XObj8ReadCached(const char * inFile, XObj8& outObj, const char * inCacheDir)
+{
+	struct stat ss;
+	if(inCacheDir == NULL || *inCacheDir == 0 || stat(inFile, &ss) != 0)
+		return XObj8Read(inFile, outObj);
+
+	// Cache files are named by a hash of the full path; the header carries the path itself so collisions just miss.
+	unsigned long long h = 14695981039346656037ULL;
+	for(const char * c = inFile; *c; ++c)
+	{
+		h ^= (unsigned char) *c;
+		h *= 1099511628211ULL;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.xob8", h);
+	string cache_path(inCacheDir);
+	if(cache_path[cache_path.size()-1] != '/' && cache_path[cache_path.size()-1] != '\\')
+		cache_path += '/';
+	cache_path += name;
+
+	long long src_size = ss.st_size;
+	long long src_time = ss.st_mtime;
+
+	if(XObj8ReadBinary(cache_path.c_str(), outObj, src_size, src_time, inFile))
+		return true;
+
+	if(!XObj8Read(inFile, outObj))
+		return false;
+
+	XObj8WriteBinary(cache_path.c_str(), outObj, src_size, src_time, inFile);
+	return true;
+}
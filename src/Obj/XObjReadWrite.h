@@ -32,4 +32,12 @@ bool	XObjWrite(const char * inFile, const XObj& inObj);
 bool	XObj8Read(const char * inFile, XObj8& outObj);
 bool	XObj8Write(const char * inFile, const XObj8& outObj);
 
+// Binary snapshot of a parsed XObj8.  The format is native-endian and versioned - it is a cache, not an interchange format.
+bool	XObj8ReadBinary(const char * inFile, XObj8& outObj, long long inSrcSize, long long inSrcTime, const char * inSrcPath);
+bool	XObj8WriteBinary(const char * inFile, const XObj8& inObj, long long inSrcSize, long long inSrcTime, const char * inSrcPath);
+
+// Like XObj8Read, but keeps a binary copy of every parsed object in inCacheDir, keyed by path, size and mod time.
+// A missing or stale cache entry just means a text parse.  Pass NULL or "" for inCacheDir to not cache at all.
+bool	XObj8ReadCached(const char * inFile, XObj8& outObj, const char * inCacheDir);
+
 #endif
@@ -32,6 +32,13 @@
 #include "MapTopology.h"
 #include "MapHelpers.h"
 #include "PolyRasterUtils.h"
+#include "RTree2.h"
+#include "FileUtils.h"
+#include <sys/stat.h>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
 
 //#include <CGAL/Snap_rounding_2.h>
 //#include <CGAL/Snap_rounding_traits_2.h>
@@ -163,15 +170,16 @@ static int					sLayerID;
 
 
 static projPJ 				sProj=NULL;
+static vector<string>		sProjArgs;			// PROJ params as read, so worker threads can make their own projection.
 
-static void reproj(Point2& io_pt)
+static void reproj(Point2& io_pt, projPJ proj = sProj)
 {
 	projXY xy;
 	projLP lp;
     xy.u = io_pt.x();
     xy.v = io_pt.y();
 
-	lp = pj_inv( xy, sProj);
+	lp = pj_inv( xy, proj);
 
 	io_pt.x_ = lp.u * RAD_TO_DEG;
 	io_pt.y_ = lp.v * RAD_TO_DEG;
@@ -272,6 +280,7 @@ static bool ShapeLineImporter(const vector<string>& inTokenLine, void * inRef)
 	if(inTokenLine[0] == "PROJ")
 	{
 		vector<char*> args;
+		sProjArgs.assign(inTokenLine.begin()+1, inTokenLine.end());
 		for(int n = 1; n < inTokenLine.size(); ++n)
 			args.push_back(strdup(inTokenLine[n].c_str()));
 		if(sProj) pj_free(sProj);
@@ -506,6 +515,444 @@ struct shape_lock_traits {
 	}
 };
 
+/************************************************************************************************************************************
+ * RECORD BOUNDS INDEX
+ ************************************************************************************************************************************
+
+	When we crop, most records of a big shape file are nowhere near our tile, and decoding them just to throw them away is most of
+	the import time.  Instead we pull only the record bounding boxes out of the .shp (the .shx gives us each record's offset and the
+	box sits right after the shape type), drop them into an RTree2 and only decode what the crop box hits.
+
+	The boxes are cached next to the shape file in a ".xbb" sidecar, keyed by the size and mod date of the .shp, so cutting many
+	tiles out of the same file only pays for the scan once.  If we can't write the sidecar we just rescan next time.
+
+ */
+
+#define	SHAPE_BOUNDS_MAGIC		0x58424231		// 'XBB1'
+
+struct shape_bounds_t {
+	double	lo[2];
+	double	hi[2];									// Null shapes get lo > hi so they never match.
+};
+
+struct shape_bounds_header_t {
+	uint32_t	magic;
+	uint32_t	count;
+	int64_t		shp_size;
+	int64_t		shp_mtime;
+};
+
+static int32_t	shp_be_int(const unsigned char * p) { return (int32_t) (((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | (uint32_t) p[3]); }
+static int32_t	shp_le_int(const unsigned char * p) { return (int32_t) (((uint32_t) p[3] << 24) | ((uint32_t) p[2] << 16) | ((uint32_t) p[1] << 8) | (uint32_t) p[0]); }
+static double	shp_le_dbl(const unsigned char * p)
+{
+	uint64_t	bits = 0;
+	for(int n = 7; n >= 0; --n)
+		bits = (bits << 8) | p[n];
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+static string shape_file_base(const char * in_file)
+{
+	string base(in_file);
+	string ext = FILE_get_file_extension(base);
+	if(ext == "shp" || ext == "shx" || ext == "dbf")
+		base.erase(base.size() - 4);
+	return base;
+}
+
+static FILE * open_shape_part(const string& base, const char * lower, const char * upper)
+{
+	FILE * fi = fopen((base + lower).c_str(), "rb");
+	if(fi == NULL)
+		fi = fopen((base + upper).c_str(), "rb");
+	return fi;
+}
+
+// Scan the .shx/.shp pair for record bounds without decoding any geometry.
+static bool scan_shape_bounds(const string& base, int entity_count, vector<shape_bounds_t>& out_bounds)
+{
+	FILE * shx = open_shape_part(base, ".shx", ".SHX");
+	FILE * shp = open_shape_part(base, ".shp", ".SHP");
+	bool ok = shx && shp;
+
+	out_bounds.resize(entity_count);
+	unsigned char	idx[8], rec[44];
+	if(ok) ok = fseek(shx, 100, SEEK_SET) == 0;
+	for(int n = 0; ok && n < entity_count; ++n)
+	{
+		shape_bounds_t& b(out_bounds[n]);
+		b.lo[0] = b.lo[1] = 1.0;
+		b.hi[0] = b.hi[1] = -1.0;
+
+		if(fread(idx, 1, 8, shx) != 8)												{ ok = false; break; }
+		long	offset = (long) shp_be_int(idx) * 2;
+		int		length = shp_be_int(idx+4) * 2;
+		if(length < 4)																continue;
+		if(fseek(shp, offset, SEEK_SET) != 0)										{ ok = false; break; }
+		size_t	want = min(length, 36) + 8;
+		if(fread(rec, 1, want, shp) != want)										{ ok = false; break; }
+
+		switch(shp_le_int(rec+8)) {
+		case SHPT_POINT:
+		case SHPT_POINTZ:
+		case SHPT_POINTM:
+			if(want >= 28)
+			{
+				b.lo[0] = b.hi[0] = shp_le_dbl(rec+12);
+				b.lo[1] = b.hi[1] = shp_le_dbl(rec+20);
+			}
+			break;
+		case SHPT_NULL:
+			break;
+		default:
+			if(want >= 44)
+			{
+				b.lo[0] = shp_le_dbl(rec+12);
+				b.lo[1] = shp_le_dbl(rec+20);
+				b.hi[0] = shp_le_dbl(rec+28);
+				b.hi[1] = shp_le_dbl(rec+36);
+			}
+			break;
+		}
+	}
+
+	if(shx) fclose(shx);
+	if(shp) fclose(shp);
+	return ok;
+}
+
+static bool read_shape_bounds(const char * in_file, int entity_count, vector<shape_bounds_t>& out_bounds)
+{
+	string base = shape_file_base(in_file);
+	string shp_path = base + ".shp";
+	struct stat	meta;
+	if(FILE_get_file_meta_data(shp_path, meta) != 0)
+	{
+		shp_path = base + ".SHP";
+		if(FILE_get_file_meta_data(shp_path, meta) != 0)
+			return false;
+	}
+
+	string	cache_path = base + ".xbb";
+	shape_bounds_header_t	h;
+	if(FILE * fi = fopen(cache_path.c_str(), "rb"))
+	{
+		bool ok = fread(&h, sizeof(h), 1, fi) == 1 &&
+				  h.magic == SHAPE_BOUNDS_MAGIC &&
+				  h.count == entity_count &&
+				  h.shp_size == (int64_t) meta.st_size &&
+				  h.shp_mtime == (int64_t) meta.st_mtime;
+		if(ok)
+		{
+			out_bounds.resize(entity_count);
+			ok = entity_count == 0 || fread(&out_bounds[0], sizeof(shape_bounds_t), entity_count, fi) == entity_count;
+		}
+		fclose(fi);
+		if(ok)
+			return true;
+	}
+
+	if(!scan_shape_bounds(base, entity_count, out_bounds))
+		return false;
+
+	// The sidecar is in native byte order - it is a cache, not an interchange format.
+	h.magic = SHAPE_BOUNDS_MAGIC;
+	h.count = entity_count;
+	h.shp_size = meta.st_size;
+	h.shp_mtime = meta.st_mtime;
+	if(FILE * fo = fopen(cache_path.c_str(), "wb"))
+	{
+		bool ok = fwrite(&h, sizeof(h), 1, fo) == 1 &&
+				  (entity_count == 0 || fwrite(&out_bounds[0], sizeof(shape_bounds_t), entity_count, fo) == entity_count);
+		fclose(fo);
+		if(!ok)
+			FILE_delete_file(cache_path.c_str(), false);
+	}
+	return true;
+}
+
+// Find the records whose bounds hit the crop box, in file order.  Bounds are reprojected corner-wise, exactly the way
+// shape_in_bounds tests them.  If we can't get the bounds we fall back to visiting every record.
+static void find_shape_records(const char * in_file, int entity_count, bool use_crop, vector<int>& out_recs)
+{
+	out_recs.clear();
+	vector<shape_bounds_t>	rec_bounds;
+	if(use_crop && read_shape_bounds(in_file, entity_count, rec_bounds))
+	{
+		vector<pair<Bbox2,int> >	items;
+		items.reserve(entity_count);
+		for(int n = 0; n < entity_count; ++n)
+		{
+			const shape_bounds_t& b(rec_bounds[n]);
+			if(b.lo[0] > b.hi[0] || b.lo[1] > b.hi[1])
+				continue;
+			Point2	lo(b.lo[0],b.lo[1]);
+			Point2	hi(b.hi[0],b.hi[1]);
+			if(sProj)
+			{
+				reproj(lo);
+				reproj(hi);
+			}
+			items.push_back(pair<Bbox2,int>(Bbox2(lo,hi),n));
+		}
+		nuke_container(rec_bounds);
+
+		RTree2<int,16>	index;
+		index.insert(items.begin(), items.end());
+		nuke_container(items);
+		index.query_value(Bbox2(s_crop[0],s_crop[1],s_crop[2],s_crop[3]), back_inserter(out_recs));
+		sort(out_recs.begin(), out_recs.end());
+	}
+	else
+	{
+		out_recs.resize(entity_count);
+		for(int n = 0; n < entity_count; ++n)
+			out_recs[n] = n;
+	}
+}
+
+/************************************************************************************************************************************
+ * STREAMING IMPORT PIPELINE
+ ************************************************************************************************************************************
+
+	The import runs as a three stage pipeline so that memory stays bounded no matter how big the shape file is:
+
+	1. The calling thread reads a chunk of records with shapelib, does the bounding-box reject and the DBF feature filtering.
+	   Shapelib and DBF handles are not thread safe, so this stays serial.
+	2. Worker threads turn the records of that chunk into plain double coordinates: reprojection, grid rounding, duplicate
+	   removal and segment cropping.  While they run, the calling thread is already reading the next chunk.
+	3. Back on the calling thread the chunk is converted to CGAL curves in record order (so the result does not depend on
+	   thread timing), polygons are cleaned up and the curves are flushed into the arrangement in batches.
+
+	Only stage 2 is parallel - the exact kernel's points are reference counted handles that may not be touched from two
+	threads.  The workers are started once per import; each gets its own proj context since a projPJ may not be shared.
+
+ */
+
+#define	SHAPE_CHUNK_SIZE		4096			// Records per read chunk - we keep two chunks in flight.
+#define	SHAPE_INSERT_BATCH		500000			// Curves to accumulate before we insert into the arrangement.
+
+struct shape_job_t {
+	SHPObject *				obj;
+	int						rec;				// Record number - this is the key we put on our curves.
+	int						pts;				// Points for the DP stats.
+	vector<Point2>			segs;				// Arcs: segment end points, in pairs, already cropped.
+	vector<vector<Point2> >	rings;				// Polygons: one ring per part, without the closing point.
+};
+typedef vector<shape_job_t>	shape_chunk_t;
+
+static void build_shape_points(shape_job_t& job, shp_Flags flags, int grid_steps, projPJ proj)
+{
+	SHPObject * obj = job.obj;
+	switch(obj->nSHPType) {
+	case SHPT_POINT:
+	case SHPT_POINTZ:
+	case SHPT_POINTM:
+
+	case SHPT_ARC:
+	case SHPT_ARCZ:
+	case SHPT_ARCM:
+		for (int part = 0; part < obj->nParts; ++part)
+		{
+			int start_idx = obj->panPartStart[part];
+			int stop_idx = ((part+1) == obj->nParts) ? obj->nVertices : obj->panPartStart[part+1];
+			vector<Point2>	p;
+			for (int i = start_idx; i < stop_idx; ++i)
+			{
+				Point2 pt(obj->padfX[i],obj->padfY[i]);
+				if(proj)	   reproj(pt, proj);
+				if(grid_steps) round_grid(pt, grid_steps);
+				if(p.empty() || pt != p.back())
+					p.push_back(pt);
+			}
+			vector<Point2> reduced;
+			swap(p,reduced);
+
+			job.pts += p.size();
+			for(int i = 1; i < reduced.size(); ++i)
+			{
+				DebugAssert(reduced[i-1] != reduced[i]);
+				if(flags & shp_Use_Crop)
+				if ((reduced[i-1].x() < s_crop[0] && reduced[i].x() < s_crop[0]) ||
+					(reduced[i-1].x() > s_crop[2] && reduced[i].x() > s_crop[2]) ||
+					(reduced[i-1].y() < s_crop[1] && reduced[i].y() < s_crop[1]) ||
+					(reduced[i-1].y() > s_crop[3] && reduced[i].y() > s_crop[3]))
+					continue;
+				job.segs.push_back(reduced[i-1]);
+				job.segs.push_back(reduced[i]);
+			}
+		}
+		break;
+	case SHPT_POLYGON:
+	case SHPT_POLYGONZ:
+	case SHPT_POLYGONM:
+		for (int part = 0; part < obj->nParts; ++part)
+		{
+			int start_idx = obj->panPartStart[part];
+			int stop_idx = ((part+1) == obj->nParts) ? obj->nVertices : obj->panPartStart[part+1];
+			job.rings.push_back(vector<Point2>());
+			vector<Point2>&	p(job.rings.back());
+			for (int i = start_idx; i < stop_idx; ++i)
+			{
+				Point2 pt(obj->padfX[i],obj->padfY[i]);
+				if(proj) reproj(pt, proj);
+				if(grid_steps) round_grid(pt, grid_steps);
+				if(p.empty() || pt != p.back())					// Do not add point if it equals the prev!
+					p.push_back(pt);
+			}
+
+			DebugAssert(p[0] == p[p.size()-1]);
+			while(p.size() > 0 && p[0] == p[p.size()-1])
+				p.pop_back();
+		}
+		break;
+	}
+}
+
+// Calling thread only: this is where the points become CGAL objects.
+static void build_shape_curves(const shape_job_t& job, vector<Curve_2>& curves)
+{
+	for(int i = 0; i < job.segs.size(); i += 2)
+		curves.push_back(Curve_2(Segment_2(ben2cgal<Point_2>(job.segs[i]),ben2cgal<Point_2>(job.segs[i+1])),job.rec));
+
+	for(vector<vector<Point2> >::const_iterator r = job.rings.begin(); r != job.rings.end(); ++r)
+	if(r->size() > 2)
+	{
+		Polygon_2	p;
+		for(vector<Point2>::const_iterator pt = r->begin(); pt != r->end(); ++pt)
+			p.push_back(ben2cgal<Point_2>(*pt));
+
+		if(p.is_simple())
+		{
+			for(int s = 0; s < p.size(); ++s)
+				curves.push_back(Curve_2(p.edge(s), job.rec));
+		}
+		else
+		{
+			vector<Polygon_2>	simple_ones;
+			MakePolygonSimple(p,simple_ones);
+			for(vector<Polygon_2>::iterator t = simple_ones.begin(); t != simple_ones.end(); ++t)
+			{
+				DebugAssert(t->is_simple());
+				DebugAssert(t->is_counterclockwise_oriented());
+				for(int s = 0; s < t->size(); ++s)
+					curves.push_back(Curve_2(t->edge(s), job.rec));
+			}
+		}
+	}
+}
+
+static projPJ make_thread_proj(void)
+{
+	if(sProjArgs.empty())
+		return NULL;
+	vector<char*> args;
+	for(int n = 0; n < sProjArgs.size(); ++n)
+		args.push_back(strdup(sProjArgs[n].c_str()));
+	projPJ proj = pj_init_ctx(pj_ctx_alloc(), args.size(), &*args.begin());
+	for(int n = 0; n < args.size(); ++n)
+		free(args[n]);
+	return proj;
+}
+
+static void free_thread_proj(projPJ proj)
+{
+	if(proj)
+	{
+		projCtx ctx = pj_get_ctx(proj);
+		pj_free(proj);
+		pj_ctx_free(ctx);
+	}
+}
+
+// The stage 2 workers.  Run() hands them a chunk and returns right away; Wait() blocks until they are done with it.  Workers
+// pull jobs off a shared counter so one monster polygon doesn't stall a whole slice.
+class shape_workers_t {
+public:
+
+	shape_workers_t(int count, shp_Flags flags, int grid_steps) :
+		mFlags(flags), mGridSteps(grid_steps), mChunk(NULL), mGeneration(0), mBusy(0), mQuit(false)
+	{
+		for(int t = 0; t < count; ++t)
+		{
+			mProjs.push_back(sProj ? make_thread_proj() : NULL);
+			mThreads.push_back(thread(&shape_workers_t::worker, this, t));
+		}
+	}
+
+	~shape_workers_t()
+	{
+		{
+			lock_guard<mutex> lock(mLock);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		for(vector<thread>::iterator t = mThreads.begin(); t != mThreads.end(); ++t)
+			t->join();
+		for(vector<projPJ>::iterator p = mProjs.begin(); p != mProjs.end(); ++p)
+			free_thread_proj(*p);
+	}
+
+	void	Run(shape_chunk_t& chunk)
+	{
+		{
+			lock_guard<mutex> lock(mLock);
+			mChunk = &chunk;
+			mNextJob = 0;
+			mBusy = mThreads.size();
+			++mGeneration;
+		}
+		mWake.notify_all();
+	}
+
+	void	Wait(void)
+	{
+		unique_lock<mutex> lock(mLock);
+		mIdle.wait(lock, [this] { return mBusy == 0; });
+	}
+
+private:
+
+	void	worker(int t)
+	{
+		int seen = 0;
+		unique_lock<mutex> lock(mLock);
+		while(1)
+		{
+			mWake.wait(lock, [this, seen] { return mQuit || mGeneration != seen; });
+			if(mQuit)
+				return;
+			seen = mGeneration;
+			shape_chunk_t& chunk(*mChunk);
+			lock.unlock();
+
+			int j;
+			while((j = mNextJob++) < chunk.size())
+				build_shape_points(chunk[j], mFlags, mGridSteps, mProjs[t]);
+
+			lock.lock();
+			if(--mBusy == 0)
+				mIdle.notify_all();
+		}
+	}
+
+	shp_Flags				mFlags;
+	int						mGridSteps;
+	vector<projPJ>			mProjs;
+	vector<thread>			mThreads;
+	mutex					mLock;
+	condition_variable		mWake;
+	condition_variable		mIdle;
+	shape_chunk_t *			mChunk;
+	atomic<int>				mNextJob;
+	int						mGeneration;
+	int						mBusy;
+	bool					mQuit;
+};
+
 bool	ReadShapeFile(const char * in_file, Pmwx& io_map, shp_Flags flags, const char * feature_desc, double bounds[4], double simplify_mtr, int grid_steps, ProgressFunc	inFunc)
 {
 		int		killed = 0, total = 0;
@@ -514,7 +961,7 @@ bool	ReadShapeFile(const char * in_file, Pmwx& io_map, shp_Flags flags, const ch
 		double	bounds_lo[4], bounds_hi[4];
 		static bool first_time = true;
 
-	if(sProj) pj_free(sProj);sProj=NULL;
+	if(sProj) pj_free(sProj);sProj=NULL;sProjArgs.clear();
 
 
 	for(int n = 0; n < 4; ++n)
@@ -630,195 +1077,117 @@ bool	ReadShapeFile(const char * in_file, Pmwx& io_map, shp_Flags flags, const ch
 	 * MAIN SHAPE READING LOOP
 	 ************************************************************************************************************************************/
 
-//	if (shape_type == SHPT_ARC ||
-//		shape_type == SHPT_ARCZ ||
-//		shape_type == SHPT_ARCM)
-//	for(int n = 0; n < entity_count; ++n)
-//	{
-//		SHPObject * obj = SHPReadObject(file, n);
-//		if((flags & shp_Use_Crop) == 0 || shape_in_bounds(obj))
-//		if(!db || ((feat = want_this_thing(db, obj->nShapeId, sShapeRules)) != -1))
-//		for (int part = 0; part < obj->nParts; ++part)
-//		{
-//			int start_idx = obj->panPartStart[part];
-//			int stop_idx = ((part+1) == obj->nParts) ? obj->nVertices : obj->panPartStart[part+1];
-//			for (int i = start_idx; i < stop_idx; ++i)
-//			{
-//				Point2 pt(obj->padfX[i],obj->padfY[i]);
-//				if(sProj)		reproj(pt);
-//				if(grid_steps)  round_grid(pt, grid_steps);
-//				nodes[pt]++;
-//			}
-//		}
-//		SHPDestroyObject(obj);
-//	}
-//	for(map<Point2,int,lesser_y_then_x>::iterator i = nodes.begin(); i != nodes.end();)
-//	{
-//		if(i->second < 2)
-//		{
-//			map<Point2,int>::iterator k = i;
-//			++i;
-//			nodes.erase(k);
-//		}
-//		else
-//			++i;
-//	}
-//	printf("%llu nodes locked.\n", (unsigned long long)nodes.size());
+	Pmwx	local;
+	Pmwx *	targ = (flags & shp_Overlay) ? &local : &io_map;
 
-	int step = entity_count ? (entity_count / 150) : 2;
-	for(int n = 0; n < entity_count; ++n)
-	{
-		PROGRESS_CHECK(inFunc, 0, 1, "Reading shape file...", n, entity_count, step)
-		SHPObject * obj = SHPReadObject(file, n);
-		if((flags & shp_Use_Crop) == 0 || shape_in_bounds(obj))
-		if(!db || want_this_thing(db, obj->nShapeId, sShapeRules, &feat))
-		switch(obj->nSHPType) {
-		case SHPT_POINT:
-		case SHPT_POINTZ:
-		case SHPT_POINTM:
+	// Error checking needs to see every curve at once, so we can only flush in batches when we are not checking.
+	bool	batch_insert = (flags & shp_ErrCheck) == 0;
 
-		case SHPT_ARC:
-		case SHPT_ARCZ:
-		case SHPT_ARCM:
-			if (obj->nVertices > 1)
-			{
-				feature_map[n] = feat;
-				if(db) {
-					feature_rev[n] = want_this_thing(db,obj->nShapeId, sLineReverse, NULL) ? 1 :0;
-					if(!sLayerTag.empty() && sLayerID != -1)
-						feature_lay[n] = DBFReadIntegerAttribute(db, obj->nShapeId, sLayerID);
-					if(sLayerTag.empty() || sLayerID == -1 || DBFIsAttributeNULL(db, obj->nShapeId, sLayerID))
-					want_this_thing(db,obj->nShapeId,sLineBridge, &feature_lay[n]);
+	shape_workers_t	workers(max(1, (int) thread::hardware_concurrency()), flags, grid_steps);
+
+	vector<int>		recs;
+	find_shape_records(in_file, entity_count, (flags & shp_Use_Crop) != 0, recs);
+
+	shape_chunk_t	chunks[2];
+	int				cur = 0;
+	int				ri = 0;
+	int				rec_count = recs.size();
+	int				step = rec_count ? (rec_count / 150) : 2;
+
+	do {
+		if(!chunks[cur].empty())
+			workers.Run(chunks[cur]);
+
+		// Stage 1: while the workers build curves for the current chunk, read and filter the next one.
+		shape_chunk_t& next(chunks[1-cur]);
+		while(ri < rec_count && next.size() < SHAPE_CHUNK_SIZE)
+		{
+			PROGRESS_CHECK(inFunc, 0, 1, "Reading shape file...", ri, rec_count, step)
+			int n = recs[ri++];
+			SHPObject * obj = SHPReadObject(file, n);
+			bool keep = false;
+			if((flags & shp_Use_Crop) == 0 || shape_in_bounds(obj))
+			if(!db || want_this_thing(db, obj->nShapeId, sShapeRules, &feat))
+			switch(obj->nSHPType) {
+			case SHPT_POINT:
+			case SHPT_POINTZ:
+			case SHPT_POINTM:
+
+			case SHPT_ARC:
+			case SHPT_ARCZ:
+			case SHPT_ARCM:
+				if (obj->nVertices > 1)
+				{
+					keep = true;
+					feature_map[n] = feat;
+					if(db) {
+						feature_rev[n] = want_this_thing(db,obj->nShapeId, sLineReverse, NULL) ? 1 :0;
+						if(!sLayerTag.empty() && sLayerID != -1)
+							feature_lay[n] = DBFReadIntegerAttribute(db, obj->nShapeId, sLayerID);
+						if(sLayerTag.empty() || sLayerID == -1 || DBFIsAttributeNULL(db, obj->nShapeId, sLayerID))
+						want_this_thing(db,obj->nShapeId,sLineBridge, &feature_lay[n]);
+					}
 				}
-				for (int part = 0; part < obj->nParts; ++part)
+				break;
+			case SHPT_POLYGON:
+			case SHPT_POLYGONZ:
+			case SHPT_POLYGONM:
+				if (obj->nVertices > 0)
 				{
-					int start_idx = obj->panPartStart[part];
-					int stop_idx = ((part+1) == obj->nParts) ? obj->nVertices : obj->panPartStart[part+1];
-					vector<Point2>	p;
-					for (int i = start_idx; i < stop_idx; ++i)
+					keep = true;
+					feature_map[n].feature = feat;
+					for(import_column_vector::iterator r = sImportColumns.begin(); r != sImportColumns.end(); ++r)
+					if(r->dbf_id != -1)
 					{
-						Point2 pt(obj->padfX[i],obj->padfY[i]);
-						if(sProj)	   reproj(pt);
-						if(grid_steps) round_grid(pt, grid_steps);
-						if(p.empty() || pt != p.back())
+						const char * field_val = DBFReadStringAttribute(db,obj->nShapeId,r->dbf_id);
+						if(field_val && field_val[0])
 						{
-							p.push_back(pt);
+							float f = TokenizeFloatWithEnum(field_val);
+							feature_map[n].params[r->rf_key] = f;
 						}
 					}
-					vector<Point2> reduced;
-					swap(p,reduced);
-
-					/*
-					// we could see what points we killed.
-					for(int dp=0;dp<p.size();++dp)
-					if(find(reduced.begin(),reduced.end(),p[dp])==reduced.end())
-						debug_mesh_point(p[dp],1,1,1);
-					*/
-
-					total += (p.size());
-//					DebugAssert(reduced.size() >= 2);
-					for(int i = 1; i < reduced.size(); ++i)
-					{
-						DebugAssert(reduced[i-1] != reduced[i]);
-						bool oob = false;
-						if(flags & shp_Use_Crop)
-						if ((reduced[i-1].x() < s_crop[0]  && reduced[i].x() < s_crop[0] ) ||
-							(reduced[i-1].x() > s_crop[2]  && reduced[i].x() > s_crop[2] ) ||
-							(reduced[i-1].y() < s_crop[1] && reduced[i].y() < s_crop[1] ) ||
-							(reduced[i-1].y() > s_crop[3] && reduced[i].y() > s_crop[3] ))
-							oob = true;
-						if(!oob)
-						ADD_PT_PAIR(
-							ben2cgal<Point_2>(reduced[i-1]),
-							ben2cgal<Point_2>(reduced[i]),
-							reduced[i-1],
-							reduced[i],
-							n);
-					}
 				}
+				break;
+			case SHPT_MULTIPOINT:
+			case SHPT_MULTIPOINTZ:
+			case SHPT_MULTIPOINTM:
+			case SHPT_MULTIPATCH:
+				break;
 			}
-			break;
-		case SHPT_POLYGON:
-		case SHPT_POLYGONZ:
-		case SHPT_POLYGONM:
-			if (obj->nVertices > 0)
+			if(keep)
 			{
-				feature_map[n].feature = feat;
-				for(import_column_vector::iterator r = sImportColumns.begin(); r != sImportColumns.end(); ++r)
-				if(r->dbf_id != -1)
-				{
-					const char * field_val = DBFReadStringAttribute(db,obj->nShapeId,r->dbf_id);
-					if(field_val && field_val[0])
-					{
-						float f = TokenizeFloatWithEnum(field_val);
-						feature_map[n].params[r->rf_key] = f;
-					}
-				}
-
-				for (int part = 0; part < obj->nParts; ++part)
-				{
-					int start_idx = obj->panPartStart[part];
-					int stop_idx = ((part+1) == obj->nParts) ? obj->nVertices : obj->panPartStart[part+1];
-					Polygon_2	p;
-					for (int i = start_idx; i < stop_idx; ++i)
-					{
-						Point_2 pt(obj->padfX[i],obj->padfY[i]);
-						if(grid_steps || sProj)
-						{
-							Point2 raw_pt(obj->padfX[i],obj->padfY[i]);
-							if(sProj) reproj(raw_pt);
-							if(grid_steps) round_grid(raw_pt, grid_steps);
-							pt = ben2cgal<Point_2>(raw_pt);
-						}
-						if(p.is_empty() || pt != p.vertex(p.size()-1))					// Do not add point if it equals the prev!
-							p.push_back(pt);
-					}
+				next.push_back(shape_job_t());
+				next.back().obj = obj;
+				next.back().rec = n;
+				next.back().pts = 0;
+			}
+			else
+				SHPDestroyObject(obj);
+		}
 
-					DebugAssert(p[0] == p[p.size()-1]);
-					while(p.size() > 0 && p[0] == p[p.size()-1])
-						p.erase(p.vertices_end()-1);
+		if(!chunks[cur].empty())
+			workers.Wait();
 
-					if(p.size() > 2)
-					{
-						if(p.is_simple())
-						{
-							for(int s = 0; s < p.size(); ++s)
-							{
-								curves.push_back(Curve_2(p.edge(s), n));
-							}
-
-						} else {
-
-							vector<Polygon_2>	simple_ones;
-							MakePolygonSimple(p,simple_ones);
-							#if DEV
-							for(vector<Polygon_2>::iterator t = simple_ones.begin(); t != simple_ones.end(); ++t)
-							{
-								DebugAssert(t->is_simple());
-								DebugAssert(t->is_counterclockwise_oriented());
-							}
-							#endif
-							for(vector<Polygon_2>::iterator t = simple_ones.begin(); t != simple_ones.end(); ++t)
-							{
-								for(int s = 0; s < t->size(); ++s)
-								{
-									curves.push_back(Curve_2(t->edge(s), n));
-								}
-							}
-						}
-					}
-				}
+		// Stage 3: make curves in record order and hand them to the arrangement once we have a decent batch.
+		for(shape_chunk_t::iterator j = chunks[cur].begin(); j != chunks[cur].end(); ++j)
+		{
+			total += j->pts;
+			build_shape_curves(*j, curves);
+			SHPDestroyObject(j->obj);
+		}
+		chunks[cur].clear();
 
-			}
-			break;
-		case SHPT_MULTIPOINT:
-		case SHPT_MULTIPOINTZ:
-		case SHPT_MULTIPOINTM:
-		case SHPT_MULTIPATCH:
-			break;
+		if(batch_insert && curves.size() >= SHAPE_INSERT_BATCH)
+		{
+			CGAL::insert(*targ, curves.begin(), curves.end());
+			curves.clear();
 		}
-		SHPDestroyObject(obj);
-	}
+
+		cur = 1-cur;
+	} while(!chunks[cur].empty() || ri < rec_count);
+
+	SHPClose(file);
+	if(db)	DBFClose(db);
 
 	PROGRESS_DONE(inFunc, 0, 1, "Reading shape file...")
 
@@ -865,9 +1234,6 @@ bool	ReadShapeFile(const char * in_file, Pmwx& io_map, shp_Flags flags, const ch
 							entity_count+3);
 	}
 
-	Pmwx	local;
-	Pmwx *	targ = (flags & shp_Overlay) ? &local : &io_map;
-
 	if(flags & shp_ErrCheck)
 	{
 		Traits_2			tr;
@@ -880,9 +1246,6 @@ bool	ReadShapeFile(const char * in_file, Pmwx& io_map, shp_Flags flags, const ch
 		}
 	}
 
-	SHPClose(file);
-	if(db)	DBFClose(db);
-
 //	printf("Inserting %d curves into %d.\n", curves.size(), targ->number_of_edges());
 //	ISR(curves);
 	CGAL::insert(*targ, curves.begin(), curves.end());
@@ -1118,7 +1481,7 @@ bool	RasterShapeFile(
 		double	bounds_lo[4], bounds_hi[4];
 		static	bool first_time = true;
 
-	if(sProj) pj_free(sProj);sProj=NULL;
+	if(sProj) pj_free(sProj);sProj=NULL;sProjArgs.clear();
 
 	s_crop[0] = dem.mWest;
 	s_crop[1] = dem.mSouth;
@@ -1217,11 +1580,15 @@ bool	RasterShapeFile(
 	 * MAIN SHAPE READING LOOP
 	 ************************************************************************************************************************************/
 
-	int step = entity_count ? (entity_count / 150) : 2;
-	for(int n = 0; n < entity_count; ++n)
+	vector<int>	recs;
+	find_shape_records(inFile, entity_count, (flags & shp_Use_Crop) != 0, recs);
+
+	int rec_count = recs.size();
+	int step = rec_count ? (rec_count / 150) : 2;
+	for(int ri = 0; ri < rec_count; ++ri)
 	{
-		PROGRESS_CHECK(inFunc, 0, 1, "Reading shape file...", n, entity_count, step)
-		SHPObject * obj = SHPReadObject(file, n);
+		PROGRESS_CHECK(inFunc, 0, 1, "Reading shape file...", ri, rec_count, step)
+		SHPObject * obj = SHPReadObject(file, recs[ri]);
 		if((flags & shp_Use_Crop) == 0 || shape_in_bounds(obj))
 		if(!db || want_this_thing(db, obj->nShapeId, sShapeRules, &feat))
 		switch(obj->nSHPType) {
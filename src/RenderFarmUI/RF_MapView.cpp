@@ -1327,7 +1327,7 @@ put in  color enums?
 			Pmwx::Face_handle f = *gFaceSelection.begin();
 			for(GISParamMap::iterator i = f->data().mParams.begin(); i != f->data().mParams.end(); ++i)
 			{
-				if(i->second == floor(i->second) && i->second >= 0 && i->second < gTokens.size())
+				if(i->second == floor(i->second) && i->second >= 0 && i->second < CountTokens())
 				{
 					sprintf(buf,"%s: %s (%d)", FetchTokenString(i->first), FetchTokenString(floor(i->second)), (int) floor(i->second));
 				}
@@ -28,9 +28,9 @@
 #include "MathUtils.h"
 #include "Interpolation.h"
 #include "squish.h"
+#include "WorkerPool.h"
 
 #include <errno.h>
-#include <thread>
 #include <png.h>
 #include <zlib.h>
 
@@ -1094,16 +1094,69 @@ int		CreateBitmapFromJPEGData(void * inBytes, int inLength, struct ImageInfo * o
 void my_error  (png_structp,png_const_charp err){}
 void my_warning(png_structp,png_const_charp err){}
 
-const char *			png_start_pos 	= NULL;
-const char *			png_end_pos 	= NULL;
-const char *			png_current_pos	= NULL;
+// Where png_buffered_read_func reads from - one per decode, so PNGs can be read on several threads at once.
+struct png_mem_reader {
+	const char *	cur;
+	const char *	end;
+};
 
 void png_buffered_read_func(png_structp png_ptr, png_bytep data, png_size_t length)
 {
-   if((png_current_pos+length)>png_end_pos)
+	png_mem_reader * r = (png_mem_reader *) png_get_io_ptr(png_ptr);
+	if((r->cur+length)>r->end)
 		png_error(png_ptr,"PNG Read Error, overran end of buffer!");
-   memcpy(data,png_current_pos,length);
-   png_current_pos+=length;
+	memcpy(data,r->cur,length);
+	r->cur+=length;
+}
+
+static void png_file_read_func(png_structp png_ptr, png_bytep data, png_size_t length)
+{
+	if(fread(data, 1, length, (FILE *) png_get_io_ptr(png_ptr)) != length)
+		png_error(png_ptr,"PNG Read Error, unexpected end of file!");
+}
+
+// Sets up gamma and pixel format conversion once the header is read; returns the channel count the rows will have, or 0 if unsupported.
+// Must be called under the caller's setjmp.
+static int png_setup_transforms(png_structp pngPtr, png_infop infoPtr, bool leaveIndexed, float target_gamma)
+{
+	png_uint_32	width, height;
+	int bit_depth,color_type,interlace_type,compression_type,P_filter_type;
+	double lcl_gamma;
+	int channels;
+
+	png_get_IHDR(pngPtr,infoPtr,&width,&height,
+			&bit_depth,&color_type,&interlace_type,
+			&compression_type,&P_filter_type);
+
+	if(target_gamma)
+	{
+		if(  png_get_gAMA (pngPtr,infoPtr     ,&lcl_gamma))		// Perhaps the file has its gamma recorded, for example by photoshop. Just tell png to callibrate for our hw platform.
+			 png_set_gamma(pngPtr,target_gamma, lcl_gamma);
+		else png_set_gamma(pngPtr,target_gamma, 1.0/GAMMA_SRGB);// Ben says: starting with WED 1.4, assume PC gamma for untagged files.  We haven't had Mac gamma since 10.5, so better to make sure that untagged files are interpretted as sRGB.
+	}
+
+	if(color_type==PNG_COLOR_TYPE_PALETTE && bit_depth<= 8)if (!leaveIndexed)	png_set_expand	  (pngPtr);
+	if(color_type==PNG_COLOR_TYPE_GRAY    && bit_depth<  8)						png_set_expand	  (pngPtr);
+	if(png_get_valid(pngPtr,infoPtr,PNG_INFO_tRNS)        )						png_set_expand	  (pngPtr);
+	if(										 bit_depth==16)						png_set_strip_16  (pngPtr);
+	if(										 bit_depth<  8)						png_set_packing	  (pngPtr);
+	if(            color_type==PNG_COLOR_TYPE_GRAY		  )if (!leaveIndexed)	png_set_gray_to_rgb (pngPtr);
+	if(            color_type==PNG_COLOR_TYPE_GRAY_ALPHA  )if (!leaveIndexed)	png_set_gray_to_rgb (pngPtr);
+	switch(color_type) {
+	case PNG_COLOR_TYPE_GRAY:		channels = leaveIndexed ? 1 : 3;		break;
+	case PNG_COLOR_TYPE_GRAY_ALPHA:	channels = leaveIndexed ? 2 : 4;		break;
+	case PNG_COLOR_TYPE_PALETTE:	channels = leaveIndexed ? 1 : 3;		break;
+	case PNG_COLOR_TYPE_RGB:		channels = 					3;		break;
+	case PNG_COLOR_TYPE_RGBA:		channels = 					4;		break;
+	default: return 0;
+	}
+
+	// Some pngs have PNG_INFO_tRNS as a transparent index color...since we set "expansion" on this,
+	// we need to update our channel count; lib png is going to write rgba data.
+	if(!leaveIndexed && png_get_valid(pngPtr,infoPtr,PNG_INFO_tRNS) && channels == 3)
+		channels = 4;
+
+	return channels;
 }
 
 // PNG is 0,0 = upper left so we vertically flip.  Lib gives us image in any component order we want.
@@ -1136,14 +1189,11 @@ int		CreateBitmapFromPNG(const char * fname, struct ImageInfo * outImageInfo, bo
 
 int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInfo * outImageInfo, bool leaveIndexed, float target_gamma)
 {
-	png_uint_32	width, height;
-	int bit_depth,color_type,interlace_type,compression_type,P_filter_type;
-	double lcl_gamma, screen_gamma;
-
 	png_structp		pngPtr = NULL;
 	png_infop		infoPtr = NULL;
 	outImageInfo->data = NULL;
 	char** 			rows = NULL;
+	png_mem_reader	reader;
 
 	pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING,(png_voidp)NULL,my_error,my_warning);
 	if(!pngPtr) goto bail;
@@ -1151,11 +1201,10 @@ int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInf
 	infoPtr=png_create_info_struct(pngPtr);
 	if(!infoPtr) goto bail;
 
-	png_start_pos = (const char *) inStart;
-	png_current_pos = (const char *) inStart;
-	png_end_pos = (const char *) inStart + inLength;
+	reader.cur = (const char *) inStart;
+	reader.end = (const char *) inStart + inLength;
 
-	if (png_sig_cmp((unsigned char *) png_current_pos,0,8)) goto bail;
+	if (png_sig_cmp((unsigned char *) reader.cur,0,8)) goto bail;
 
 	png_set_interlace_handling(pngPtr);
 
@@ -1165,45 +1214,14 @@ int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInf
 	}
 
 	png_init_io      (pngPtr,NULL						);
-	png_set_read_fn  (pngPtr,NULL,png_buffered_read_func);
-	png_set_sig_bytes(pngPtr,8							);	png_current_pos+=8;
+	png_set_read_fn  (pngPtr,&reader,png_buffered_read_func);
+	png_set_sig_bytes(pngPtr,8							);	reader.cur+=8;
 	png_read_info	 (pngPtr,infoPtr					);
 
-	png_get_IHDR(pngPtr,infoPtr,&width,&height,
-			&bit_depth,&color_type,&interlace_type,
-			&compression_type,&P_filter_type);
-
-	outImageInfo->width = width;
-	outImageInfo->height = height;
-
-
-	if(target_gamma)
-	{
-		if(  png_get_gAMA (pngPtr,infoPtr     ,&lcl_gamma))		// Perhaps the file has its gamma recorded, for example by photoshop. Just tell png to callibrate for our hw platform.
-			 png_set_gamma(pngPtr,target_gamma, lcl_gamma);
-		else png_set_gamma(pngPtr,target_gamma, 1.0/GAMMA_SRGB);// Ben says: starting with WED 1.4, assume PC gamma for untagged files.  We haven't had Mac gamma since 10.5, so better to make sure that untagged files are interpretted as sRGB.
-	}
-
-	if(color_type==PNG_COLOR_TYPE_PALETTE && bit_depth<= 8)if (!leaveIndexed)	png_set_expand	  (pngPtr);
-	if(color_type==PNG_COLOR_TYPE_GRAY    && bit_depth<  8)						png_set_expand	  (pngPtr);
-	if(png_get_valid(pngPtr,infoPtr,PNG_INFO_tRNS)        )						png_set_expand	  (pngPtr);
-	if(										 bit_depth==16)						png_set_strip_16  (pngPtr);
-	if(										 bit_depth<  8)						png_set_packing	  (pngPtr);
-	if(            color_type==PNG_COLOR_TYPE_GRAY		  )if (!leaveIndexed)	png_set_gray_to_rgb (pngPtr);
-	if(            color_type==PNG_COLOR_TYPE_GRAY_ALPHA  )if (!leaveIndexed)	png_set_gray_to_rgb (pngPtr);
-	switch(color_type) {
-	case PNG_COLOR_TYPE_GRAY:		outImageInfo->channels = leaveIndexed ? 1 : 3;		break;
-	case PNG_COLOR_TYPE_GRAY_ALPHA:	outImageInfo->channels = leaveIndexed ? 2 : 4;		break;
-	case PNG_COLOR_TYPE_PALETTE:	outImageInfo->channels = leaveIndexed ? 1 : 3;		break;
-	case PNG_COLOR_TYPE_RGB:		outImageInfo->channels = 					3;		break;
-	case PNG_COLOR_TYPE_RGBA:		outImageInfo->channels = 					4;		break;
-	default: goto bail;
-	}
-
-	// Some pngs have PNG_INFO_tRNS as a transparent index color...since we set "expansion" on this,
-	// we need to update our channel count; lib png is going to write rgba data.
-	if(!leaveIndexed && png_get_valid(pngPtr,infoPtr,PNG_INFO_tRNS) && outImageInfo->channels == 3)
-		outImageInfo->channels = 4;
+	outImageInfo->width = png_get_image_width(pngPtr,infoPtr);
+	outImageInfo->height = png_get_image_height(pngPtr,infoPtr);
+	outImageInfo->channels = png_setup_transforms(pngPtr, infoPtr, leaveIndexed, target_gamma);
+	if(outImageInfo->channels == 0) goto bail;
 
 	// Since we use "BGR" conventions ask PNG to just swap red-blue for us.
 	png_set_bgr(pngPtr);
@@ -1213,11 +1231,11 @@ int		CreateBitmapFromPNGData(const void * inStart, int inLength, struct ImageInf
 	outImageInfo->data = (unsigned char *) malloc(outImageInfo->width * outImageInfo->height * outImageInfo->channels);
 	if (!outImageInfo->data) goto bail;
 
-	rows=(char**)malloc(height*sizeof(char*));
+	rows=(char**)malloc(outImageInfo->height*sizeof(char*));
 	if (!rows) goto bail;
 
 	// Set our rows to reverse order to flip the image.
-	for(int i=0;i<height;i++)
+	for(int i=0;i<outImageInfo->height;i++)
 	{
 		rows[i]=(char*)outImageInfo->data     +((outImageInfo->height-1-i)*(outImageInfo->width)*(outImageInfo->channels));
 	}
@@ -1522,6 +1540,7 @@ static void	in_place_scaleY(int x, int y, unsigned char * src, unsigned char * d
 	   // WC relative gamma error 9% and maintains to_srgb(from_srgb(x)) == x  for all x
 	   // aproximation is to use (x-5)^2 and x^0.5+5 for x^2.4, x^(1/2.4) as a pretty close fit for x > 30/255,
 	   // and adjust the slope & intercept for the linear part of the curve as well
+		#define SRGB_APPROX_24 1
 		inline int to_srgb(float p)
 		{
 			 if (p < (31-5)*(31-5)) return p * 11.8/255.0 + 0.5;
@@ -1561,6 +1580,43 @@ static void	in_place_scaleY(int x, int y, unsigned char * src, unsigned char * d
 			}
 		}
 	}
+
+	#if SRGB_APPROX_24
+		// Tables and SSE2 helpers for copy_mip_srgb, the fast version of copy_mip_with_filter(..., average_with_gamma).
+		static const float * srgb_lut(void)
+		{
+			static struct lut_t {
+				float v[256];
+				lut_t() { for(int i = 0; i < 256; ++i) v[i] = from_srgb(i); }
+			} lut;
+			return lut.v;
+		}
+
+		#if defined(__SSE2__) || defined(_M_X64)
+			#include <emmintrin.h>
+			#define SRGB_SSE2 1
+
+			// 4 x average of 4 linear values -> 4 x intlim(to_srgb(x), 0, 255) in the low 4 bytes.
+			static inline int to_srgb_4(__m128 a, __m128 b, __m128 c, __m128 d)
+			{
+				__m128 p = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(a, b), c), d), _mm_set1_ps(0.25f));
+
+				__m128d plo = _mm_cvtps_pd(p);
+				__m128d phi = _mm_cvtps_pd(_mm_movehl_ps(p, p));
+				__m128d k = _mm_set1_pd(11.8), s = _mm_set1_pd(255.0), h = _mm_set1_pd(0.5);
+				__m128i lin = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(_mm_div_pd(_mm_mul_pd(plo, k), s), h)),
+												 _mm_cvttpd_epi32(_mm_add_pd(_mm_div_pd(_mm_mul_pd(phi, k), s), h)));
+				__m128 r = _mm_add_ps(_mm_sqrt_ps(p), _mm_set1_ps(5.0f));
+				__m128i rt = _mm_unpacklo_epi64(_mm_cvttpd_epi32(_mm_add_pd(_mm_cvtps_pd(r), h)),
+												 _mm_cvttpd_epi32(_mm_add_pd(_mm_cvtps_pd(_mm_movehl_ps(r, r)), h)));
+
+				__m128i is_lin = _mm_castps_si128(_mm_cmplt_ps(p, _mm_set1_ps((31-5)*(31-5))));
+				__m128i v = _mm_or_si128(_mm_and_si128(is_lin, lin), _mm_andnot_si128(is_lin, rt));
+				v = _mm_packs_epi32(v, v);
+				return _mm_cvtsi128_si32(_mm_packus_epi16(v, v));
+			}
+		#endif
+	#endif
 #else  // SSE gamma = 2.0 version: 8 msec !!!
 	#include <smmintrin.h>
 	#define SCALE_SSE 1
@@ -1619,7 +1675,9 @@ static void	copy_mip_SSE(int x, int y, unsigned char * __restrict src, unsigned
 }
 #endif
 
-static void copy_mip_with_filter(const ImageInfo& src, ImageInfo& dst,int level, unsigned char (* filter)(unsigned char src[], int count, int channel, int level))
+// Filters dst rows y_start..y_end-1 (all of them by default) - disjoint row ranges can be done concurrently.
+static void copy_mip_with_filter(const ImageInfo& src, ImageInfo& dst,int level, unsigned char (* filter)(unsigned char src[], int count, int channel, int level),
+								int y_start = 0, int y_end = -1)
 {
 	unsigned char temp_buf[4];	        // Enough storage for RGBA 2x2
 	int xr = src.width == dst.width ? 1 : 2;
@@ -1628,7 +1686,8 @@ static void copy_mip_with_filter(const ImageInfo& src, ImageInfo& dst,int level,
 	int srb = src.width * src.channels + src.pad;
 	int drb = dst.width * dst.channels + dst.pad;
 
-	for(int y = 0; y < dst.height; ++y)
+	if(y_end < 0) y_end = dst.height;
+	for(int y = y_start; y < y_end; ++y)
 	for(int x = 0; x < dst.width; ++x)
 	{
 		for(int c = 0; c < src.channels; ++c)
@@ -1645,6 +1704,72 @@ static void copy_mip_with_filter(const ImageInfo& src, ImageInfo& dst,int level,
 	}
 }
 
+#if SRGB_APPROX_24
+/*
+	Same result as copy_mip_with_filter(..., average_with_gamma), pixel for pixel, but without a function call per
+	channel: from_srgb comes out of a table, and with SSE2 the 2x2 average and to_srgb are done for 4 channels (or 4
+	pixels of a 1-channel image) at once.  to_srgb does its math in double, so the SSE2 version does too - that's what
+	keeps it exact.  use_sse = false forces the plain C loop - test/mip_filter compares both against the reference.
+*/
+static void copy_mip_srgb(const ImageInfo& src, ImageInfo& dst, int y_start, int y_end, bool use_sse = true)
+{
+	if(src.width != dst.width * 2 || src.height != dst.height * 2 || src.channels != dst.channels)
+	{
+		copy_mip_with_filter(src, dst, 0, average_with_gamma, y_start, y_end);		// the 1 pixel wide or high tail end
+		return;
+	}
+
+	const float * lut = srgb_lut();
+	int ch = src.channels;
+	int srb = src.width * ch + src.pad;
+	int drb = dst.width * ch + dst.pad;
+
+	for(int y = y_start; y < y_end; ++y)
+	{
+		const unsigned char * s1 = src.data + 2 * y * srb;
+		const unsigned char * s2 = s1 + srb;
+		unsigned char * d = dst.data + y * drb;
+		int x = 0;
+#if SRGB_SSE2
+		if(use_sse && ch == 1)
+		{
+			for(; x + 4 <= dst.width; x += 4, s1 += 8, s2 += 8, d += 4)
+			{
+				int v = to_srgb_4(_mm_setr_ps(lut[s1[0]], lut[s1[2]], lut[s1[4]], lut[s1[6]]),
+								  _mm_setr_ps(lut[s1[1]], lut[s1[3]], lut[s1[5]], lut[s1[7]]),
+								  _mm_setr_ps(lut[s2[0]], lut[s2[2]], lut[s2[4]], lut[s2[6]]),
+								  _mm_setr_ps(lut[s2[1]], lut[s2[3]], lut[s2[5]], lut[s2[7]]));
+				memcpy(d, &v, 4);
+			}
+		}
+		else if(use_sse && ch >= 3)
+		{
+			for(; x < dst.width; ++x, s1 += 2 * ch, s2 += 2 * ch, d += ch)
+			{
+				const unsigned char * s1b = s1 + ch;
+				const unsigned char * s2b = s2 + ch;
+				int v = to_srgb_4(_mm_setr_ps(lut[s1[0]], lut[s1[1]], lut[s1[2]], 0.0f),
+								  _mm_setr_ps(lut[s1b[0]], lut[s1b[1]], lut[s1b[2]], 0.0f),
+								  _mm_setr_ps(lut[s2[0]], lut[s2[1]], lut[s2[2]], 0.0f),
+								  _mm_setr_ps(lut[s2b[0]], lut[s2b[1]], lut[s2b[2]], 0.0f));
+				memcpy(d, &v, 3);
+				for(int c = 3; c < ch; ++c)		// alpha isn't gamma corrected
+					d[c] = ((int) s1[c] + (int) s1b[c] + (int) s2[c] + (int) s2b[c]) >> 2;
+			}
+		}
+#endif
+		for(; x < dst.width; ++x, s1 += 2 * ch, s2 += 2 * ch, d += ch)
+		for(int c = 0; c < ch; ++c)
+		{
+			if(c < 3)
+				d[c] = intlim(to_srgb((lut[s1[c]] + lut[s1[c + ch]] + lut[s2[c]] + lut[s2[c + ch]]) * 0.25f), 0, 255);
+			else
+				d[c] = ((int) s1[c] + (int) s1[c + ch] + (int) s2[c] + (int) s2[c + ch]) >> 2;
+		}
+	}
+}
+#endif
+
 
 // This routine swaps Y and BGRA on desktop, but only BGRA on phone.
 static void swap_bgra_y(struct ImageInfo& i)
@@ -1671,6 +1796,55 @@ static void swap_bgra_y(struct ImageInfo& i)
 	}
 }
 
+/*
+	DDS jobs.  Everything below runs on the WorkerPool in bands of whole DXT block rows (a multiple of 4
+	pixel rows, about DDS_BAND_PIXELS each).  Bands of one level are independent for both the mip filter
+	and the DXT compressor, and a band's compressed blocks land at a fixed offset in the level's output,
+	so bands can be done in any order and the file still comes out byte-for-byte the same.
+*/
+
+#define DDS_BAND_PIXELS (64 * 1024)
+
+static int dds_band_rows(int width)
+{
+	return max(4, (DDS_BAND_PIXELS / max(width, 1)) & ~3);
+}
+
+// Runs job(y_start, y_end) over all rows of an image, in parallel.
+static void parallel_row_bands(int width, int height, const function<void(int, int)>& job)
+{
+	int rows = dds_band_rows(width);
+	WorkerPool_ParallelFor((height + rows - 1) / rows, [&](int n) {
+		job(n * rows, min(height, (n + 1) * rows));
+	});
+}
+
+struct dxt_band_t {
+	const unsigned char *	src;		// tightly packed RGBA
+	int						width;
+	int						height;
+	unsigned char *			dst;
+};
+
+// Queues up one RGBA level; dst must have GetStorageRequirements(width, height, flags) bytes.
+static void add_dxt_bands(vector<dxt_band_t>& bands, const unsigned char * src, int width, int height, int flags, unsigned char * dst)
+{
+	int block_row_bytes = ((width + 3) / 4) * ((flags & squish::kDxt1) ? 8 : 16);
+	int rows = dds_band_rows(width);
+	for(int y = 0; y < height; y += rows)
+	{
+		dxt_band_t b = { src + y * width * 4, width, min(rows, height - y), dst + (y / 4) * block_row_bytes };
+		bands.push_back(b);
+	}
+}
+
+static void compress_dxt_bands(const vector<dxt_band_t>& bands, int flags)
+{
+	WorkerPool_ParallelFor(bands.size(), [&](int n) {
+		squish::CompressImage(bands[n].src, bands[n].width, bands[n].height, bands[n].dst, flags);
+	});
+}
+
 // Compressed DDS.
 int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name, int use_win_gamma)
 {
@@ -1703,7 +1877,9 @@ int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name,
 		// Get the image into RGBA upper left origin, that's what Squish/DXT/DDS wants.
 		swap_bgra_y(img);
 
-		squish::CompressImage(img.data, img.width, img.height, dst_mem, flags|squish::kColourIterativeClusterFit);
+		vector<dxt_band_t> bands;
+		add_dxt_bands(bands, img.data, img.width, img.height, flags, dst_mem);
+		compress_dxt_bands(bands, flags|squish::kColourIterativeClusterFit);
 		int len = squish::GetStorageRequirements(img.width,img.height,flags);
 		fwrite(dst_mem,len,1,fi);
 #if !WED
@@ -1748,22 +1924,26 @@ inline void unsharpPixelH(unsigned char * sharp, const unsigned char * orig)
 	sharp[3] = orig[3];
 }
 
-static void copy_sharpen(int x_size, int y_size, const unsigned char * b4sharp, unsigned char * sharp)
+// Sharpens rows y_start..y_end-1 of b4sharp into the same rows of sharp.  The edge rows and columns only get sharpened along the edge.
+static void copy_sharpen_rows(int x_size, int y_size, const unsigned char * b4sharp, unsigned char * sharp, int y_start, int y_end)
 {
 	int rb = x_size * 4;
-	// top row
-	*((int *) sharp) = *((int *) b4sharp);       // top left corner - just copy
-	sharp += 4; b4sharp += 4;
-	for(int xx = 1; xx < x_size-1; xx++)
-	{
-		unsharpPixelH(sharp, b4sharp);
-		sharp += 4; b4sharp += 4;
-	}
-	*((int *) sharp) =  *((int *) b4sharp);       // top right corner - just copy
-	sharp += 4; b4sharp += 4;
-	// middle rows
-	for(int yy = 1; yy < y_size-1; yy++)
+	sharp += y_start * rb; b4sharp += y_start * rb;
+	for(int yy = y_start; yy < y_end; yy++)
 	{
+		if(yy == 0 || yy == y_size-1)
+		{
+			*((int *) sharp) = *((int *) b4sharp);       // left corner - just copy
+			sharp += 4; b4sharp += 4;
+			for(int xx = 1; xx < x_size-1; xx++)
+			{
+				unsharpPixelH(sharp, b4sharp);
+				sharp += 4; b4sharp += 4;
+			}
+			*((int *) sharp) =  *((int *) b4sharp);       // right corner - just copy
+			sharp += 4; b4sharp += 4;
+			continue;
+		}
 		unsharpPixelV(sharp, b4sharp, rb);
 		sharp += 4; b4sharp += 4;
 		for(int xx = 1; xx < x_size-1; xx++)
@@ -1776,23 +1956,12 @@ static void copy_sharpen(int x_size, int y_size, const unsigned char * b4sharp,
 		unsharpPixelV(sharp, b4sharp, rb);
 		sharp += 4; b4sharp += 4;
 	}
-	// bottom row
-	*((int *) sharp) =  *((int *) b4sharp);       // bottom left corner - just copy
-	sharp += 4; b4sharp += 4;
-	for(int xx = 1; xx < x_size-1; xx++)
-	{
-		unsharpPixelH(sharp, b4sharp);
-		sharp += 4; b4sharp += 4;
-	}
-	*((int *) sharp) =  *((int *) b4sharp);       // bottom right corner - just copy
 }
 
-struct CompressImageData
+static void copy_sharpen(int x_size, int y_size, const unsigned char * b4sharp, unsigned char * sharp)
 {
-	ImageInfo img;
-	void * dst_mem;
-	int dst_size;
-};
+	copy_sharpen_rows(x_size, y_size, b4sharp, sharp, 0, y_size);
+}
 
 int	WriteBitmapToDDS_MT(struct ImageInfo& ioImage, int dxt, const char * file_name)
 {
@@ -1802,41 +1971,17 @@ int	WriteBitmapToDDS_MT(struct ImageInfo& ioImage, int dxt, const char * file_na
 	FILE * fi = fopen(file_name,"wb");
 	if (fi == NULL) return -1;
 
-/* The very simply parallel processing of the full resolution texture scales to ~(3+1) threads, only. As the
-   remaining mipmap levels all together use ~1/3 as many pixels as the full resolution texture. Otherwise the
-   full texture gets done haead of the mipmaps == no faster overall. */
-
-	#define MAX_WORKER_THREADS 3
-	thread threads[MAX_WORKER_THREADS];
-	CompressImageData args[MAX_WORKER_THREADS];
-
-	/* don't waste thread startup time parallelizing so much for small textures, libsquish runs at 1+ Mpixels/sec */
-	int num_threads = (ioImage.height * ioImage.width >= 256 * 256) ? MAX_WORKER_THREADS : 1;
-
 	int flags = (dxt == 1 ? squish::kDxt1 : (dxt == 3 ? squish::kDxt3 : squish::kDxt5)) | squish::kColourIterativeClusterFit;
-	int start_line = 0;
-	for (int i = 0; i < num_threads; i++)
-	{
-		args[i].img = ioImage;
-		args[i].img.height =  i < num_threads-1 ? ((ioImage.height / num_threads) >> 2) << 2 : ioImage.height - start_line;
-		args[i].img.data += start_line * ioImage.width * ioImage.channels;
-		args[i].dst_size = squish::GetStorageRequirements(args[i].img.width, args[i].img.height, flags);
-		args[i].dst_mem = malloc(args[i].dst_size);
-		
-		threads[i] = thread(squish::CompressImage, args[i].img.data, args[i].img.width, args[i].img.height, args[i].dst_mem, flags);
-//		squish::CompressImage(args[i].img.data, args[i].img.width, args[i].img.height, args[i].dst_mem, flags);
-		start_line += args[i].img.height;
-	}
-	
+
 	// scale down the mipmaps using sRGB gamma and sharpen the result a bit. Create the next map starting from the sharpened map.
+	// Each level needs the one before, so the levels go one after the other - but each is done in parallel bands, and all of
+	// them together take a fraction of the time the DXT compression below does.
 	
-	ImageInfo ioMips(ioImage);
-	ioMips.data = (unsigned char *) malloc(ioImage.width * ioImage.height  * 2);
-	ioMips.width /= 2;
-	ioMips.height /= 2;
+	unsigned char * mip_mem = (unsigned char *) malloc(ioImage.width * ioImage.height  * 2);
+	vector<ImageInfo> levels(1, ioImage);
 
 	ImageInfo src(ioImage);
-	unsigned char * mip_ptr = ioMips.data;
+	unsigned char * mip_ptr = mip_mem;
 	int mips = 1;
 	
 	while(src.width > 1 || src.height > 1)
@@ -1847,54 +1992,326 @@ int	WriteBitmapToDDS_MT(struct ImageInfo& ioImage, int dxt, const char * file_na
 		if(dst.width > 1) dst.width >>= 1;
 		if(dst.height > 1) dst.height >>= 1;
 		
+		parallel_row_bands(dst.width, dst.height, [&](int y_start, int y_end) {
 #if SCALE_SSE
-		copy_mip_SSE(src.width, src.height ,src.data, dst.data);
+			if(src.height > 1)
+				copy_mip_SSE(src.width, 2 * (y_end - y_start), src.data + 2 * y_start * src.width * 4, dst.data + y_start * dst.width * 4);
+			else
+				copy_mip_SSE(src.width, src.height, src.data, dst.data);
+#elif SRGB_APPROX_24
+			copy_mip_srgb(src, dst, y_start, y_end);
 #else
-		copy_mip_with_filter(src, dst, mips, average_with_gamma);
+			copy_mip_with_filter(src, dst, mips, average_with_gamma, y_start, y_end);
 #endif
+		});
 		src = dst;
 
 #if SHARPEN_MIPS
 		if(src.width > 4 && src.height > 4)                             // don't sharpen the last few mipmaps, as its mostly border pixels that won't sharpen that well
-			copy_sharpen(src.width, src.height, src.data, mip_ptr);
+			parallel_row_bands(src.width, src.height, [&](int y_start, int y_end) {
+				copy_sharpen_rows(src.width, src.height, src.data, mip_ptr, y_start, y_end);
+			});
 		else
 #endif
 			memcpy(mip_ptr, src.data, src.width * src.height * 4);        // nothing gets sharpened, still need to move the data to the location its expected to be
 				
 		src.data = mip_ptr;
+		levels.push_back(src);
 		mip_ptr += src.width * src.height * 4;
 		++mips;
 	}
-	
-	void * dst_mem = malloc(2 * squish::GetStorageRequirements(ioMips.width,ioMips.height,flags)); // its a bit more than needed ...
-	mip_ptr = (unsigned char *) dst_mem;
-	unsigned char * src_ptr = ioMips.data;
 
-	do
+	// Now every band of every level is an independent job, with its own spot in the output.
+
+	size_t total = 0;
+	for(vector<ImageInfo>::iterator l = levels.begin(); l != levels.end(); ++l)
+		total += squish::GetStorageRequirements(l->width, l->height, flags);
+
+	vector<unsigned char> dst_v(total);
+	vector<dxt_band_t> bands;
+	unsigned char * dst_ptr = &*dst_v.begin();
+	for(vector<ImageInfo>::iterator l = levels.begin(); l != levels.end(); ++l)
 	{
-		squish::CompressImage(ioMips.data, ioMips.width, ioMips.height, mip_ptr, flags);
-		mip_ptr += squish::GetStorageRequirements(ioMips.width, ioMips.height, flags);
-	} 
-	while (AdvanceMipmapStack(&ioMips));
-	
-	free(src_ptr);
+		add_dxt_bands(bands, l->data, l->width, l->height, flags, dst_ptr);
+		dst_ptr += squish::GetStorageRequirements(l->width, l->height, flags);
+	}
+	compress_dxt_bands(bands, flags);
+	free(mip_mem);
 
 	TEX_dds_desc header(ioImage.width, ioImage.height, mips, dxt);
 	fwrite(&header,sizeof(header), 1, fi);
-	
-	for (int i = 0; i < num_threads; i++)
-	{
-		threads[i].join();
-		fwrite(args[i].dst_mem, args[i].dst_size, 1, fi);
-		free(args[i].dst_mem);
-	}
-	fwrite(dst_mem, mip_ptr - (unsigned char *) dst_mem, 1, fi);
-	free(dst_mem);
+	fwrite(&*dst_v.begin(), total, 1, fi);
 
 	fclose(fi);
 	return 0;
 }
 
+/*
+	Streaming PNG -> DDS.  Instead of decoding the whole PNG and then building a full mip stack next to it, the PNG
+	is read in bands of rows.  Each band is DXT compressed (level 0 goes straight to the file) and filtered down into
+	the band of the next level, which gets compressed and filtered the same way once it fills up, and so on.  So we
+	hold two bands of the top level, one band per mip and the compressed mips - not the image.
+
+	The next band of the PNG is decoded as one more job on the pool while the current one is worked on.
+*/
+
+struct dds_stream_level_t {
+	int						width;
+	int						height;
+	int						rows_in;		// rows received so far, including those in the band
+	int						band_rows;		// rows collected before the band is compressed and filtered
+	int						band_fill;
+	vector<unsigned char>	band;			// RGBA, top row first
+	unsigned char *			blocks;			// this level's DXT blocks - NULL for level 0, which goes to the file
+};
+
+struct dds_stream_t {
+	vector<dds_stream_level_t>	levels;
+	int							flags;
+	mip_filter_f				filter;
+	FILE *						fi;
+	vector<unsigned char>		top_blocks;		// level 0 blocks of one band, on their way to the file
+};
+
+// Filters next level rows y_start..y_end-1 from a band of src_rows rows of level 'level'.
+static void stream_filter_rows(const dds_stream_t& st, int level, const unsigned char * src, int src_rows, unsigned char * dst, int y_start, int y_end)
+{
+	const dds_stream_level_t& s(st.levels[level]);
+	const dds_stream_level_t& d(st.levels[level+1]);
+
+	if(st.filter == NULL)
+	{
+		ImageInfo si = { (unsigned char *) src, s.width, src_rows, 0, 4 };
+		ImageInfo di = { dst, d.width, s.height > 1 ? src_rows / 2 : 1, 0, 4 };
+#if SCALE_SSE
+		if(s.height > 1)
+			copy_mip_SSE(si.width, 2 * (y_end - y_start), si.data + 2 * y_start * si.width * 4, di.data + y_start * di.width * 4);
+		else
+			copy_mip_SSE(si.width, si.height, si.data, di.data);
+#elif SRGB_APPROX_24
+		copy_mip_srgb(si, di, y_start, y_end);
+#else
+		copy_mip_with_filter(si, di, level, average_with_gamma, y_start, y_end);
+#endif
+		return;
+	}
+
+	// Custom filters get their samples in the same order as MakeMipmapStackWithFilter feeds them from a bottom-up
+	// image - lower row first - so float filters round exactly as they do there.
+	unsigned char temp_buf[4];
+	int xr = s.width > 1 ? 2 : 1;
+	int yr = s.height > 1 ? 2 : 1;
+	int srb = s.width * 4;
+	for(int y = y_start; y < y_end; ++y)
+	for(int x = 0; x < d.width; ++x)
+	for(int c = 0; c < 4; ++c)
+	{
+		int ns = 0;
+		for(int dy = yr - 1; dy >= 0; --dy)
+		for(int dx = 0; dx < xr; ++dx)
+			temp_buf[ns++] = src[(y * yr + dy) * srb + (x * xr + dx) * 4 + c];
+		dst[(y * d.width + x) * 4 + c] = st.filter(temp_buf, ns, c, level);
+	}
+}
+
+static void stream_push_rows(dds_stream_t& st, int level, const unsigned char * rows, int count);
+
+// Compresses and filters the band of a level, running side_job (if any) on the pool alongside.
+static void stream_flush_band(dds_stream_t& st, int level, const function<void()>& side_job)
+{
+	dds_stream_level_t& l(st.levels[level]);
+	int n = l.band_fill;
+	int r0 = l.rows_in - n;
+	int block_row_bytes = ((l.width + 3) / 4) * ((st.flags & squish::kDxt1) ? 8 : 16);
+
+	vector<dxt_band_t> bands;
+	add_dxt_bands(bands, &*l.band.begin(), l.width, n, st.flags, level == 0 ? &*st.top_blocks.begin() : l.blocks + (r0 / 4) * block_row_bytes);
+
+	bool has_next = level + 1 < st.levels.size();
+	int next_width = has_next ? st.levels[level+1].width : 0;
+	int next_rows = has_next ? (l.height > 1 ? n / 2 : 1) : 0;
+	vector<unsigned char> next(next_rows * next_width * 4);
+	int filter_rows = dds_band_rows(next_width);
+	int filter_jobs = has_next ? (next_rows + filter_rows - 1) / filter_rows : 0;
+
+	int first_band = side_job ? 1 : 0;
+	int first_filter = first_band + bands.size();
+	WorkerPool_ParallelFor(first_filter + filter_jobs, [&](int j) {
+		if(j < first_band)
+			side_job();
+		else if(j < first_filter)
+			squish::CompressImage(bands[j - first_band].src, bands[j - first_band].width, bands[j - first_band].height, bands[j - first_band].dst, st.flags);
+		else
+		{
+			int y = (j - first_filter) * filter_rows;
+			stream_filter_rows(st, level, &*l.band.begin(), n, &*next.begin(), y, min(next_rows, y + filter_rows));
+		}
+	});
+
+	if(level == 0)
+		fwrite(&*st.top_blocks.begin(), squish::GetStorageRequirements(l.width, n, st.flags), 1, st.fi);
+	l.band_fill = 0;
+
+	if(has_next)
+		stream_push_rows(st, level + 1, &*next.begin(), next_rows);
+}
+
+static void stream_push_rows(dds_stream_t& st, int level, const unsigned char * rows, int count)
+{
+	dds_stream_level_t& l(st.levels[level]);
+	while(count > 0)
+	{
+		int take = min(count, l.band_rows - l.band_fill);
+		memcpy(&*l.band.begin() + l.band_fill * l.width * 4, rows, take * l.width * 4);
+		rows += take * l.width * 4;
+		count -= take;
+		l.band_fill += take;
+		l.rows_in += take;
+		if(l.band_fill == l.band_rows || l.rows_in == l.height)
+			stream_flush_band(st, level, function<void()>());
+	}
+}
+
+// Reads the next rows of a PNG - has its own setjmp, as it runs on whatever thread the pool picks.
+static bool png_read_band(png_structp pngPtr, unsigned char * buf, int rows, int row_bytes)
+{
+	if(setjmp(png_jmpbuf(pngPtr)))
+		return false;
+	for(int r = 0; r < rows; ++r)
+		png_read_row(pngPtr, buf + r * row_bytes, NULL);
+	return true;
+}
+
+int	WritePNGToDDS(const char * inFilePath, int dxt, const char * file_name, float target_gamma, int use_win_gamma, mip_filter_f filter, int * outWidth, int * outHeight)
+{
+	png_structp		pngPtr = NULL;
+	png_infop		infoPtr = NULL;
+	dds_stream_t	st;
+	int				result = -1;
+	st.fi = NULL;
+
+	FILE * file = fopen(inFilePath, "rb");
+	if(!file) return -1;
+
+	unsigned char sig[8];
+	int width, height, channels;
+	bool ok = true;
+
+	if(fread(sig, 1, 8, file) != 8 || png_sig_cmp(sig, 0, 8)) goto bail;
+
+	pngPtr = png_create_read_struct(PNG_LIBPNG_VER_STRING,(png_voidp)NULL,my_error,my_warning);
+	if(!pngPtr) goto bail;
+	infoPtr=png_create_info_struct(pngPtr);
+	if(!infoPtr) goto bail;
+
+	if(setjmp(png_jmpbuf(pngPtr)))
+		goto bail;
+
+	png_set_read_fn  (pngPtr,file,png_file_read_func);
+	png_set_sig_bytes(pngPtr,8);
+	png_read_info	 (pngPtr,infoPtr);
+
+	width = png_get_image_width(pngPtr,infoPtr);
+	height = png_get_image_height(pngPtr,infoPtr);
+	if(png_get_interlace_type(pngPtr,infoPtr) != PNG_INTERLACE_NONE ||			// interlaced PNGs only come out whole
+		(width & (width - 1)) || (height & (height - 1)))						// and only power-of-2 sizes make a clean mip chain
+	{
+		result = 1;
+		goto bail;
+	}
+
+	channels = png_setup_transforms(pngPtr, infoPtr, false, target_gamma);
+	if(channels != 3 && channels != 4) goto bail;
+	if(channels == 3)
+		png_set_filler(pngPtr, 0xFF, PNG_FILLER_AFTER);
+	png_read_update_info(pngPtr,infoPtr);
+
+	if(outWidth) *outWidth = width;
+	if(outHeight) *outHeight = height;
+	if(dxt == 0)
+		dxt = channels == 3 ? 1 : 5;
+
+	{
+		st.flags = (dxt == 1 ? squish::kDxt1 : (dxt == 3 ? squish::kDxt3 : squish::kDxt5)) | squish::kColourIterativeClusterFit;
+		st.filter = filter;
+
+		size_t mip_bytes = 0;
+		int x = width, y = height;
+		while(1)
+		{
+			dds_stream_level_t l;
+			l.width = x;
+			l.height = y;
+			l.rows_in = 0;
+			l.band_fill = 0;
+			l.band_rows = min(y, dds_band_rows(x) * WorkerPool_Concurrency());
+			l.band.resize(l.band_rows * x * 4);
+			l.blocks = NULL;
+			if(!st.levels.empty())
+				mip_bytes += squish::GetStorageRequirements(x, y, st.flags);
+			st.levels.push_back(l);
+			if(x == 1 && y == 1) break;
+			if(x > 1) x >>= 1;
+			if(y > 1) y >>= 1;
+		}
+
+		vector<unsigned char> mip_blocks(mip_bytes);
+		unsigned char * p = mip_blocks.empty() ? NULL : &*mip_blocks.begin();
+		for(int n = 1; n < st.levels.size(); ++n)
+		{
+			st.levels[n].blocks = p;
+			p += squish::GetStorageRequirements(st.levels[n].width, st.levels[n].height, st.flags);
+		}
+		st.top_blocks.resize(squish::GetStorageRequirements(width, st.levels[0].band_rows, st.flags));
+
+		st.fi = fopen(file_name,"wb");
+		if(!st.fi) goto bail;
+
+		TEX_dds_desc header(width, height, st.levels.size(), dxt);
+		if(!use_win_gamma) header.ddsCaps.dwCaps=SWAP32(DDSCAPS_TEXTURE|DDSCAPS_MIPMAP|DDSCAPS_COMPLEX);
+		fwrite(&header,sizeof(header),1,st.fi);
+
+		dds_stream_level_t& top(st.levels[0]);
+		vector<unsigned char> spare(top.band.size());
+		int row_bytes = width * 4;
+		int rows_read = top.band_rows;
+		ok = png_read_band(pngPtr, &*top.band.begin(), rows_read, row_bytes);
+
+		while(ok)
+		{
+			top.band_fill = min(top.band_rows, height - top.rows_in);
+			top.rows_in += top.band_fill;
+
+			int next_n = min(top.band_rows, height - rows_read);
+			if(next_n > 0)
+				stream_flush_band(st, 0, [&]() { ok = png_read_band(pngPtr, &*spare.begin(), next_n, row_bytes); });
+			else
+				stream_flush_band(st, 0, function<void()>());
+
+			if(next_n == 0) break;
+			swap(top.band, spare);
+			rows_read += next_n;
+		}
+
+		if(ok && !mip_blocks.empty())
+			fwrite(&*mip_blocks.begin(), mip_blocks.size(), 1, st.fi);
+		if(ok && ferror(st.fi) == 0)
+			result = 0;
+	}
+
+bail:
+	if (pngPtr && infoPtr)		png_destroy_read_struct(&pngPtr,(png_infopp)&infoPtr,(png_infopp)NULL);
+	else if (pngPtr)			png_destroy_read_struct(&pngPtr,(png_infopp)NULL,(png_infopp)NULL);
+	fclose(file);
+	if(st.fi)
+	{
+		fclose(st.fi);
+		if(result != 0)
+			FILE_delete_file(file_name, false);
+	}
+	return result;
+}
+
 // Uncomp: write BGR or BGRA, origin depends on phone or desktop - see below.
 int	WriteUncompressedToDDS(struct ImageInfo& ioImage, const char * file_name, int use_win_gamma)
 {
@@ -2193,7 +2610,9 @@ int MakeMipmapStackWithFilter(struct ImageInfo * ioImage, unsigned char (* filte
 		if(sd.width > 1) sd.width >>= 1;
 		if(sd.height > 1) sd.height >>= 1;
 
-		copy_mip_with_filter(ni,sd,level,filter);
+		parallel_row_bands(sd.width, sd.height, [&](int y_start, int y_end) {
+			copy_mip_with_filter(ni, sd, level, filter, y_start, y_end);
+		});
 		ni=sd;
 		++level;
 	}
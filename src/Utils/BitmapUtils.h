@@ -194,6 +194,16 @@ int	WriteBitmapToDDS(struct ImageInfo& ioImage, int dxt, const char * file_name,
 // same, but multi-threaded compression and gamma corrected mipmap generation is done within
 int	WriteBitmapToDDS_MT(struct ImageInfo& ioImage, int dxt, const char * file_name);
 
+typedef unsigned char (* mip_filter_f)(unsigned char src[], int count, int channel, int level);
+
+/* Converts a PNG file straight to a mip-mapped DXT DDS without ever holding the whole image - the PNG is decoded in
+ * bands of rows that are compressed and filtered into the next mip as they arrive.  dxt 0 picks DXT1 for PNGs without
+ * alpha, else DXT5.  With a filter the mips match MakeMipmapStackWithFilter + WriteBitmapToDDS, without one they match
+ * WriteBitmapToDDS_MT.  outWidth/outHeight are optional.
+ * Returns 0 on success, -1 on error, 1 for PNGs that can't be streamed (interlaced, or not a power of 2) - use the
+ * in-memory path for those. */
+int	WritePNGToDDS(const char * inFilePath, int dxt, const char * file_name, float target_gamma, int use_win_gamma, mip_filter_f filter, int * outWidth, int * outHeight);
+
 /* This routine writes a 3 or 4 channel bitmap as a mip-mapped DXT1 or DXT3 image. */
 int	WriteUncompressedToDDS(struct ImageInfo& ioImage, const char * file_name, int use_win_gamma);
 
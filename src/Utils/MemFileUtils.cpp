@@ -714,25 +714,16 @@ void	TextScanner_TokenizeLine(MFTextScanner * inScanner, const char * inDelim, c
 {
 	int n;
 	int tokens_so_far = 0;
-	static	char	lastDelim[256] = { 0 };
-	static	char	lastTerm[256] = { 0 };
-	static	char	delimLookup[256] = { 0 };
-	static	char	termLookup[256] = { 0 };
-	if (strcmp(lastDelim, inDelim))
-	{
-		memset(delimLookup, 0, sizeof(delimLookup));
-		n = 0;
-		while (inDelim[n])
-			delimLookup[(unsigned char) inDelim[n++]] = 1;
-	}
-	if (strcmp(lastTerm, inTerm))
-	{
-		memset(termLookup, 0, sizeof(termLookup));
-		n = 0;
-		while (inTerm[n])
-			termLookup[(unsigned char) inTerm[n++]] = 1;
-		termLookup[0] = 1;	// Null is always a terminator, not that we should ever hit this!
-	}
+	// Tables are on the stack so that several threads can scan at once.
+	char	delimLookup[256] = { 0 };
+	char	termLookup[256] = { 0 };
+	n = 0;
+	while (inDelim[n])
+		delimLookup[(unsigned char) inDelim[n++]] = 1;
+	n = 0;
+	while (inTerm[n])
+		termLookup[(unsigned char) inTerm[n++]] = 1;
+	termLookup[0] = 1;	// Null is always a terminator, not that we should ever hit this!
 
 	const unsigned char * begin = (const unsigned char *) inScanner->mRunBegin;
 	const unsigned char * end = (const unsigned char *) inScanner->mRunEnd;
@@ -24,6 +24,7 @@
 #include <assert.h>
 #include "QuiltUtils.h"
 #include "BitmapUtils.h"
+#include "WorkerPool.h"
 
 #if IBM
 #define random rand
@@ -46,13 +47,13 @@ void	quilt_images(
 	assert(lhs.width==res.width);
 	assert(lhs.height==res.height);
 
-	const unsigned long * s1 = (const unsigned long *) lhs.data;
-	const unsigned long * s2 = (const unsigned long *) rhs.data;
-	unsigned long * d  = (unsigned long *) res.data;
+	const uint32_t * s1 = (const uint32_t *) lhs.data;
+	const uint32_t * s2 = (const uint32_t *) rhs.data;
+	uint32_t * d  = (uint32_t *) res.data;
 
 	vector<int> l, b, r, t;
 
-	calc_four_cuts<unsigned long, unsigned long>(
+	calc_four_cuts<uint32_t, uint64_t>(
 						s1, 1, lhs.width + lhs.pad / 4,
 						s2, 1, rhs.width + rhs.pad / 4,
 						lhs.width, lhs.height,
@@ -64,7 +65,7 @@ void	quilt_images(
 					l,b,r,t);
 
 
-	copy_cut_edges<unsigned long>(
+	copy_cut_edges<uint32_t>(
 									s1, 1, lhs.width + lhs.pad / 4,
 									s2, 1, rhs.width + rhs.pad / 4,
 									d, 1, res.width + res.pad / 4,
@@ -73,7 +74,7 @@ void	quilt_images(
 
 }
 
-const unsigned long *	grab_patch(const unsigned long * base, int dx, int dy, int w, int h, int tile_size)
+const uint32_t *	grab_patch(const uint32_t * base, int dx, int dy, int w, int h, int tile_size)
 {
 	int xo = random() % (w - tile_size);
 	int yo = random() % (h - tile_size);
@@ -81,45 +82,41 @@ const unsigned long *	grab_patch(const unsigned long * base, int dx, int dy, int
 }
 
 void	splat_for_spot(
-				const unsigned long *	image_src, int sdx, int sdy, int src_w, int src_h,
-					  unsigned long *	image_dst, int ddx, int ddy,			// dest pre-offset location
+				const uint32_t *	image_src, int sdx, int sdy, int src_w, int src_h,
+					  uint32_t *	image_dst, int ddx, int ddy,			// dest pre-offset location
 					  int splat_s,												// size o splat
 					  int l, int b, int r, int t,								// amount of overlap
 					  int trials)
 {
-	const unsigned long * best = grab_patch(image_src,sdx,sdy, src_w, src_h, splat_s);
-	unsigned long best_e = calc_overlay_error<unsigned long, unsigned long>(
+	// Draw all candidates up front so the random sequence - and thus the texture - doesn't depend on how many
+	// threads score them.  Ties go to the earliest candidate, as they would one at a time.
+	vector<const uint32_t *>	candidates(trials + 1);
+	vector<uint64_t>			errors(trials + 1);
+	for(int n = 0; n <= trials; ++n)
+		candidates[n] = grab_patch(image_src,sdx,sdy, src_w, src_h, splat_s);
+
+	int per_job = max(1, (trials + 1) / (WorkerPool_Concurrency() * 4));
+	WorkerPool_ParallelFor((trials + per_job) / per_job, [&](int j) {
+		for(int n = j * per_job; n < min(trials + 1, (j + 1) * per_job); ++n)
+			errors[n] = calc_overlay_error<uint32_t, uint64_t>(
 									image_dst, ddx, ddy,
-									best, sdx, sdy,
-									splat_s, splat_s,
-									l, b, r, t);
-	while(trials > 0 && best_e > 0)
-	{
-		const unsigned long * trial = grab_patch(image_src,sdx,sdy, src_w, src_h, splat_s);
-		unsigned long trial_e = calc_overlay_error<unsigned long, unsigned long>(
-									image_dst, ddx, ddy,
-									best, sdx, sdy,
+									candidates[n], sdx, sdy,
 									splat_s, splat_s,
 									l, b, r, t);
+	});
 
-		if(trial_e < best_e)
-		{
-			best_e = trial_e;
-			best = trial;
-		}
-		--trials;
-	}
+	const uint32_t * best = candidates[min_element(errors.begin(), errors.end()) - errors.begin()];
 
 	vector<int> cl, cb, cr, ct;
 
-	calc_four_cuts<unsigned long, unsigned long>(
+	calc_four_cuts<uint32_t, uint64_t>(
 						image_dst, ddx,ddy,
 						best, sdx, sdy,
 						splat_s, splat_s,
 						l, b, r, t,
 						cl, cb, cr, ct);
 
-	copy_cut_edges<unsigned long>(
+	copy_cut_edges<uint32_t>(
 						image_dst, ddx,ddy,
 						best, sdx, sdy,
 						image_dst, ddx,ddy,
@@ -143,8 +140,8 @@ void	make_texture(
 	int sdy = src.width + src.pad / 4;
 	int ddy = dst.width + src.pad / 4;
 
-	const unsigned long * srcp = (const unsigned long *) src.data;
-		  unsigned long * dstp = (      unsigned long *) dst.data;
+	const uint32_t * srcp = (const uint32_t *) src.data;
+		  uint32_t * dstp = (      uint32_t *) dst.data;
 
 	int scoot = tile_size - overlap;
 
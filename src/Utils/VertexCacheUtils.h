@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2005, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef VertexCacheUtils_H
+#define VertexCacheUtils_H
+
+/*
+	Post-transform vertex cache optimization, shared by the OBJ optimizer and the DSF patch writer.
+
+	Triangles are reordered with Tom Forsyth's "linear-speed vertex cache optimisation": every vertex
+	gets a score from its position in a simulated LRU cache and from how many of its triangles are
+	still undrawn, and we greedily emit the best-scoring triangle among those touching the cache.
+
+	Header-only, so the libraries that use it don't pick up a new link dependency.
+*/
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <math.h>
+
+#define	VCACHE_SIZE			32
+#define	VCACHE_DECAY		1.5f
+#define	VCACHE_LAST_TRI		0.75f
+#define	VCACHE_VALENCE_S	2.0f
+#define	VCACHE_VALENCE_P	0.5f
+
+inline float	VCACHE_Score(int cache_pos, int active_tris)
+{
+	if(active_tris == 0)
+		return -1.0f;
+
+	float score = 0.0f;
+	if(cache_pos >= 0)
+	{
+		if(cache_pos < 3)
+			score = VCACHE_LAST_TRI;					// The last tri's verts get a fixed score so we don't favor making long thin strips.
+		else
+			score = powf(1.0f - (float) (cache_pos - 3) / (float) (VCACHE_SIZE - 3), VCACHE_DECAY);
+	}
+	return score + VCACHE_VALENCE_S * powf((float) active_tris, -VCACHE_VALENCE_P);
+}
+
+// Reorders the tris in "tris" (3 indices per tri, no degenerates) for a post-transform vertex cache.
+inline void	VCACHE_OrderTris(std::vector<int>& tris)
+{
+	int tri_count = tris.size() / 3;
+	if(tri_count < 2)
+		return;
+
+	// Compact the vertex numbers used by this range so the per-vertex tables stay small.
+	std::map<int, int>	local;
+	std::vector<int>		tri_vert(tris.size());
+	for(int n = 0; n < tris.size(); ++n)
+	{
+		std::map<int,int>::iterator i = local.insert(std::map<int,int>::value_type(tris[n], local.size())).first;
+		tri_vert[n] = i->second;
+	}
+	int vert_count = local.size();
+
+	std::vector<int>		vert_active(vert_count, 0);
+	std::vector<int>		vert_pos(vert_count, -1);
+	std::vector<float>	vert_score(vert_count);
+	for(int n = 0; n < tri_vert.size(); ++n)
+		++vert_active[tri_vert[n]];
+
+	std::vector<int>		vert_tri_start(vert_count + 1, 0);
+	for(int v = 0; v < vert_count; ++v)
+		vert_tri_start[v+1] = vert_tri_start[v] + vert_active[v];
+	std::vector<int>		vert_tris(tri_vert.size());
+	{
+		std::vector<int>	fill(vert_tri_start.begin(), vert_tri_start.end() - 1);
+		for(int n = 0; n < tri_vert.size(); ++n)
+			vert_tris[fill[tri_vert[n]]++] = n / 3;
+	}
+
+	for(int v = 0; v < vert_count; ++v)
+		vert_score[v] = VCACHE_Score(-1, vert_active[v]);
+
+	std::vector<float>	tri_score(tri_count);
+	std::vector<char>	tri_done(tri_count, 0);
+	for(int t = 0; t < tri_count; ++t)
+		tri_score[t] = vert_score[tri_vert[t*3]] + vert_score[tri_vert[t*3+1]] + vert_score[tri_vert[t*3+2]];
+
+	std::vector<int>		cache;
+	cache.reserve(VCACHE_SIZE + 3);
+	std::vector<int>		result;
+	result.reserve(tris.size());
+
+	int	best_tri = std::max_element(tri_score.begin(), tri_score.end()) - tri_score.begin();
+	int	scan_from = 0;
+
+	for(int emitted = 0; emitted < tri_count; ++emitted)
+	{
+		if(best_tri < 0)
+		{
+			// Nothing in the cache has tris left - take the best remaining tri anywhere.
+			float best_score = -1.0f;
+			while(tri_done[scan_from]) ++scan_from;
+			for(int t = scan_from; t < tri_count; ++t)
+			if(!tri_done[t] && tri_score[t] > best_score)
+			{
+				best_score = tri_score[t];
+				best_tri = t;
+			}
+		}
+
+		tri_done[best_tri] = 1;
+		for(int k = 0; k < 3; ++k)
+		{
+			int v = tri_vert[best_tri*3+k];
+			result.push_back(tris[best_tri*3+k]);
+			--vert_active[v];
+
+			// Move this vertex to the front of the LRU cache.
+			std::vector<int>::iterator i = std::find(cache.begin(), cache.end(), v);
+			if(i != cache.end())
+				cache.erase(i);
+			cache.insert(cache.begin(), v);
+		}
+
+		// Rescore everything that was in the cache, including the verts that just fell out.
+		for(int p = 0; p < cache.size(); ++p)
+		{
+			int v = cache[p];
+			vert_pos[v] = p < VCACHE_SIZE ? p : -1;
+			vert_score[v] = VCACHE_Score(vert_pos[v], vert_active[v]);
+		}
+
+		best_tri = -1;
+		float best_score = -1.0f;
+		for(int p = 0; p < cache.size(); ++p)
+		{
+			int v = cache[p];
+			for(int i = vert_tri_start[v]; i < vert_tri_start[v+1]; ++i)
+			{
+				int t = vert_tris[i];
+				if(tri_done[t]) continue;
+				tri_score[t] = vert_score[tri_vert[t*3]] + vert_score[tri_vert[t*3+1]] + vert_score[tri_vert[t*3+2]];
+				if(tri_score[t] > best_score)
+				{
+					best_score = tri_score[t];
+					best_tri = t;
+				}
+			}
+		}
+
+		if(cache.size() > VCACHE_SIZE)
+			cache.resize(VCACHE_SIZE);
+	}
+
+	tris.swap(result);
+}
+
+// Average vertices transformed per triangle with a FIFO post-transform cache - 0.5 is perfect, 3.0 is no reuse at all.
+template <class T>
+inline void	VCACHE_Simulate(const T * idx, int count, int& transforms, int& tris)
+{
+	std::vector<T>	fifo(VCACHE_SIZE, (T) -1);
+	int			head = 0;
+	for(int n = 0; n < count; ++n)
+	{
+		if(std::find(fifo.begin(), fifo.end(), idx[n]) == fifo.end())
+		{
+			fifo[head] = idx[n];
+			head = (head + 1) % VCACHE_SIZE;
+			++transforms;
+		}
+	}
+	tris += count / 3;
+}
+
+#endif /* VertexCacheUtils_H */
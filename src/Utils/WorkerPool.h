@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2026, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef WorkerPool_H
+#define WorkerPool_H
+
+/*
+	WorkerPool - a process-wide set of worker threads, one per core, started on first use.
+
+	WorkerPool_ParallelFor(count, job): job(0) ... job(count-1) are run on the workers AND the calling
+	thread, and the call returns when all of them are done.  Calls can come from any thread and can nest
+	(a job may call WorkerPool_ParallelFor itself) - the caller always works on its own batch, so it never
+	waits on a worker that is waiting on it.
+
+	WorkerPool_Post(job): job() runs on a worker some time later; the call returns right away.  The job
+	has to own or share whatever it touches - nothing waits for it.  Batches go ahead of posted jobs, and
+	with no workers (a single core) the job runs right in the call.
+
+	Jobs must not throw.  Header-only so the tools that link BitmapUtils don't need a new source file.
+*/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <list>
+#include <vector>
+#include <deque>
+
+class WorkerPool {
+public:
+
+	static WorkerPool&	Get(void)
+	{
+		static WorkerPool	sPool;
+		return sPool;
+	}
+
+	// Number of threads that work on a batch, including the caller.
+	int		Concurrency(void) const { return mThreads.size() + 1; }
+
+	void	ParallelFor(int count, const std::function<void(int)>& job)
+	{
+		if(count <= 0) return;
+		if(count == 1 || mThreads.empty())
+		{
+			for(int n = 0; n < count; ++n)
+				job(n);
+			return;
+		}
+
+		batch_t	b(count, job);
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mBatches.push_back(&b);
+		}
+		mWake.notify_all();
+
+		int n;
+		while((n = b.next++) < count)
+			run_one(b, n);
+
+		std::unique_lock<std::mutex> lock(mLock);
+		mBatches.remove(&b);
+		b.finished.wait(lock, [&b]{ return b.done == b.count; });
+	}
+
+	void	Post(const std::function<void()>& job)
+	{
+		if(mThreads.empty())
+		{
+			job();
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mPosted.push_back(job);
+		}
+		mWake.notify_one();
+	}
+
+private:
+
+	struct batch_t {
+		batch_t(int c, const std::function<void(int)>& j) : count(c), job(j), next(0), done(0) { }
+		int									count;
+		const std::function<void(int)>&		job;
+		std::atomic<int>					next;
+		int									done;		// guarded by mLock
+		std::condition_variable				finished;
+	};
+
+	WorkerPool() : mQuit(false)
+	{
+		int workers = (int) std::thread::hardware_concurrency() - 1;
+		for(int n = 0; n < workers; ++n)
+			mThreads.push_back(std::thread(&WorkerPool::worker, this));
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mLock);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		for(std::vector<std::thread>::iterator t = mThreads.begin(); t != mThreads.end(); ++t)
+			t->join();
+	}
+
+	void	run_one(batch_t& b, int n)
+	{
+		b.job(n);
+		std::lock_guard<std::mutex> lock(mLock);
+		if(++b.done == b.count)
+			b.finished.notify_all();
+	}
+
+	void	worker(void)
+	{
+		std::unique_lock<std::mutex> lock(mLock);
+		while(1)
+		{
+			batch_t * b = NULL;
+			int n = 0;
+			for(std::list<batch_t *>::iterator i = mBatches.begin(); i != mBatches.end(); ++i)
+			if((n = (*i)->next++) < (*i)->count)
+			{
+				b = *i;
+				break;
+			}
+
+			if(b)
+			{
+				lock.unlock();
+				run_one(*b, n);
+				lock.lock();
+			}
+			else if(!mPosted.empty())
+			{
+				std::function<void()> job;
+				job.swap(mPosted.front());
+				mPosted.pop_front();
+				lock.unlock();
+				job();
+				lock.lock();
+			}
+			else if(mQuit)
+				return;
+			else
+				mWake.wait(lock);
+		}
+	}
+
+	std::vector<std::thread>	mThreads;
+	std::mutex					mLock;
+	std::condition_variable		mWake;
+	std::list<batch_t *>		mBatches;		// batches that may still have unclaimed jobs
+	std::deque<std::function<void()> >	mPosted;
+	bool						mQuit;
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+};
+
+inline void	WorkerPool_ParallelFor(int count, const std::function<void(int)>& job)
+{
+	WorkerPool::Get().ParallelFor(count, job);
+}
+
+inline void	WorkerPool_Post(const std::function<void()>& job)
+{
+	WorkerPool::Get().Post(job);
+}
+
+inline int	WorkerPool_Concurrency(void)
+{
+	return WorkerPool::Get().Concurrency();
+}
+
+#endif /* WorkerPool_H */
@@ -429,7 +429,7 @@ bool	VPFImportTopo3(
 				if (lineMatches[i].count(lin_attr_ref))
 				{
 //					if (inLineRules[i].he_param)
-					DebugAssert(inLineRules[i].he_param >= 0 && inLineRules[i].he_param < gTokens.size());
+					DebugAssert(inLineRules[i].he_param >= 0 && inLineRules[i].he_param < CountTokens());
 						lines.back().he_param = inLineRules[i].he_param;
 					if (inLineRules[i].he_trans_flags)
 						lines.back().he_trans_flags |= inLineRules[i].he_trans_flags;
@@ -689,7 +689,7 @@ bool	VPFImportTopo3(
 
 		if (lines[i].he_param != NO_VALUE)
 		{
-			DebugAssert(lines[i].he_param >= 0 && lines[i].he_param < gTokens.size());
+			DebugAssert(lines[i].he_param >= 0 && lines[i].he_param < CountTokens());
 
 			// Ben says: VPF data comes per edge not half edge.  It has no direction.  This code USED to go through both half-edge lists (a VPF edge is a chain really)
 			// and find the dominant halfedge in each for edge-based metadata.
@@ -36,6 +36,7 @@
 #include "WED_Menus.h"
 #include "WED_PackageMgr.h"
 #include "WED_StartWindow.h"
+#include "WED_Validate.h"
 #include "WED_Version.h"
 
 #include "GUI_Clipboard.h"
@@ -45,6 +46,7 @@
 #include "GUI_Resources.h"
 
 #include <ctime>
+#include <chrono>
 
 #define	REGISTER_LIST	\
 	_R(WED_Airport) \
@@ -136,6 +138,39 @@ HINSTANCE gInstance = NULL;
 
 FILE * gLogFile;
 
+// WED --validate --package=<name>: load the package, validate it and print the report to stdout - no windows.
+// Exits with 1 if there are errors, 0 if it is clean or only has warnings.
+static int	ValidateHeadless(const string& package)
+{
+	if(package.empty() || !gPackageMgr->HasSystemFolder())
+	{
+		fprintf(stderr, "--validate needs an X-Plane folder and --package=<scenery package name>\n");
+		return 2;
+	}
+	try {
+		double b[4] = { -180, -90, 180, 90 };
+		WED_Document * doc = new WED_Document(package, b);
+
+		validation_error_vector msgs;
+		auto t0 = chrono::steady_clock::now();
+		validation_result_t result = WED_ValidateArchive(doc->GetArchive(), msgs);
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - t0;
+
+		WED_WriteValidationReport(stdout, msgs);
+		printf("Validated %s in %.3lf s: %d problems (%s).\n", package.c_str(), elapsed.count(), (int) msgs.size(),
+			result == validation_errors ? "errors" : (result == validation_warnings_only ? "warnings only" : "clean"));
+		LOG_MSG("I/MAIN headless validation of %s took %.3lf s, %d problems\n", package.c_str(), elapsed.count(), (int) msgs.size());
+
+		delete doc;
+		return result == validation_errors ? 1 : 0;
+	} catch(exception& e) {
+		fprintf(stderr, "Could not open %s: %s\n", package.c_str(), e.what());
+	} catch (...) {
+		fprintf(stderr, "Could not open %s.\n", package.c_str());
+	}
+	return 2;
+}
+
 #if IBM
 int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd)
 #else
@@ -208,6 +243,23 @@ int main(int argc, char * argv[])
 	GUI_Prefs_Read("WED");
 	WED_Document::ReadGlobalPrefs();
 
+	if(app.args.has_option("--validate"))
+	{
+		setlocale(LC_ALL, "C");
+		pMgr.SetXPlaneFolder(GUI_GetPrefString("packages","xsystem",""));
+		gFileCache.init();
+		WED_AssertInit();
+		ENUM_Init();
+		#define _R(x)	x##_Register();
+		REGISTER_LIST
+		REGISTER_LIST_ATC
+		#undef _R
+
+		int result = ValidateHeadless(app.args.get_value("--package"));
+		if(gLogFile) fclose(gLogFile);
+		return result;
+	}
+
 	WED_StartWindow * start = new WED_StartWindow(&app);
 	WED_MakeMenus(&app);
 #if LIN
@@ -31,12 +31,13 @@
 #include "WED_Errors.h"
 #include "WED_XMLWriter.h"
 #include "WED_Messages.h"
+#include "WED_BinaryFile.h"
 
 WED_Archive::WED_Archive(IResolver * r) : mResolver(r), mDying(false), mUndo(NULL), mUndoMgr(NULL),
  #if WITHNWLINK
  mNWAdapter(NULL),
  #endif
- mID(1), mOpCount(0), mCacheKey(0)
+ mJournal(NULL), mID(1), mOpCount(0), mCacheKey(0)
 {
 
 }
@@ -72,6 +73,7 @@ void		WED_Archive::ChangedObject(WED_Persistent * inObject, int change_kind)
 #if WITHNWLINK
 	if (mNWAdapter) mNWAdapter->ObjectChanged(inObject, change_kind);
 #endif
+	if (mJournal) mJournal->ObjectTouched(inObject->GetID());
 	if (mUndo == UNDO_DISCARD) return;
 	if (mUndo)	mUndo->ObjectChanged(inObject, change_kind);
 	else		DebugAssert(!"Error: object changed outside of a command.");
@@ -90,6 +92,7 @@ void		WED_Archive::AddObject(WED_Persistent * inObject)
 #if WITHNWLINK
 	if (mNWAdapter) mNWAdapter->ObjectCreated(inObject);
 #endif
+	if (mJournal) mJournal->ObjectTouched(inObject->GetID());
 	if (mUndo == UNDO_DISCARD) return;
 	if (mUndo) mUndo->ObjectCreated(inObject);
 
@@ -106,6 +109,7 @@ void		WED_Archive::RemoveObject(WED_Persistent * inObject)
 #if WITHNWLINK
 	if (mNWAdapter) mNWAdapter->ObjectDestroyed(inObject);
 #endif
+	if (mJournal) mJournal->ObjectTouched(inObject->GetID());
 	if (mUndo == UNDO_DISCARD) return;
 	if (mUndo) mUndo->ObjectDestroyed(inObject);
 	else		DebugAssert(!"Error: object changed outside of a command.");
@@ -140,6 +144,11 @@ void			WED_Archive::SetNWLinkAdapter(WED_NWLinkAdapter * inAdapter)
 	mNWAdapter = inAdapter;
 }
 #endif
+void			WED_Archive::SetJournal(WED_AutosaveJournal * inJournal)
+{
+	mJournal = inJournal;
+}
+
 void			WED_Archive::SetUndoManager(WED_UndoMgr * mgr)
 {
 	mUndoMgr = mgr;
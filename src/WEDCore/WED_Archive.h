@@ -39,8 +39,12 @@
 	This saves us database I/O - even though we have to touch the whole DB for read when we load our file (for now), we don't have
 	to touch the whole DB for right and blast the hell out of all indices.
 
-	Also note that undo DOESN'T restore dirtiness yet - if we delete an obj and undo, the same data WILL be written out to the archive
-	because the undo system isn't smart enough to see what happened.
+	Also note that undo DOESN'T restore dirtiness - anything undo or redo touches comes back dirty, even if it now matches the
+	database again, because a save may have happened since the undo data was recorded.  So if we delete an obj and undo, the same
+	data WILL be written out to the archive.  That costs a little I/O but never loses a change.
+
+	The database is earth.wed.bin - see WED_BinaryFile.h.  The XML file is always written in full.  Between saves the journal
+	(WED_AutosaveJournal, same file) keeps what changed; it follows the archive's change notifications, not dirtiness.
 
 */
 
@@ -50,6 +54,7 @@ class	WED_Persistent;
 class	WED_UndoLayer;
 class	WED_UndoMgr;
 class	WED_XMLElement;
+class	WED_AutosaveJournal;
 class	IResolver;
 #if WITHNWLINK
 class	WED_NWLinkAdapter;
@@ -80,6 +85,7 @@ public:
 #if WITHNWLINK
 	void			SetNWLinkAdapter(WED_NWLinkAdapter * inAdapter);
 #endif
+	void			SetJournal(WED_AutosaveJournal * inJournal);
 	// Undo convenience API.
 	void			SetUndoManager(WED_UndoMgr * mgr);
 	void			__StartCommand(const string& inName, const char * file, int line);		// pass-throughs
@@ -111,6 +117,7 @@ private:
 
 	friend class	WED_Persistent;
 	friend	class	WED_UndoMgr;
+	friend	class	WED_BinaryFile;
 	typedef hash_map<int, WED_Persistent *>	ObjectMap;
 
 	ObjectMap		mObjects;		// Our objects!
@@ -120,6 +127,7 @@ private:
 #if WITHNWLINK
 	WED_NWLinkAdapter *	mNWAdapter;
 #endif
+	WED_AutosaveJournal *	mJournal;
 // Not allowed yet
 
 	WED_Archive(const WED_Archive& rhs);
@@ -0,0 +1,904 @@
+/*
+ * Copyright (c) 2026, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "WED_BinaryFile.h"
+#include "WED_Persistent.h"
+#include "WED_Version.h"
+#include "IODefs.h"
+#include "MemFileUtils.h"
+#include "FileUtils.h"
+#include "AssertUtils.h"
+#include "WED_Messages.h"
+#include <sys/stat.h>
+
+#define	BIN_MAGIC			0x42444557		// "WEDB" in a little-endian file
+#define	JOURNAL_MAGIC		0x4A444557		// "WEDJ"
+#define	BIN_BYTE_ORDER		0x01020304
+#define	BIN_FORMAT			1
+
+#define	BIN_REWRITE_MIN		(1 << 20)		// don't bother compacting files smaller than this
+#define	JOURNAL_COMPACT_MIN	(4 << 20)
+
+enum {
+	tag_block_start	= 0x314B4C42,			// "BLK1"
+	tag_block_end	= 0x31444E45,			// "END1"
+	tag_object		= 0x204A424F,			// "OBJ "
+	tag_deleted		= 0x204C4544,			// "DEL "
+	tag_prefs		= 0x20465250,			// "PRF "
+	tag_xml_stamp	= 0x204C4D58			// "XML "
+};
+
+// Streams into memory; a block is assembled here and hits the disk with one write.
+class	bin_writer : public IOWriter {
+public:
+	string			data;
+
+	virtual	void	WriteShort(short v)		{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteInt(int v)			{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteFloat(float v)		{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteDouble(double v)	{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteBulk(const char * inBuf, int inLength, bool inZip) { data.append(inBuf, inLength); }
+
+			void	WriteString(const string& s) { WriteInt(s.size()); data.append(s); }
+			void	WriteLongLong(long long v)	 { data.append((const char *) &v, sizeof(v)); }
+};
+
+// Streams out of the mapped file.  Running off the end zero-fills and marks the reader bad instead of crashing -
+// the caller checks bad after each record.
+class	bin_reader : public IOReader {
+public:
+					bin_reader(const char * b, const char * e) : p(b), end(e), bad(false) { }
+
+	virtual	void	ReadShort(short& v)		{ get(&v, sizeof(v)); }
+	virtual	void	ReadInt(int& v)			{ get(&v, sizeof(v)); }
+	virtual	void	ReadFloat(float& v)		{ get(&v, sizeof(v)); }
+	virtual	void	ReadDouble(double& v)	{ get(&v, sizeof(v)); }
+	virtual	void	ReadBulk(char * inBuf, int inLength, bool inZip) { get(inBuf, inLength); }
+
+			void	ReadLongLong(long long& v) { get(&v, sizeof(v)); }
+			void	ReadString(string& s)
+			{
+				int l;
+				ReadInt(l);
+				if(bad || l < 0 || end - p < l) { bad = true; p = end; s.clear(); return; }
+				s.assign(p, l);
+				p += l;
+			}
+			// Points at the next len bytes and skips them.
+			const char * Skip(int len)
+			{
+				if(bad || len < 0 || end - p < len) { bad = true; p = end; return end; }
+				const char * r = p;
+				p += len;
+				return r;
+			}
+
+	const char *	p;
+	const char *	end;
+	bool			bad;
+
+private:
+			void	get(void * dst, int len)
+			{
+				if(len < 0 || end - p < len)
+				{
+					bad = true;
+					p = end;
+					if(len > 0) memset(dst, 0, len);
+				}
+				else
+				{
+					memcpy(dst, p, len);
+					p += len;
+				}
+			}
+};
+
+static unsigned int	block_checksum(const char * p, const char * e)
+{
+	unsigned int h = 2166136261u;			// FNV-1a
+	while(p < e)
+	{
+		h ^= (unsigned char) *p++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static bool	get_xml_stamp(const string& xml_path, long long& size, long long& mtime)
+{
+	struct stat ss;
+	if(FILE_get_file_meta_data(xml_path, ss) != 0)
+		return false;
+	size = ss.st_size;
+	mtime = ss.st_mtime;
+	return true;
+}
+
+static void	write_header(bin_writer& w, int magic)
+{
+	w.WriteInt(magic);
+	w.WriteInt(BIN_BYTE_ORDER);
+	w.WriteInt(BIN_FORMAT);
+	w.WriteString(WED_VERSION_STRING);
+}
+
+// Frames a block body: length up front so we can hop over it, length, checksum and end tag at the back so a torn write is detected.
+static void	write_block(bin_writer& w, const string& body)
+{
+	w.WriteInt(tag_block_start);
+	w.WriteInt(body.size());
+	w.data += body;
+	w.WriteInt(body.size());
+	w.WriteInt(block_checksum(body.data(), body.data() + body.size()));
+	w.WriteInt(tag_block_end);
+}
+
+// Reads the header written by write_header and checks that it is ours, from this build.
+static bool	read_header(bin_reader& r, int magic)
+{
+	int m, bom, format;
+	string version;
+	r.ReadInt(m);
+	r.ReadInt(bom);
+	r.ReadInt(format);
+	r.ReadString(version);
+	return !r.bad && m == magic && bom == BIN_BYTE_ORDER && format == BIN_FORMAT && version == WED_VERSION_STRING;
+}
+
+// Steps r over the next block.  False at the end of the file or at a block that isn't complete and intact - that ends the log.
+static bool	next_block(bin_reader& r, const char *& body, int& len)
+{
+	if(r.end - r.p < 5 * (int) sizeof(int)) return false;
+	int tag, len2, sum, tag2;
+	r.ReadInt(tag);
+	r.ReadInt(len);
+	if(tag != tag_block_start || len < 0 || r.end - r.p < (long long) len + 3 * (long long) sizeof(int)) return false;
+	body = r.Skip(len);
+	r.ReadInt(len2);
+	r.ReadInt(sum);
+	r.ReadInt(tag2);
+	return len2 == len && tag2 == tag_block_end && sum == (int) block_checksum(body, body + len);
+}
+
+static void	write_object(bin_writer& w, WED_Persistent * obj)
+{
+	w.WriteInt(tag_object);
+	w.WriteInt(obj->GetID());
+	w.WriteString(obj->GetClass());
+	int len_at = w.data.size();
+	w.WriteInt(0);
+	obj->WriteTo(&w);
+	int len = w.data.size() - len_at - sizeof(int);
+	memcpy(&w.data[len_at], &len, sizeof(len));
+}
+
+// Everything after the objects: the prefs and the stamp of the XML file this block goes with.
+static string	make_tail(const map<string,string>& prefs, const map<string,set<int> >& pref_items, long long xml_size, long long xml_mtime)
+{
+	bin_writer w;
+	w.WriteInt(tag_prefs);
+	w.WriteInt(prefs.size());
+	for(map<string,string>::const_iterator p = prefs.begin(); p != prefs.end(); ++p)
+	{
+		w.WriteString(p->first);
+		w.WriteString(p->second);
+	}
+	w.WriteInt(pref_items.size());
+	for(map<string,set<int> >::const_iterator p = pref_items.begin(); p != pref_items.end(); ++p)
+	{
+		w.WriteString(p->first);
+		w.WriteInt(p->second.size());
+		for(set<int>::const_iterator i = p->second.begin(); i != p->second.end(); ++i)
+			w.WriteInt(*i);
+	}
+	w.WriteInt(tag_xml_stamp);
+	w.WriteLongLong(xml_size);
+	w.WriteLongLong(xml_mtime);
+	return w.data;
+}
+
+WED_BinaryFile::WED_BinaryFile(const string& path) :
+	mPath(path), mHaveBaseline(false), mGoodEnd(0), mLiveBytes(0)
+{
+}
+
+void	WED_BinaryFile::Forget(void)
+{
+	mHaveBaseline = false;
+	mGoodEnd = 0;
+	mLive.clear();
+	mLiveBytes = 0;
+}
+
+bool	WED_BinaryFile::Load(WED_Archive * archive, const string& xml_path,
+						map<string,string>& prefs, map<string,set<int> >& pref_items)
+{
+	Forget();
+
+	long long xml_size, xml_mtime;
+	if(!get_xml_stamp(xml_path, xml_size, xml_mtime))
+		return false;
+
+	MFMemFile * mf = MemFile_Open(mPath.c_str());
+	if(!mf)
+		return false;
+
+	struct rec_t {
+		const char *	cls;
+		int				cls_len;
+		const char *	data;
+		int				data_len;
+		int				size;
+	};
+	hash_map<int, rec_t>	recs;
+	map<string,string>		new_prefs;
+	map<string,set<int> >	new_items;
+	long long				stamp_size = -1, stamp_mtime = -1;
+	bool					ok = false;
+
+	bin_reader r(MemFile_GetBegin(mf), MemFile_GetEnd(mf));
+	const char * body;
+	int len;
+
+	if(read_header(r, BIN_MAGIC))
+	while(next_block(r, body, len))
+	{
+		bin_reader b(body, body + len);
+		while(!b.bad && b.p < b.end)
+		{
+			int rtag, id;
+			const char * rec_start = b.p;
+			b.ReadInt(rtag);
+			if(rtag == tag_object)
+			{
+				rec_t rec;
+				b.ReadInt(id);
+				b.ReadInt(rec.cls_len);
+				rec.cls = b.Skip(rec.cls_len);
+				b.ReadInt(rec.data_len);
+				rec.data = b.Skip(rec.data_len);
+				rec.size = b.p - rec_start;
+				recs[id] = rec;
+			}
+			else if(rtag == tag_deleted)
+			{
+				b.ReadInt(id);
+				recs.erase(id);
+			}
+			else if(rtag == tag_prefs)
+			{
+				int n, k;
+				string key, value;
+				new_prefs.clear();
+				new_items.clear();
+				b.ReadInt(n);
+				while(!b.bad && n-- > 0)
+				{
+					b.ReadString(key);
+					b.ReadString(value);
+					new_prefs[key] = value;
+				}
+				b.ReadInt(n);
+				while(!b.bad && n-- > 0)
+				{
+					b.ReadString(key);
+					b.ReadInt(k);
+					set<int>& items(new_items[key]);
+					while(!b.bad && k-- > 0)
+					{
+						int i;
+						b.ReadInt(i);
+						items.insert(i);
+					}
+				}
+			}
+			else if(rtag == tag_xml_stamp)
+			{
+				b.ReadLongLong(stamp_size);
+				b.ReadLongLong(stamp_mtime);
+			}
+			else
+				b.bad = true;
+		}
+		if(b.bad)				// checksum was fine, so this is a file from a buggy or foreign writer - don't trust any of it.
+		{
+			stamp_size = -1;
+			break;
+		}
+		mGoodEnd = r.p - MemFile_GetBegin(mf);
+		ok = true;
+	}
+
+	if(ok && stamp_size == xml_size && stamp_mtime == xml_mtime)
+	{
+		// Create in ID order so loads are repeatable; ReadFrom doesn't care about order since it only stores peer IDs.
+		vector<int> ids;
+		ids.reserve(recs.size());
+		for(hash_map<int, rec_t>::iterator i = recs.begin(); i != recs.end(); ++i)
+			ids.push_back(i->first);
+		sort(ids.begin(), ids.end());
+
+		vector<WED_Persistent *>	objs;
+		vector<WED_Persistent *>	needs_post_call;
+		objs.reserve(ids.size());
+		for(vector<int>::iterator id = ids.begin(); id != ids.end(); ++id)
+		{
+			const rec_t& rec(recs[*id]);
+			WED_Persistent * obj = WED_Persistent::CreateByClass(string(rec.cls, rec.cls_len).c_str(), archive, *id);
+			if(obj == NULL)
+			{
+				ok = false;
+				break;
+			}
+			objs.push_back(obj);
+			bin_reader o(rec.data, rec.data + rec.data_len);
+			if(obj->ReadFrom(&o))
+				needs_post_call.push_back(obj);
+			if(o.bad || o.p != o.end)		// a class that streams differently than when this was written
+			{
+				ok = false;
+				break;
+			}
+			mLive[*id] = rec.size;
+			mLiveBytes += rec.size;
+		}
+
+		if(ok)
+		{
+			for(vector<WED_Persistent *>::iterator o = needs_post_call.begin(); o != needs_post_call.end(); ++o)
+				(*o)->PostChangeNotify();
+			for(vector<WED_Persistent *>::iterator o = objs.begin(); o != objs.end(); ++o)
+				(*o)->SetDirty(0);
+
+			prefs.swap(new_prefs);
+			pref_items.swap(new_items);
+			archive->mOpCount = 0;
+			++archive->mCacheKey;
+			mHaveBaseline = true;
+		}
+	}
+	else
+		ok = false;
+
+	MemFile_Close(mf);
+	if(!ok)
+		Forget();
+	return ok;
+}
+
+bool	WED_BinaryFile::Save(WED_Archive * archive, const string& xml_path,
+						const map<string,string>& prefs, const map<string,set<int> >& pref_items)
+{
+	long long xml_size, xml_mtime;
+	if(!get_xml_stamp(xml_path, xml_size, xml_mtime))
+	{
+		Forget();
+		FILE_delete_file(mPath.c_str(), false);
+		return false;
+	}
+	string tail = make_tail(prefs, pref_items, xml_size, xml_mtime);
+
+	if(!mHaveBaseline)
+		return Rewrite(archive, tail);
+
+	// Only what changed since the file last matched memory: dirty objects and objects that are gone.
+	bin_writer					body;
+	vector<WED_Persistent *>	written;
+	hash_map<int,int>			sizes;
+	vector<int>					deleted;
+	long long					live_bytes = mLiveBytes;
+
+	for(WED_Archive::ObjectMap::iterator ob = archive->mObjects.begin(); ob != archive->mObjects.end(); ++ob)
+	{
+		hash_map<int,int>::iterator l = mLive.find(ob->first);
+		if(ob->second == NULL)
+		{
+			if(l != mLive.end())
+			{
+				body.WriteInt(tag_deleted);
+				body.WriteInt(ob->first);
+				deleted.push_back(ob->first);
+				live_bytes -= l->second;
+			}
+		}
+		else if(ob->second->GetDirty() || l == mLive.end())
+		{
+			int start = body.data.size();
+			write_object(body, ob->second);
+			int size = body.data.size() - start;
+			sizes[ob->first] = size;
+			live_bytes += size - (l == mLive.end() ? 0 : l->second);
+			written.push_back(ob->second);
+		}
+	}
+	body.data += tail;
+
+	bin_writer block;
+	write_block(block, body.data);
+
+	long long file_size = mGoodEnd + block.data.size();
+	if(file_size > BIN_REWRITE_MIN && file_size - live_bytes > live_bytes)
+		return Rewrite(archive, tail);
+
+	FILE * fi = fopen(mPath.c_str(), "r+b");
+	bool ok = fi != NULL;
+	if(ok) ok = fseek(fi, mGoodEnd, SEEK_SET) == 0;
+	if(ok) ok = fwrite(block.data.data(), 1, block.data.size(), fi) == block.data.size();
+	if(fi)
+	{
+		if(fflush(fi) != 0) ok = false;
+		if(fclose(fi) != 0) ok = false;
+	}
+
+	if(!ok)
+	{
+		Forget();
+		FILE_delete_file(mPath.c_str(), false);
+		return false;
+	}
+
+	for(vector<int>::iterator d = deleted.begin(); d != deleted.end(); ++d)
+		mLive.erase(*d);
+	for(hash_map<int,int>::iterator s = sizes.begin(); s != sizes.end(); ++s)
+		mLive[s->first] = s->second;
+	for(vector<WED_Persistent *>::iterator w = written.begin(); w != written.end(); ++w)
+		(*w)->SetDirty(0);
+	mLiveBytes = live_bytes;
+	mGoodEnd = file_size;
+	return true;
+}
+
+// Writes a fresh file with one block of every object, next to the old one, and swaps it in.
+bool	WED_BinaryFile::Rewrite(WED_Archive * archive, const string& tail)
+{
+	Forget();
+
+	bin_writer body;
+	hash_map<int,int> sizes;
+	long long live_bytes = 0;
+	for(WED_Archive::ObjectMap::iterator ob = archive->mObjects.begin(); ob != archive->mObjects.end(); ++ob)
+	if(ob->second)
+	{
+		int start = body.data.size();
+		write_object(body, ob->second);
+		int size = body.data.size() - start;
+		sizes[ob->first] = size;
+		live_bytes += size;
+	}
+	body.data += tail;
+
+	bin_writer file;
+	write_header(file, BIN_MAGIC);
+	write_block(file, body.data);
+	body.data.clear();
+
+	string temp_path = mPath + ".tmp";
+	FILE * fi = fopen(temp_path.c_str(), "wb");
+	bool ok = fi != NULL;
+	if(ok) ok = fwrite(file.data.data(), 1, file.data.size(), fi) == file.data.size();
+	if(fi && fclose(fi) != 0) ok = false;
+	if(ok)
+	{
+		FILE_delete_file(mPath.c_str(), false);
+		ok = FILE_rename_file(temp_path.c_str(), mPath.c_str()) == 0;
+	}
+	if(!ok)
+	{
+		FILE_delete_file(temp_path.c_str(), false);
+		FILE_delete_file(mPath.c_str(), false);
+		return false;
+	}
+
+	for(WED_Archive::ObjectMap::iterator ob = archive->mObjects.begin(); ob != archive->mObjects.end(); ++ob)
+	if(ob->second)
+		ob->second->SetDirty(0);
+	mLive.swap(sizes);
+	mLiveBytes = live_bytes;
+	mGoodEnd = file.data.size();
+	mHaveBaseline = true;
+	return true;
+}
+
+//---------------------------------------------------------------------------------------------------------------------------
+// WED_AutosaveJournal
+//---------------------------------------------------------------------------------------------------------------------------
+
+// The journal is relative to an XML file that may not exist yet - a brand new package - so a missing file has a stamp too.
+static void	get_journal_base(const string& xml_path, long long& size, long long& mtime)
+{
+	if(!get_xml_stamp(xml_path, size, mtime))
+		size = mtime = -1;
+}
+
+static void	write_journal_header(bin_writer& w, long long xml_size, long long xml_mtime)
+{
+	write_header(w, JOURNAL_MAGIC);
+	w.WriteLongLong(xml_size);
+	w.WriteLongLong(xml_mtime);
+}
+
+WED_AutosaveJournal::WED_AutosaveJournal(const string& path) :
+	mPath(path), mArchive(NULL), mNeedReset(false), mBaseSize(-1), mBaseMtime(-1),
+	mBusy(false), mQuit(false), mFailed(false),
+	mFile(NULL), mFileSize(0), mRecordBytes(0)
+{
+	mFileBase[0] = mFileBase[1] = -1;
+}
+
+WED_AutosaveJournal::~WED_AutosaveJournal()
+{
+	Stop(false);
+	if(mThread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(mLock);
+			mQuit = true;
+		}
+		mWake.notify_all();
+		mThread.join();
+	}
+	CloseFile(false);
+}
+
+bool	WED_AutosaveJournal::ReadBack(const string& xml_path)
+{
+	DiscardReadBack();
+
+	long long xml_size, xml_mtime;
+	get_journal_base(xml_path, xml_size, xml_mtime);
+
+	MFMemFile * mf = MemFile_Open(mPath.c_str());
+	if(!mf)
+		return false;
+
+	bin_reader r(MemFile_GetBegin(mf), MemFile_GetEnd(mf));
+	long long base_size, base_mtime;
+	bool ok = read_header(r, JOURNAL_MAGIC);
+	r.ReadLongLong(base_size);
+	r.ReadLongLong(base_mtime);
+
+	const char * body;
+	int len;
+	if(ok && !r.bad && base_size == xml_size && base_mtime == xml_mtime)
+	while(next_block(r, body, len))
+	{
+		// Blocks are whole commands, so we either take a block or stop - never half of one.
+		map<int,read_back_t>	block;
+		bin_reader b(body, body + len);
+		while(!b.bad && b.p < b.end)
+		{
+			int rtag, id;
+			b.ReadInt(rtag);
+			b.ReadInt(id);
+			read_back_t& rec(block[id]);
+			if(rtag == tag_object)
+			{
+				b.ReadString(rec.cls);
+				b.ReadString(rec.data);
+				if(rec.cls.empty()) b.bad = true;
+			}
+			else if(rtag == tag_deleted)
+			{
+				rec.cls.clear();
+				rec.data.clear();
+			}
+			else
+				b.bad = true;
+		}
+		if(b.bad)
+			break;
+		for(map<int,read_back_t>::iterator i = block.begin(); i != block.end(); ++i)
+			mReadBack[i->first] = i->second;
+	}
+
+	MemFile_Close(mf);
+	return !mReadBack.empty();
+}
+
+void	WED_AutosaveJournal::DiscardReadBack(void)
+{
+	mReadBack.clear();
+}
+
+bool	WED_AutosaveJournal::Replay(WED_Archive * archive)
+{
+	// Same moves as WED_UndoLayer::Execute, except that a record that doesn't fit is an error rather than an assert.
+	vector<WED_Persistent *>	needs_post_call;
+	bool ok = true;
+	for(map<int,read_back_t>::iterator i = mReadBack.begin(); ok && i != mReadBack.end(); ++i)
+	{
+		WED_Persistent * obj = archive->Fetch(i->first);
+		if(i->second.cls.empty())
+		{
+			if(obj)
+				obj->Delete();
+			continue;
+		}
+		if(obj && i->second.cls != obj->GetClass())
+		{
+			obj->Delete();
+			obj = NULL;
+		}
+		if(obj)
+			obj->StateChanged();
+		else
+			obj = WED_Persistent::CreateByClass(i->second.cls.c_str(), archive, i->first);
+		if(obj == NULL)
+		{
+			ok = false;
+			break;
+		}
+		bin_reader r(i->second.data.data(), i->second.data.data() + i->second.data.size());
+		if(obj->ReadFrom(&r))
+			needs_post_call.push_back(obj);
+		obj->SetDirty(1);
+		if(r.bad || r.p != r.end)
+			ok = false;
+	}
+	if(ok)
+	for(vector<WED_Persistent *>::iterator o = needs_post_call.begin(); o != needs_post_call.end(); ++o)
+		(*o)->PostChangeNotify();
+	return ok;
+}
+
+void	WED_AutosaveJournal::Start(WED_Archive * archive, const string& xml_path)
+{
+	if(mArchive != archive)
+	{
+		Stop(false);
+		mArchive = archive;
+		mArchive->SetJournal(this);
+		mArchive->AddListener(this);
+	}
+	mTouched.clear();
+	get_journal_base(xml_path, mBaseSize, mBaseMtime);
+	mNeedReset = true;
+
+	if(!mThread.joinable())
+		mThread = std::thread(&WED_AutosaveJournal::WriterMain, this);
+}
+
+void	WED_AutosaveJournal::Stop(bool remove_file)
+{
+	if(mArchive)
+	{
+		mArchive->SetJournal(NULL);
+		mArchive->RemoveListener(this);
+		mArchive = NULL;
+	}
+	mTouched.clear();
+	mNeedReset = false;
+
+	if(remove_file)
+	{
+		if(mThread.joinable())
+		{
+			job_t job;
+			job.kind = job_remove;
+			Queue(job);
+		}
+		else
+			FILE_delete_file(mPath.c_str(), false);
+	}
+	Flush();
+}
+
+bool	WED_AutosaveJournal::Flush(void)
+{
+	if(!mThread.joinable())
+		return false;
+	unique_lock<mutex> lock(mLock);
+	mIdle.wait(lock, [this] { return mJobs.empty() && !mBusy; });
+	return mArchive != NULL && !mFailed;
+}
+
+void	WED_AutosaveJournal::ObjectTouched(int id)
+{
+	mTouched.insert(id);
+}
+
+void	WED_AutosaveJournal::ReceiveMessage(
+							GUI_Broadcaster *		inSrc,
+							intptr_t    			inMsg,
+							intptr_t				inParam)
+{
+	if(inMsg != msg_ArchiveChanged || mArchive == NULL || mTouched.empty())
+		return;
+
+	if(mNeedReset)
+	{
+		job_t reset;
+		reset.kind = job_reset;
+		reset.xml_size = mBaseSize;
+		reset.xml_mtime = mBaseMtime;
+		Queue(reset);
+		mNeedReset = false;
+	}
+
+	job_t job;
+	job.kind = job_append;
+	job.records.reserve(mTouched.size());
+	for(set<int>::iterator id = mTouched.begin(); id != mTouched.end(); ++id)
+	{
+		bin_writer w;
+		if(WED_Persistent * obj = mArchive->Fetch(*id))
+			write_object(w, obj);
+		else
+		{
+			w.WriteInt(tag_deleted);
+			w.WriteInt(*id);
+		}
+		job.records.push_back(pair<int,string>(*id, string()));
+		job.records.back().second.swap(w.data);
+	}
+	mTouched.clear();
+	Queue(job);
+}
+
+void	WED_AutosaveJournal::Queue(job_t& job)
+{
+	{
+		lock_guard<mutex> lock(mLock);
+		if(job.kind != job_append)
+			mFailed = false;				// a fresh start gets a fresh chance
+		else if(mFailed)
+			return;
+		mJobs.push_back(job_t());
+		std::swap(mJobs.back(), job);
+	}
+	mWake.notify_one();
+}
+
+void	WED_AutosaveJournal::WriterMain(void)
+{
+	unique_lock<mutex> lock(mLock);
+	while(1)
+	{
+		mWake.wait(lock, [this] { return mQuit || !mJobs.empty(); });
+		if(mJobs.empty())
+			break;
+		job_t job;
+		std::swap(job, mJobs.front());
+		mJobs.pop_front();
+		mBusy = true;
+		lock.unlock();
+
+		switch(job.kind) {
+		case job_reset:		DoReset(job);	break;
+		case job_append:	DoAppend(job);	break;
+		case job_remove:
+			CloseFile(false);
+			FILE_delete_file(mPath.c_str(), false);
+			break;
+		}
+
+		lock.lock();
+		mBusy = false;
+		if(mJobs.empty())
+			mIdle.notify_all();
+	}
+}
+
+void	WED_AutosaveJournal::DoReset(const job_t& job)
+{
+	CloseFile(false);
+	mFileBase[0] = job.xml_size;
+	mFileBase[1] = job.xml_mtime;
+
+	bin_writer header;
+	write_journal_header(header, mFileBase[0], mFileBase[1]);
+	mFile = fopen(mPath.c_str(), "wb");
+	if(mFile == NULL || fwrite(header.data.data(), 1, header.data.size(), mFile) != header.data.size() || fflush(mFile) != 0)
+		CloseFile(true);
+	else
+		mFileSize = header.data.size();
+}
+
+void	WED_AutosaveJournal::DoAppend(job_t& job)
+{
+	if(mFile == NULL)
+		return;
+
+	string body;
+	for(vector<pair<int,string> >::iterator r = job.records.begin(); r != job.records.end(); ++r)
+		body += r->second;
+
+	bin_writer block;
+	write_block(block, body);
+	body.clear();
+
+	if(fwrite(block.data.data(), 1, block.data.size(), mFile) != block.data.size() || fflush(mFile) != 0)
+	{
+		CloseFile(true);
+		return;
+	}
+	mFileSize += block.data.size();
+
+	for(vector<pair<int,string> >::iterator r = job.records.begin(); r != job.records.end(); ++r)
+	{
+		string& rec(mRecords[r->first]);
+		mRecordBytes += (long long) r->second.size() - (long long) rec.size();
+		rec.swap(r->second);
+	}
+
+	if(mFileSize > JOURNAL_COMPACT_MIN && mFileSize > 2 * mRecordBytes)
+	if(!Compact())
+		CloseFile(true);
+}
+
+// Writes the newest record of every object as one block, next to the journal, and swaps it in.  Deletes stay in - the
+// object may well exist in the XML.
+bool	WED_AutosaveJournal::Compact(void)
+{
+	vector<int> ids;
+	ids.reserve(mRecords.size());
+	for(hash_map<int,string>::iterator r = mRecords.begin(); r != mRecords.end(); ++r)
+		ids.push_back(r->first);
+	sort(ids.begin(), ids.end());
+
+	string body;
+	body.reserve(mRecordBytes);
+	for(vector<int>::iterator id = ids.begin(); id != ids.end(); ++id)
+		body += mRecords[*id];
+
+	bin_writer file;
+	write_journal_header(file, mFileBase[0], mFileBase[1]);
+	write_block(file, body);
+	body.clear();
+
+	string temp_path = mPath + ".tmp";
+	FILE * fi = fopen(temp_path.c_str(), "wb");
+	bool ok = fi != NULL;
+	if(ok) ok = fwrite(file.data.data(), 1, file.data.size(), fi) == file.data.size();
+	if(fi && fclose(fi) != 0) ok = false;
+	if(!ok)
+	{
+		FILE_delete_file(temp_path.c_str(), false);
+		return false;
+	}
+
+	fclose(mFile);
+	mFile = NULL;
+	FILE_delete_file(mPath.c_str(), false);
+	if(FILE_rename_file(temp_path.c_str(), mPath.c_str()) != 0)
+		return false;
+	mFile = fopen(mPath.c_str(), "ab");
+	mFileSize = file.data.size();
+	return mFile != NULL;
+}
+
+void	WED_AutosaveJournal::CloseFile(bool failed)
+{
+	if(mFile)
+		fclose(mFile);
+	mFile = NULL;
+	mFileSize = 0;
+	mRecords.clear();
+	mRecordBytes = 0;
+	if(failed)
+	{
+		lock_guard<mutex> lock(mLock);
+		mFailed = true;
+	}
+}
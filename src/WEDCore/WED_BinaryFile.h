@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2026, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef WED_BINARYFILE_H
+#define WED_BINARYFILE_H
+
+/*
+
+	WED_BinaryFile - THEORY OF OPERATION
+
+	earth.wed.bin is a binary twin of earth.wed.xml.  It holds the same objects, streamed with the ReadFrom/WriteTo methods
+	the undo system already uses, so opening a package is a walk over a memory-mapped file instead of an expat parse and a
+	FromXML per object.  The XML stays the interchange format - it is still written on every save and it is what other tools
+	and other WED versions read.
+
+	The file is a header followed by a log of save blocks:
+
+		header		magic, byte order mark, format version, WED version string
+		block		'BLK1' <length> records... <length> <checksum> 'END1'
+
+	The records in a block are an 'OBJ ' (id, class, WriteTo bytes) for every object that changed since the last save, a
+	'DEL ' (id) for every object that went away, the document prefs and the size and mod date of the earth.wed.xml that was
+	written along with the block.  So a save only streams the dirty objects - per the dirtiness rules in WED_Archive.h - and
+	appends them; on load the blocks are replayed in order and the last record for an id wins.
+
+	The binary file is only ever a shortcut.  It is ignored, and the XML is read, when:
+	- it was written by a different WED build (property streams are positional, so they change between versions),
+	- the XML it was saved with has since been changed or replaced by someone else, or
+	- it is damaged.  A block cut short by a crash fails its trailer check; it and everything after it are dropped and the
+	  file reads as of the save before.
+
+	When superseded and deleted records outweigh the live ones, the next save rewrites the file from scratch.
+
+*/
+
+/*
+
+	WED_AutosaveJournal - THEORY OF OPERATION
+
+	Between saves, earth.wed.journal records every committed command - and every undo and redo - as the objects it touched,
+	in the same block and record format as earth.wed.bin but relative to the XML file as of the last load or save.  If WED
+	goes down, the next open finds a journal that goes with the XML on disk and offers to replay it on top.
+
+	The archive tells the journal about every object it sees created, changed or destroyed; on msg_ArchiveChanged those
+	objects are streamed with WriteTo.  That part runs on the main thread because that's where the objects live, and costs
+	about what the undo layer just spent on the same objects.  The file I/O - appending, flushing, and compacting when the
+	file grows to more than twice the newest records it holds - runs on the journal's own thread, so the UI never waits on
+	the disk, whatever the size of the package.
+
+	Nothing is written until the first change, so opening a package (or validating it headless) leaves an old journal alone.
+
+*/
+
+#include "WED_Archive.h"
+#include "GUI_Listener.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+class	WED_BinaryFile {
+public:
+
+					WED_BinaryFile(const string& path);
+
+	// Replace the archive contents and the doc prefs with the binary file, if it exists, matches our build and was saved
+	// along with the XML file at xml_path as it is now.  Must be called inside a command on an empty archive.  Returns
+	// false if the file can't be used - the archive may then hold some objects, clear it before going to the XML.
+	bool			Load(WED_Archive * archive, const string& xml_path,
+						map<string,string>& prefs, map<string,set<int> >& pref_items);
+
+	// Append the changes since the last load or save - or rewrite the whole file if we have no baseline or too much dead
+	// weight.  Call right after the XML at xml_path was written.  On failure the binary file is removed.
+	bool			Save(WED_Archive * archive, const string& xml_path,
+						const map<string,string>& prefs, const map<string,set<int> >& pref_items);
+
+	// Drop the baseline: the file no longer matches what is in memory (e.g. we loaded the XML), so the next save rewrites it.
+	void			Forget(void);
+
+private:
+
+	bool			Rewrite(WED_Archive * archive, const string& tail);
+
+	string				mPath;
+	bool				mHaveBaseline;		// the file on disk + mLive describe the archive as of the last load/save
+	long long			mGoodEnd;			// offset past the last complete block - appends go here
+	hash_map<int,int>	mLive;				// id -> size of the record the file currently resolves that id to
+	long long			mLiveBytes;
+
+	WED_BinaryFile(const WED_BinaryFile&);
+	WED_BinaryFile& operator=(const WED_BinaryFile&);
+
+};
+
+class	WED_AutosaveJournal : public GUI_Listener {
+public:
+
+					WED_AutosaveJournal(const string& path);
+	virtual			~WED_AutosaveJournal();
+
+	// Pull in a journal left behind by a previous run, if it was recorded against the XML at xml_path as it is now.  Returns
+	// true if there is something to recover.  Call before Start - the first change after Start replaces the file.
+	bool			ReadBack(const string& xml_path);
+	bool			HasReadBack(void) const { return !mReadBack.empty(); }
+	// Apply what ReadBack found to the archive - call inside a command, abort it if this returns false.
+	bool			Replay(WED_Archive * archive);
+	void			DiscardReadBack(void);
+
+	// Record the changes to archive relative to the XML at xml_path (which need not exist yet) from here on.
+	void			Start(WED_Archive * archive, const string& xml_path);
+	// Stop recording and wait for the writer; with remove_file the journal is deleted too.
+	void			Stop(bool remove_file);
+	// Wait until every committed change is on disk.  False if we aren't recording or the journal can't be written.
+	bool			Flush(void);
+
+	void			ObjectTouched(int id);		// from the archive
+
+	virtual	void	ReceiveMessage(
+							GUI_Broadcaster *		inSrc,
+							intptr_t    			inMsg,
+							intptr_t				inParam);
+
+private:
+
+	enum { job_reset, job_append, job_remove };
+
+	struct	job_t {
+		int							kind;
+		long long					xml_size;
+		long long					xml_mtime;
+		vector<pair<int,string> >	records;		// id, complete OBJ or DEL record
+	};
+
+	struct	read_back_t {
+		string		cls;						// empty for a deleted object
+		string		data;
+	};
+
+	void			Queue(job_t& job);
+	void			WriterMain(void);
+	void			DoReset(const job_t& job);
+	void			DoAppend(job_t& job);
+	bool			Compact(void);
+	void			CloseFile(bool failed);
+
+	string					mPath;
+
+	// Main thread
+	WED_Archive *			mArchive;
+	set<int>				mTouched;
+	bool					mNeedReset;
+	long long				mBaseSize;
+	long long				mBaseMtime;
+	map<int,read_back_t>	mReadBack;
+
+	// Shared with the writer
+	std::thread				mThread;
+	std::mutex				mLock;
+	std::condition_variable	mWake;
+	std::condition_variable	mIdle;
+	deque<job_t>			mJobs;
+	bool					mBusy;
+	bool					mQuit;
+	bool					mFailed;
+
+	// Writer only
+	FILE *					mFile;
+	long long				mFileSize;
+	hash_map<int,string>	mRecords;			// the newest record for every id in the file
+	long long				mRecordBytes;
+	long long				mFileBase[2];
+
+	WED_AutosaveJournal(const WED_AutosaveJournal&);
+	WED_AutosaveJournal& operator=(const WED_AutosaveJournal&);
+
+};
+
+#endif /* WED_BINARYFILE_H */
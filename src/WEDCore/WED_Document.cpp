@@ -66,6 +66,7 @@ int gModeratorMode;
 int gFontSize;
 string gCustomSlippyMap;
 int gOrthoExport;
+int gSlippyCacheMB;
 
 static set<WED_Document *> sDocuments;
 static map<string,string>	sGlobalPrefs;
@@ -85,7 +86,9 @@ WED_Document::WED_Document(
 #endif
 	mPrefsChanged(false),
 	mUndo(&mArchive, this),
-	mArchive(this)
+	mArchive(this),
+	mBinary(gPackageMgr->ComputePath(package, "earth.wed.bin")),
+	mJournal(gPackageMgr->ComputePath(package, "earth.wed.journal"))
 {
 
 	mTexMgr = new WED_TexMgr(package);
@@ -101,7 +104,9 @@ WED_Document::WED_Document(
 	mBounds[2] = inBounds[2];
 	mBounds[3] = inBounds[3];
 
-	Revert();
+	// Look at the journal before Revert starts a new one; whoever opens us for editing decides about RecoverAutosave.
+	mJournal.ReadBack(GetFilePath());
+	ReadFromDisk();
 	mUndo.PurgeUndo();
 	mUndo.PurgeRedo();
 
@@ -279,6 +284,12 @@ void	WED_Document::Save(void)
 		// This is the save-was-okay case.
 		mOnDisk=true;
 		mPrefsChanged=false;
+
+		// The binary twin goes second, since it records which XML it belongs with.  If it can't be written it's simply gone
+		// and the next open reads the XML.
+		if(!mBinary.Save(&mArchive, xml, mDocPrefs, mDocPrefsItems))
+			LOG_MSG("E/Doc Unable to write binary archive, XML saved fine\n");
+		mJournal.Start(&mArchive, xml);
 	}
 
 	//if the second backup still exists after the error handling
@@ -298,6 +309,15 @@ void	WED_Document::Revert(void)
 			return;
 	}
 
+	// The user threw those changes away - the journal must not offer them back after a crash.
+	mJournal.DiscardReadBack();
+	mJournal.Stop(true);
+	ReadFromDisk();
+}
+
+void	WED_Document::ReadFromDisk(void)
+{
+	mJournal.Stop(false);
 	mDocPrefs.clear();
 	mUndo.__StartCommand("Revert from Saved.",__FILE__,__LINE__);
 
@@ -308,11 +328,22 @@ void	WED_Document::Revert(void)
 		fname+=".xml";
 		mArchive.ClearAll();
 
-		// First: try to IO the XML file.
+		// First: try the binary twin - it only loads if it goes with the XML file as it is now.
 		bool xml_exists;
-		LOG_MSG("I/Doc reading XML from %s\n", fname.c_str());
+		string result;
+		if(mBinary.Load(&mArchive, fname, mDocPrefs, mDocPrefsItems))
+		{
+			LOG_MSG("I/Doc read binary archive for %s\n", fname.c_str());
+			xml_exists = true;
+		}
+		else
+		{
+			// Then the XML file.
+			mArchive.ClearAll();
+			LOG_MSG("I/Doc reading XML from %s\n", fname.c_str());
 
-		string result = reader.ReadFile(fname.c_str(),&xml_exists);
+			result = reader.ReadFile(fname.c_str(),&xml_exists);
+		}
 
 		for (auto sp : mDocPrefs)
 			LOG_MSG("I/Doc prefs %s = %s\n", sp.first.c_str(), sp.second.c_str());
@@ -369,9 +400,34 @@ void	WED_Document::Revert(void)
 		mUndo.PurgeUndo();
 	}
 
+	// Only after the repair: it is redone on every open, so it needn't be journaled - and a journal left by a crash must
+	// survive the open untouched until RecoverAutosave had its say.
+	mJournal.Start(&mArchive, mFilePath + ".xml");
+
 	BroadcastMessage(msg_DocLoaded, reinterpret_cast<uintptr_t>(static_cast<IDocPrefs *>(this)));
 }
 
+void	WED_Document::RecoverAutosave(void)
+{
+	if(!mJournal.HasReadBack())
+		return;
+
+	string msg = "WED found changes to '" + mPackage + "' that were never saved - it may have quit unexpectedly.  "
+				 "Do you want to recover them?";
+	if(ConfirmMessage(msg.c_str(), "Recover", "Discard"))
+	{
+		mUndo.__StartCommand("Recover Unsaved Changes",__FILE__,__LINE__);
+		if(mJournal.Replay(&mArchive))
+			mUndo.CommitCommand();
+		else
+		{
+			mUndo.AbortCommand();
+			DoUserAlert("The unsaved changes could not be recovered - the package is as it was last saved.");
+		}
+	}
+	mJournal.DiscardReadBack();
+}
+
 bool	WED_Document::IsDirty(void)
 {
 	return mArchive.IsDirty() != 0 || mPrefsChanged;
@@ -399,6 +455,7 @@ bool	WED_Document::TryClose(void)
 		case close_Cancel:	return false;
 		}
 	}
+	mJournal.Stop(true);
 #if WITHNWLINK
 	if(mServer)
 	{
@@ -586,6 +643,7 @@ void	WED_Document::ReadGlobalPrefs(void)
 	gFontSize = intlim(FontSize, 10, 18);
 	GUI_SetFontSizes(gFontSize);
 	gOrthoExport = atoi(GUI_GetPrefString("preferences","OrthoExport","1"));
+	gSlippyCacheMB = intlim(atoi(GUI_GetPrefString("preferences","SlippyCacheMB","256")), 16, 4096);
 }
 
 void	WED_Document::WriteGlobalPrefs(void)
@@ -596,6 +654,7 @@ void	WED_Document::WriteGlobalPrefs(void)
 	string FontSize(to_string(gFontSize));
 	GUI_SetPrefString("preferences","FontSize",FontSize.c_str());
 	GUI_SetPrefString("preferences","OrthoExport",gOrthoExport ? "1" : "0");
+	GUI_SetPrefString("preferences","SlippyCacheMB",to_string(gSlippyCacheMB).c_str());
 
 	for (map<string,string>::iterator i = sGlobalPrefs.begin(); i != sGlobalPrefs.end(); ++i)
 		if(i->first != "doc/xml_compatibility")          // why NOT write that ? Cuz WED 2.0 ... 2.2 read that and if an PRE wed-2.0 document
@@ -689,7 +748,13 @@ void		WED_Document::PopHandler(void)
 void WED_Document::Panic(void)
 {
 	// Panic case: means undo system blew up.  Try to save off the current project with a special "crash" extension - if we get lucky,
-	// we save the user's work.
+	// we save the user's work.  Every command up to the last sane state is in the journal already; the crash file is only
+	// needed if that can't be written.
+	if(mJournal.Flush())
+	{
+		LOG_MSG("I/Doc panic: changes to %s are in the autosave journal\n", mPackage.c_str());
+		return;
+	}
 	string xml = mFilePath;
 	xml += ".crash.xml";
 
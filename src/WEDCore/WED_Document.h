@@ -35,6 +35,7 @@
 #include "PlatformUtils.h"
 #include "WED_Archive.h"
 #include "WED_UndoMgr.h"
+#include "WED_BinaryFile.h"
 
 
 class	WED_Thing;
@@ -118,6 +119,8 @@ public:
 	//Saves the file, returns true if successful, false if not.
 	void				Save(void);
 	void				Revert(void);
+	// Offer to replay the changes a crashed session left in the journal - call once the document has a window.
+	void				RecoverAutosave(void);
 	bool				IsDirty(void);
 	void				SetDirty();
 	bool				IsOnDisk(void);
@@ -136,6 +139,7 @@ private:
 	bool				ReadPrefInternal(const char * in_key, unsigned type, string &out_value) const;
 
 	void				WriteXML(FILE * fi);
+	void				ReadFromDisk(void);		// Revert without asking and without touching the journal's read-back
 
 	//Member Variables
 
@@ -149,6 +153,8 @@ private:
 	//sql_db				mDB;
 	WED_Archive			mArchive;
 	WED_UndoMgr			mUndo;
+	WED_BinaryFile		mBinary;				// earth.wed.bin, the fast-loading twin of the XML
+	WED_AutosaveJournal	mJournal;				// earth.wed.journal, what changed since the XML was written
 
 	WED_TexMgr *		mTexMgr;
 	WED_LibraryMgr *	mLibraryMgr;
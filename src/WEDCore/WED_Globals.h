@@ -68,5 +68,7 @@ extern WED_Export_Target gExportTarget;
 
 /* Changes the listing in the gateway Import for GW moderation purposes */
 extern string gCustomSlippyMap;
+/* How much texture memory the slippy map may hold on to, in MB */
+extern int gSlippyCacheMB;
 
 #endif
@@ -36,6 +36,7 @@
 #include "WED_PackageMgr.h"
 #include "CompGeomDefs2.h"
 #include "MathUtils.h"
+#include "PlatformUtils.h"
 
 #if IBM
 #define DIR_CHAR '\\'
@@ -95,6 +96,14 @@ static void process_texture_path(const string& path_of_obj, string& path_of_tex)
 
 WED_ResourceMgr::WED_ResourceMgr(WED_LibraryMgr * in_library) : mLibrary(in_library)
 {
+	// Library-heavy sceneries load thousands of objects - keep a parsed binary copy of each one around between runs.
+	mObjCacheDir = GetCacheFolder();
+	if(!mObjCacheDir.empty())
+	{
+		mObjCacheDir += DIR_STR "wed_obj_cache";
+		if(FILE_make_dir_exist(mObjCacheDir.c_str()))
+			mObjCacheDir.clear();
+	}
 }
 
 WED_ResourceMgr::~WED_ResourceMgr()
@@ -104,6 +113,7 @@ WED_ResourceMgr::~WED_ResourceMgr()
 
 void	WED_ResourceMgr::Purge(void)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	for(auto& i : mObj)
 		for(auto j : i.second)
 			delete j;
@@ -130,7 +140,7 @@ bool	WED_ResourceMgr::GetSimilar(const string& r, vector<pair<string, int> >& vp
 XObj8 * WED_ResourceMgr::LoadObj(const string& abspath)
 {
 	XObj8 * new_obj = new XObj8;
-	if(!XObj8Read(abspath.c_str(),*new_obj))
+	if(!XObj8ReadCached(abspath.c_str(),*new_obj,mObjCacheDir.c_str()))
 	{
 		XObj obj7;
 		if(XObjRead(abspath.c_str(),obj7))
@@ -175,6 +185,7 @@ XObj8 * WED_ResourceMgr::LoadObj(const string& abspath)
 
 bool	WED_ResourceMgr::GetObjRelative(const string& obj_path, const string& parent_path, XObj8 const *& obj)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 /* This is ised to resolve objects referenced inside other non-obj assets like .agp, .fac or .str
    These can be either vpaths or paths relative to the art assets location.
    If it a vpath - its got to be known to the library manager.
@@ -216,6 +227,7 @@ bool	WED_ResourceMgr::GetObjRelative(const string& obj_path, const string& paren
 
 bool	WED_ResourceMgr::GetObj(const string& vpath, XObj8 const *& obj, int variant)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	if(toupper(vpath[vpath.size()-3]) != 'O') return false;   // save time by not trying to load .agp's
 
 //printf("GetObj %s' V=%d\n", path.c_str(), variant);
@@ -258,6 +270,7 @@ bool	WED_ResourceMgr::GetObj(const string& vpath, XObj8 const *& obj, int varian
 
 bool 	WED_ResourceMgr::SetPolUV(const string& path, Bbox2 box)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mPol.find(path);
 	if(i != mPol.end())
 	{
@@ -270,6 +283,7 @@ bool 	WED_ResourceMgr::SetPolUV(const string& path, Bbox2 box)
 
 bool	WED_ResourceMgr::GetLin(const string& path, lin_info_t const *& info)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mLin.find(path);
 	if(i != mLin.end())
 	{
@@ -397,6 +411,7 @@ bool	WED_ResourceMgr::GetLin(const string& path, lin_info_t const *& info)
 
 bool	WED_ResourceMgr::GetStr(const string& path, str_info_t const *& info)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mStr.find(path);
 	if(i != mStr.end())
 	{
@@ -454,6 +469,7 @@ bool	WED_ResourceMgr::GetStr(const string& path, str_info_t const *& info)
 
 bool	WED_ResourceMgr::GetPol(const string& path, pol_info_t const*& info)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mPol.find(path);
 	if(i != mPol.end())
 	{
@@ -585,6 +601,7 @@ void	WED_ResourceMgr::ReceiveMessage(
 
 bool	WED_ResourceMgr::GetFac(const string& vpath, fac_info_t const *& info, int variant)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mFac.find(vpath);
 	int first_needed = 0;
 	if(i != mFac.end())
@@ -1117,6 +1134,7 @@ struct tree_t {
 
 bool	WED_ResourceMgr::GetFor(const string& path, XObj8 const *& obj)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mFor.find(path);
 	if(i != mFor.end())
 	{
@@ -1427,6 +1445,7 @@ void WED_ResourceMgr::setup_tile(agp_t::tile_t * agp, int rotation, const string
 
 bool	WED_ResourceMgr::GetAGP(const string& path, agp_t const *& info)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mAGP.find(path);
 	if(i != mAGP.end())
 	{
@@ -1710,6 +1729,7 @@ bool	WED_ResourceMgr::GetAGP(const string& path, agp_t const *& info)
 #if ROAD_EDITING
 bool	WED_ResourceMgr::GetRoad(const string& path, const road_info_t *& out_info)
 {
+	lock_guard<recursive_mutex> lock(mLock);
 	auto i = mRoad.find(path);
 	if(i != mRoad.end())
 	{
@@ -50,6 +50,7 @@
 #include "XObjDefs.h"
 #include "CompGeomDefs2.h"
 #include <list>
+#include <mutex>
 
 class	WED_LibraryMgr;
 
@@ -248,6 +249,8 @@ private:
 	unordered_map<string,road_info_t>		mRoad;
 #endif
 	WED_LibraryMgr *				mLibrary;
+	string							mObjCacheDir;		// binary copies of parsed .obj files, empty if no cache
+	recursive_mutex					mLock;				// validation looks up resources from several threads
 };
 
 #endif /* WED_ResourceMgr_H */
@@ -23,27 +23,24 @@
 
 #include "WED_UndoLayer.h"
 #include "WED_Persistent.h"
-#include "WED_Buffer.h"
+#include "WED_UndoStore.h"
 #include "WED_Archive.h"
 #include "WED_Messages.h"
 #include "AssertUtils.h"
-#include "WED_FastBuffer.h"
 // NOTE: we could store no turd for created objs
 
-WED_UndoLayer::WED_UndoLayer(WED_Archive * inArchive, const string& inName, const char * inFile, int inLine) :
-	mArchive(inArchive), mName(inName), mChangeMask(0), mFile(inFile), mLine(inLine)
+WED_UndoLayer::WED_UndoLayer(WED_Archive * inArchive, WED_UndoStore * inStore, const string& inName, const char * inFile, int inLine) :
+	mArchive(inArchive), mName(inName), mFile(inFile), mLine(inLine), mChangeMask(0), mStore(inStore)
 {
-	mStorage = new WED_FastBufferGroup;
 }
 
 WED_UndoLayer::~WED_UndoLayer(void)
 {
-//	for(ObjInfoMap::iterator i = mObjects.begin(); i != mObjects.end(); ++i)
-//	{
-//		if (i->second.buffer)
-//			delete i->second.buffer;
-//	}
-	delete mStorage;
+	for(ObjInfoMap::iterator i = mObjects.begin(); i != mObjects.end(); ++i)
+	{
+		if (i->second.snapshot)
+			mStore->Release(i->second.snapshot);
+	}
 }
 
 void 	WED_UndoLayer::ObjectCreated(WED_Persistent * inObject)
@@ -66,7 +63,7 @@ void 	WED_UndoLayer::ObjectCreated(WED_Persistent * inObject)
 		info.the_class = inObject->GetClass();
 		info.op = op_Created;
 		info.id = inObject->GetID();
-		info.buffer = NULL;
+		info.snapshot = NULL;
 		mObjects.insert(ObjInfoMap::value_type(inObject->GetID(), info));
 	}
 }
@@ -90,10 +87,7 @@ void	WED_UndoLayer::ObjectChanged(WED_Persistent * inObject, int change_kind)
 		info.the_class = inObject->GetClass();
 		info.op = op_Changed;
 		info.id = inObject->GetID();
-		info.buffer = mStorage->MakeNewBuffer();
-//		info.buffer = new WED_Buffer;
-		inObject->WriteTo(info.buffer);
-		info.buffer->WriteInt(inObject->GetDirty());
+		info.snapshot = mStore->Capture(inObject);
 		mObjects.insert(ObjInfoMap::value_type(inObject->GetID(), info));
 	}
 	mArchive->BroadcastMessage(msg_ArchiveChangedEphemerally, GetChangeMask());
@@ -117,6 +111,7 @@ void	WED_UndoLayer::ObjectDestroyed(WED_Persistent * inObject)
 			// generally creating and then nuking a huge number of objects
 			// is a rare use pattern....the compression and speed the consolidated
 			// buffer gives us is a lot more important.
+			DebugAssert(iter->second.snapshot == NULL);
 			mObjects.erase(iter);
 		} else {
 			// Note that we don't need to save the data - the original
@@ -129,10 +124,7 @@ void	WED_UndoLayer::ObjectDestroyed(WED_Persistent * inObject)
 		info.the_class = inObject->GetClass();
 		info.op = op_Destroyed;
 		info.id = inObject->GetID();
-		info.buffer = mStorage->MakeNewBuffer();
-//		info.buffer = new WED_Buffer;
-		inObject->WriteTo(info.buffer);
-		info.buffer->WriteInt(inObject->GetDirty());
+		info.snapshot = mStore->Capture(inObject);
 		mObjects.insert(ObjInfoMap::value_type(inObject->GetID(), info));
 	}
 
@@ -141,37 +133,32 @@ void	WED_UndoLayer::ObjectDestroyed(WED_Persistent * inObject)
 void	WED_UndoLayer::Execute(void)
 {
 	vector<WED_Persistent *>	needs_post_call;
-	int d;
 	for (ObjInfoMap::iterator i = mObjects.begin(); i != mObjects.end(); ++i)
 	{
 		WED_Persistent * obj;
 		switch(i->second.op) {
 		case op_Created:
 			obj = mArchive->Fetch(i->first);
-			DebugAssert(i->second.buffer == NULL);
+			DebugAssert(i->second.snapshot == NULL);
 			Assert(obj != NULL);
 			obj->Delete();
 			break;
 		case op_Changed:
 			obj = mArchive->Fetch(i->first);
 			Assert(obj != NULL);
-			DebugAssert(i->second.buffer != NULL);
-			i->second.buffer->ResetRead();
+			DebugAssert(i->second.snapshot != NULL);
 			obj->StateChanged();
-			if(obj->ReadFrom(i->second.buffer))
+			if(mStore->Restore(i->second.snapshot, obj))
 				needs_post_call.push_back(obj);
-			i->second.buffer->ReadInt(d);
-			obj->SetDirty(d);
+			obj->SetDirty(1);			// the file may have been saved since the snapshot was taken, see WED_Archive.h
 			break;
 		case op_Destroyed:
 			obj = WED_Persistent::CreateByClass(i->second.the_class, mArchive, i->first);
 			DebugAssert(obj != NULL);
-			DebugAssert(i->second.buffer != NULL);
-			i->second.buffer->ResetRead();
-			if(obj->ReadFrom(i->second.buffer))
+			DebugAssert(i->second.snapshot != NULL);
+			if(mStore->Restore(i->second.snapshot, obj))
 				needs_post_call.push_back(obj);
-			i->second.buffer->ReadInt(d);
-			obj->SetDirty(d);
+			obj->SetDirty(1);
 			break;
 		}
 	}
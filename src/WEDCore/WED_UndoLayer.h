@@ -25,10 +25,9 @@
 #define WED_UNDOLAYER_H
 
 class	WED_Archive;
-class	WED_Buffer;
-class	WED_FastBuffer;
-class	WED_FastBufferGroup;
 class	WED_Persistent;
+class	WED_UndoStore;
+struct	WED_UndoSnapshot;
 
 #define 	UNDO_DISCARD	((WED_UndoLayer *) -1)
 
@@ -36,7 +35,7 @@ class	WED_Persistent;
 class	WED_UndoLayer {
 public:
 
-				WED_UndoLayer(WED_Archive * inArchive, const string& inName, const char * file, int line);
+				WED_UndoLayer(WED_Archive * inArchive, WED_UndoStore * inStore, const string& inName, const char * file, int line);
 				~WED_UndoLayer(void);
 
 		void 	ObjectCreated(WED_Persistent * inObject);
@@ -64,7 +63,7 @@ private:
 		LayerOp				op;
 		int					id;
 		const char *		the_class;
-		WED_FastBuffer *	buffer;
+		WED_UndoSnapshot *	snapshot;
 	};
 
 	typedef hash_map<int, ObjInfo>		ObjInfoMap;
@@ -75,7 +74,7 @@ private:
 	const char *			mFile;
 	int						mLine;
 	int						mChangeMask;
-	WED_FastBufferGroup *	mStorage;
+	WED_UndoStore *			mStore;
 
 	// Things we do not allow
 	WED_UndoLayer();
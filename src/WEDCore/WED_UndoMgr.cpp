@@ -34,9 +34,11 @@
 // The first op UNDONE is redo.front()
 
 #define WARN_IF_LESS_LEVEL	10
-#define MAX_UNDO_LEVELS 100   // now that WED is 64 bits - there is a LOT of virtual memory to keep this stuff around ...
+#define MAX_UNDO_LEVELS 250   // now that WED is 64 bits - there is a LOT of virtual memory to keep this stuff around ...
                               // tested a large scenery (900 apts on US east coast, 1.2 Million items, 1 GB memory usage) and moved 
 										// the whole thing 10x - that is barely 200MB of undo buffer. No need to keep track of its size for now.
+										// Since snapshots are deltas against the previous one (WED_UndoStore.h), moving it again and again
+										// costs a fraction of that - so keep more levels.
 
 WED_UndoMgr::WED_UndoMgr(WED_Archive * inArchive, WED_UndoFatalErrorHandler * panic_handler) : mCommand(NULL), mArchive(inArchive), mPanicHandler(panic_handler)
 {
@@ -87,7 +89,7 @@ void	WED_UndoMgr::__StartCommand(const string& inName, const char * file, int li
 		}
 		AssertPrintf("Command %s (%s:%d) started while command %s (%s:%d) still active.",inName.c_str(), trim_file(file), line, mCommand->GetName().c_str(), trim_file(mCommand->GetFile()), mCommand->GetLine());
 	}
-	mCommand = new WED_UndoLayer(mArchive, inName, file, line);
+	mCommand = new WED_UndoLayer(mArchive, &mStore, inName, file, line);
 	mArchive->SetUndo(mCommand);
 }
 
@@ -145,7 +147,7 @@ void	WED_UndoMgr::Undo(void)
 {
 	DebugAssert(!mUndo.empty());
 	WED_UndoLayer * undo = mUndo.back();
-	WED_UndoLayer * redo = new WED_UndoLayer(mArchive, undo->GetName(), undo->GetFile(), undo->GetLine());
+	WED_UndoLayer * redo = new WED_UndoLayer(mArchive, &mStore, undo->GetName(), undo->GetFile(), undo->GetLine());
 	mArchive->SetUndo(redo);
 	int change_mask = undo->GetChangeMask();
 	undo->Execute();
@@ -162,7 +164,7 @@ void	WED_UndoMgr::Redo(void)
 {
 	DebugAssert(!mRedo.empty());
 	WED_UndoLayer * redo = mRedo.front();
-	WED_UndoLayer * undo = new WED_UndoLayer(mArchive, redo->GetName(), redo->GetFile(), redo->GetLine());
+	WED_UndoLayer * undo = new WED_UndoLayer(mArchive, &mStore, redo->GetName(), redo->GetFile(), redo->GetLine());
 	mArchive->SetUndo(undo);
 	int change_mask = redo->GetChangeMask();
 	redo->Execute();
@@ -25,6 +25,7 @@
 #define WED_UNDOMGR_H
 
 #include "GUI_MemoryHog.h"
+#include "WED_UndoStore.h"
 
 #include <list>
 using std::list;
@@ -77,6 +78,7 @@ private:
 	LayerList 		mUndo;
 	LayerList		mRedo;
 
+	WED_UndoStore				mStore;			// snapshots for all of our layers
 	WED_UndoLayer *				mCommand;
 	WED_Archive *				mArchive;
 	WED_UndoFatalErrorHandler *	mPanicHandler;
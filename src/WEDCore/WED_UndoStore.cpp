@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2026, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "WED_UndoStore.h"
+#include "WED_Persistent.h"
+#include "AssertUtils.h"
+#include "IODefs.h"
+
+#define	UNDO_SLAB_SIZE			(256 * 1024)
+#define	UNDO_BIG_SNAPSHOT		(UNDO_SLAB_SIZE / 4)	// snapshots bigger than this get a slab of their own
+#define	UNDO_MAX_FREE_SLABS		8
+#define	UNDO_MAX_DELTA_DEPTH	8
+
+struct	WED_UndoStore::slab_t {
+	slab_t *	next;			// free list link
+	int			capacity;		// bytes after the header
+	int			used;
+	int			live;			// snapshots still in here
+};
+
+struct	WED_UndoSnapshot {
+	void *				slab;
+	WED_UndoSnapshot *	base;			// NULL if the bytes are the whole object
+	int					id;
+	int					refs;
+	int					depth;			// deltas between us and a full snapshot
+	int					prefix;			// bytes taken from the front and back of base
+	int					suffix;
+	int					len;			// bytes stored right after this header
+
+	const char *		bytes(void) const { return (const char *) (this + 1); }
+};
+
+class	undo_writer : public IOWriter {
+public:
+					undo_writer(string& d) : data(d) { }
+
+	virtual	void	WriteShort(short v)		{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteInt(int v)			{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteFloat(float v)		{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteDouble(double v)	{ data.append((const char *) &v, sizeof(v)); }
+	virtual	void	WriteBulk(const char * inBuf, int inLength, bool inZip) { data.append(inBuf, inLength); }
+
+	string&			data;
+};
+
+class	undo_reader : public IOReader {
+public:
+					undo_reader(const string& d) : p(d.data()), end(d.data() + d.size()) { }
+
+	virtual	void	ReadShort(short& v)		{ get(&v, sizeof(v)); }
+	virtual	void	ReadInt(int& v)			{ get(&v, sizeof(v)); }
+	virtual	void	ReadFloat(float& v)		{ get(&v, sizeof(v)); }
+	virtual	void	ReadDouble(double& v)	{ get(&v, sizeof(v)); }
+	virtual	void	ReadBulk(char * inBuf, int inLength, bool inZip) { get(inBuf, inLength); }
+
+private:
+			void	get(void * dst, int len)
+			{
+				DebugAssert(end - p >= len);
+				memcpy(dst, p, len);
+				p += len;
+			}
+
+	const char *	p;
+	const char *	end;
+};
+
+WED_UndoStore::WED_UndoStore() : mCurrent(NULL), mFree(NULL), mFreeCount(0)
+{
+}
+
+WED_UndoStore::~WED_UndoStore()
+{
+	DebugAssert(mLatest.empty());			// all layers must be gone first
+	DebugAssert(mCurrent == NULL || mCurrent->live == 0);
+	delete [] (char *) mCurrent;
+	while(mFree)
+	{
+		slab_t * s = mFree;
+		mFree = mFree->next;
+		delete [] (char *) s;
+	}
+}
+
+WED_UndoSnapshot *	WED_UndoStore::Capture(WED_Persistent * obj)
+{
+	mScratch.clear();
+	undo_writer w(mScratch);
+	obj->WriteTo(&w);
+
+	int id = obj->GetID();
+	int size = mScratch.size();
+	int prefix = 0, suffix = 0;
+	WED_UndoSnapshot * base = NULL;
+
+	hash_map<int,WED_UndoSnapshot*>::iterator l = mLatest.find(id);
+	if(l != mLatest.end() && l->second->depth < UNDO_MAX_DELTA_DEPTH)
+	{
+		// A full base is compared in place, only a delta base has to be decoded first.
+		const char * b = l->second->bytes();
+		int bn = l->second->len;
+		if(l->second->base)
+		{
+			Decode(l->second, mBase);
+			b = mBase.data();
+			bn = mBase.size();
+		}
+		typedef reverse_iterator<const char *> rev;
+		const char * s = mScratch.data();
+		int n = min(size, bn);
+		prefix = mismatch(s, s + n, b).first - s;
+		suffix = mismatch(rev(s + size), rev(s + size) + (n - prefix), rev(b + bn)).first - rev(s + size);
+		// Only worth it if we share at least half - otherwise we'd just be pinning the base for a few bytes.
+		if(2 * (prefix + suffix) >= size)
+			base = l->second;
+	}
+	if(base == NULL)
+		prefix = suffix = 0;
+
+	int stored = size - prefix - suffix;
+	slab_t * slab;
+	WED_UndoSnapshot * snap = (WED_UndoSnapshot *) Allocate(sizeof(WED_UndoSnapshot) + stored, slab);
+	snap->slab = slab;
+	snap->base = base;
+	snap->id = id;
+	snap->refs = 1;
+	snap->depth = base ? base->depth + 1 : 0;
+	snap->prefix = prefix;
+	snap->suffix = suffix;
+	snap->len = stored;
+	memcpy(snap + 1, mScratch.data() + prefix, stored);
+
+	if(base)
+		++base->refs;
+	mLatest[id] = snap;
+	return snap;
+}
+
+bool	WED_UndoStore::Restore(WED_UndoSnapshot * snap, WED_Persistent * obj)
+{
+	Decode(snap, mRead);
+	undo_reader r(mRead);
+	return obj->ReadFrom(&r);
+}
+
+void	WED_UndoStore::Release(WED_UndoSnapshot * snap)
+{
+	while(snap && --snap->refs == 0)
+	{
+		WED_UndoSnapshot * base = snap->base;
+		hash_map<int,WED_UndoSnapshot*>::iterator l = mLatest.find(snap->id);
+		if(l != mLatest.end() && l->second == snap)
+			mLatest.erase(l);
+		Free((slab_t *) snap->slab);
+		snap = base;
+	}
+}
+
+// Rebuilds the object's bytes: start at the full snapshot at the bottom of the chain and apply the deltas on the way up.
+void	WED_UndoStore::Decode(WED_UndoSnapshot * snap, string& out)
+{
+	WED_UndoSnapshot * chain[UNDO_MAX_DELTA_DEPTH + 1];
+	int n = 0;
+	for(WED_UndoSnapshot * s = snap; s; s = s->base)
+	{
+		DebugAssert(n <= UNDO_MAX_DELTA_DEPTH);
+		chain[n++] = s;
+	}
+	out.assign(chain[n-1]->bytes(), chain[n-1]->len);
+	for(int i = n - 2; i >= 0; --i)
+		out.replace(chain[i]->prefix, out.size() - chain[i]->prefix - chain[i]->suffix, chain[i]->bytes(), chain[i]->len);
+}
+
+void *	WED_UndoStore::Allocate(int len, slab_t *& out_slab)
+{
+	len = (len + 7) & ~7;					// keeps every snapshot header aligned
+
+	if(len > UNDO_BIG_SNAPSHOT)
+	{
+		out_slab = (slab_t *) new char[sizeof(slab_t) + len];
+		out_slab->next = NULL;
+		out_slab->capacity = len;
+		out_slab->used = len;
+		out_slab->live = 1;
+		return out_slab + 1;
+	}
+
+	if(mCurrent == NULL || mCurrent->capacity - mCurrent->used < len)
+	{
+		// The old current slab is freed by the last release of a snapshot in it - unless that already happened.
+		if(mCurrent && mCurrent->live == 0)
+		{
+			slab_t * old = mCurrent;
+			mCurrent = NULL;
+			Recycle(old);
+		}
+		if(mFree)
+		{
+			mCurrent = mFree;
+			mFree = mFree->next;
+			--mFreeCount;
+		}
+		else
+		{
+			mCurrent = (slab_t *) new char[sizeof(slab_t) + UNDO_SLAB_SIZE];
+			mCurrent->capacity = UNDO_SLAB_SIZE;
+		}
+		mCurrent->next = NULL;
+		mCurrent->used = 0;
+		mCurrent->live = 0;
+	}
+
+	out_slab = mCurrent;
+	void * p = (char *) (mCurrent + 1) + mCurrent->used;
+	mCurrent->used += len;
+	++mCurrent->live;
+	return p;
+}
+
+void	WED_UndoStore::Free(slab_t * slab)
+{
+	DebugAssert(slab->live > 0);
+	if(--slab->live > 0)
+		return;
+	if(slab == mCurrent)
+		slab->used = 0;
+	else
+		Recycle(slab);
+}
+
+void	WED_UndoStore::Recycle(slab_t * slab)
+{
+	if(slab->capacity == UNDO_SLAB_SIZE && mFreeCount < UNDO_MAX_FREE_SLABS)
+	{
+		slab->next = mFree;
+		mFree = slab;
+		++mFreeCount;
+	}
+	else
+		delete [] (char *) slab;
+}
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2026, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#ifndef WED_UNDOSTORE_H
+#define WED_UNDOSTORE_H
+
+/*
+
+	WED_UndoStore - THEORY OF OPERATION
+
+	The undo store holds the "before" images that undo layers take of the objects a command touches - one store per
+	undo manager, shared by all of its layers.  Two things make it cheaper than a set of buffers per layer:
+
+	- Snapshots are carved out of big slabs.  A slab goes back on a free list once the last snapshot in it is released, so
+	  a long session recycles a few slabs instead of allocating and freeing small blocks for every command.
+
+	- Most commands change an object only a little - drag a vertex and only its location moves.  So a snapshot is kept as a
+	  delta against the last snapshot of the same object id: the bytes it has in common with that one at the front and at
+	  the back are shared, and only the part in between is stored.  Every UNDO_MAX_DELTA_DEPTH-th snapshot of an object is
+	  stored in full, so reading one back never decodes more than that many deltas.
+
+	Snapshots are reference counted - a layer holds its snapshots and a delta holds its base - so layers can go in any
+	order (trimming the oldest level, undo, purging redo) and a base just outlives its layer while newer deltas need it.
+
+*/
+
+class	WED_Persistent;
+struct	WED_UndoSnapshot;
+
+class	WED_UndoStore {
+public:
+
+						WED_UndoStore();
+						~WED_UndoStore();
+
+	// Stream the object's current state into the store.  The snapshot comes back with one reference for the caller.
+	WED_UndoSnapshot *	Capture(WED_Persistent * obj);
+	// Stream a snapshot back into the object - returns what the object's ReadFrom returns.
+	bool				Restore(WED_UndoSnapshot * snap, WED_Persistent * obj);
+	void				Release(WED_UndoSnapshot * snap);
+
+private:
+
+	struct	slab_t;
+
+	void *				Allocate(int len, slab_t *& out_slab);
+	void				Free(slab_t * slab);
+	void				Recycle(slab_t * slab);
+	void				Decode(WED_UndoSnapshot * snap, string& out);
+
+	slab_t *						mCurrent;			// the slab we carve from
+	slab_t *						mFree;				// empty slabs for reuse
+	int								mFreeCount;
+	hash_map<int,WED_UndoSnapshot*>	mLatest;			// delta base for each id - not a reference, cleared on release
+	string							mScratch;
+	string							mBase;
+	string							mRead;
+
+	WED_UndoStore(const WED_UndoStore&);
+	WED_UndoStore& operator=(const WED_UndoStore&);
+
+};
+
+#endif /* WED_UNDOSTORE_H */
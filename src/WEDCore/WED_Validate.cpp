@@ -78,6 +78,7 @@
 
 #include "BitmapUtils.h"
 #include "GISUtils.h"
+#include "RTree2.h"
 #include "FileUtils.h"
 #include "MemFileUtils.h"
 #include "PlatformUtils.h"
@@ -87,6 +88,7 @@
 #include "WED_Document.h"
 #include "WED_FileCache.h"
 #include "WED_Url.h"
+#include "WorkerPool.h"
 #include "GUI_Resources.h"
 #include "XESConstants.h"
 
@@ -1876,7 +1878,8 @@ static void ValidateOneTruckParking(WED_TruckParkingLocation* truck_parking,vali
 	}
 }
 
-MFMemFile * ReadCIFP()
+// Failing to get the CIFP data is reported as a validation warning on "who", not as an alert - this also runs headless.
+MFMemFile * ReadCIFP(validation_error_vector& msgs, WED_Thing * who)
 {
 	WED_file_cache_request  mCacheRequest;
 	mCacheRequest.in_domain = cache_domain_metadata_csv;    // cache expiration time = 1 day
@@ -1903,7 +1906,7 @@ MFMemFile * ReadCIFP()
 		stringstream ss;
 		ss << "Error downloading list of CIFP data compliant runway names and coordinates from scenery gateway.\n" << res.out_error_human;
 		ss << "\nSkipping this part of validation.";
-		DoUserAlert(ss.str().c_str());
+		msgs.push_back(validation_error_t(ss.str(), warn_gateway_cifp_data_unavailable, who, nullptr));
 		return nullptr;
 	}
 	else
@@ -2196,8 +2199,22 @@ static void ValidateRoads(const vector<WED_RoadEdge *> roads, validation_error_v
 	}
 
 	// any nodes too close to each other and not connected
-	for(auto x = nodes.begin(); x != nodes.end(); ++x)
+	// Walk the nodes in map order, but only distance-test the later ones that the range tree puts within reach of x
+	vector<pair<WED_Thing *, Point2> > node_list(nodes.begin(), nodes.end());
+	RTree2<int, 8> node_index;
 	{
+		vector<RTree2<int, 8>::item_type> items;
+		items.reserve(node_list.size());
+		for(int n = 0; n < node_list.size(); ++n)
+			items.push_back(RTree2<int, 8>::item_type(Bbox2(node_list[n].second), n));
+		node_index.insert(items.begin(), items.end());
+	}
+	const double pad_lat = 4.0 * MTR_TO_DEG_LAT;		// 3m plus some slack
+	vector<int> near_x;
+
+	for(int xn = 0; xn < node_list.size(); ++xn)
+	{
+		auto x = &node_list[xn];
 		if(x->first->CountViewers() > 1)
 		{
 			set<WED_Thing *> viewers;
@@ -2220,9 +2237,16 @@ static void ValidateRoads(const vector<WED_RoadEdge *> roads, validation_error_v
 				}
 		}
 
-		auto y = x;
-		for(++y; y !=  nodes.end(); ++y)
+		double cos_lat = cos(min(fabs(x->second.y()) + pad_lat, 90.0) * DEG_TO_RAD);
+		double pad_lon = cos_lat > 0.01 ? pad_lat / cos_lat : 360.0;
+		near_x.clear();
+		node_index.query_value(Bbox2(x->second.x() - pad_lon, x->second.y() - pad_lat, x->second.x() + pad_lon, x->second.y() + pad_lat), back_inserter(near_x));
+		sort(near_x.begin(), near_x.end());
+
+		for(auto yn : near_x)
 		{
+			if(yn <= xn) continue;
+			auto y = &node_list[yn];
 			if(LonLatDistMeters(x->second, y->second) < 3.0)
 			{
 				set<WED_Thing *> sx, sy;
@@ -2583,16 +2607,24 @@ static void ValidateOneAirport(WED_Airport* apt, validation_error_vector& msgs,
 	ValidateDSFRecursive(apt, lib_mgr, msgs, apt);
 }
 
-validation_result_t	WED_ValidateApt(WED_Document * resolver, WED_MapPane * pane, WED_Thing * wrl, bool skipErrorDialog, const char * abortMsg)
+// Entities build their bounds and child lists lazily, through mutable caches.  Build every one of them up front, so the
+// parallel validation below only ever reads.
+static void WarmEntityCaches(WED_Thing * who)
 {
-#if DEBUG_VIS_LINES
-	//Clear the previously drawn lines before every validation
-	gMeshPoints.clear();
-	gMeshLines.clear();
-	gMeshPolygons.clear();
-#endif
-	validation_error_vector		msgs;
+	if(IGISEntity * e = dynamic_cast<IGISEntity *>(who))
+	{
+		Bbox2 b;
+		e->HasLayer(gis_UV);
+		e->GetBounds(gis_Geo, b);
+	}
+	int nc = who->CountChildren();
+	for (int n = 0; n < nc; ++n)
+		WarmEntityCaches(who->GetNthChild(n));
+}
 
+validation_result_t	WED_ValidateArchive(WED_Archive * archive, validation_error_vector& msgs, WED_Thing * wrl)
+{
+	IResolver * resolver = archive->GetResolver();
 	if(wrl == NULL) wrl = WED_GetWorld(resolver);
 	WED_LibraryMgr * lib_mgr = 	WED_GetLibraryMgr(resolver);
 	WED_ResourceMgr * res_mgr = WED_GetResourceMgr(resolver);
@@ -2603,13 +2635,21 @@ validation_result_t	WED_ValidateApt(WED_Document * resolver, WED_MapPane * pane,
 	// get data about runways from CIFP data
 	MFMemFile * mf = nullptr;
 	if(gExportTarget == wet_gateway)
-		mf = ReadCIFP();
+		mf = ReadCIFP(msgs, wrl);
 
 #if 0 // DEV
 	auto t0 = std::chrono::high_resolution_clock::now();
 #endif
-	for(auto a : apts)
-		ValidateOneAirport(a, msgs, lib_mgr, res_mgr, mf);
+	WarmEntityCaches(wrl);
+
+	// Each airport only reads its own sub-tree, so they can go side by side.  Every airport collects into its own list
+	// and the lists are appended in airport order, so the result does not depend on scheduling.
+	vector<validation_error_vector> apt_msgs(apts.size());
+	WorkerPool_ParallelFor(apts.size(), [&](int n) {
+		ValidateOneAirport(apts[n], apt_msgs[n], lib_mgr, res_mgr, mf);
+	});
+	for(auto& m : apt_msgs)
+		msgs.insert(msgs.end(), make_move_iterator(m.begin()), make_move_iterator(m.end()));
 
 	vector<WED_RoadEdge*> off_airport_roads;
 
@@ -2656,10 +2696,16 @@ validation_result_t	WED_ValidateApt(WED_Document * resolver, WED_MapPane * pane,
 #endif
 	if (mf) MemFile_Close(mf);
 
-	string logfile(gPackageMgr->ComputePath(lib_mgr->GetLocalPackage(), "validation_report.txt"));
-	FILE * fi = fopen(logfile.c_str(), "w");
+	if(msgs.empty())
+		return validation_clean;
+	for(auto& v : msgs)
+		if(v.err_code <= warnings_start_here)
+			return validation_errors;
+	return validation_warnings_only;
+}
 
-	bool warnings_only = true;
+void	WED_WriteValidationReport(FILE * fi, const validation_error_vector& msgs)
+{
 	for(auto& v : msgs)
 	{
 		const char * warn = "";
@@ -2669,19 +2715,33 @@ validation_result_t	WED_ValidateApt(WED_Document * resolver, WED_MapPane * pane,
 
 		if(v.err_code > warnings_start_here)
 			warn = "(warning only)";
-		else
-			warnings_only = false;
 
-		if (fi)	fprintf(fi, "%s: %s %s\n", aname.c_str(), v.msg.c_str(), warn);
-//		fprintf(stdout, "%s: %s %s\n", aname.c_str(), v.msg.c_str(), warn);
+		fprintf(fi, "%s: %s %s\n", aname.c_str(), v.msg.c_str(), warn);
 	}
-	fclose(fi);
+}
 
-	if(!msgs.empty())
-	{
-		if(!skipErrorDialog) new WED_ValidateDialog(resolver, pane, msgs, abortMsg);
+validation_result_t	WED_ValidateApt(WED_Document * resolver, WED_MapPane * pane, WED_Thing * wrl, bool skipErrorDialog, const char * abortMsg)
+{
+#if DEBUG_VIS_LINES
+	//Clear the previously drawn lines before every validation
+	gMeshPoints.clear();
+	gMeshLines.clear();
+	gMeshPolygons.clear();
+#endif
+	validation_error_vector		msgs;
+	validation_result_t result = WED_ValidateArchive(resolver->GetArchive(), msgs, wrl);
 
-		return warnings_only ? validation_warnings_only : validation_errors;
+	WED_LibraryMgr * lib_mgr = 	WED_GetLibraryMgr(resolver);
+	string logfile(gPackageMgr->ComputePath(lib_mgr->GetLocalPackage(), "validation_report.txt"));
+	FILE * fi = fopen(logfile.c_str(), "w");
+	if(fi)
+	{
+		WED_WriteValidationReport(fi, msgs);
+		fclose(fi);
 	}
-	else return validation_clean;
+
+	if(!msgs.empty() && !skipErrorDialog)
+		new WED_ValidateDialog(resolver, pane, msgs, abortMsg);
+
+	return result;
 }
@@ -28,6 +28,7 @@ class	WED_Thing;
 class	WED_Airport;
 class	WED_MapPane;
 class	WED_Document;
+class	WED_Archive;
 
 //Keep this enum strictly organized by alphabetical order and sub catagory. Make this collection easily grep-able
 enum validate_error_t
@@ -170,6 +171,7 @@ enum validate_error_t
 	warn_atc_flow_visibility_unlikely,
 	warn_atcrwy_marking,
 	warn_facades_curved_only_type2,
+	warn_gateway_cifp_data_unavailable,
 	warn_net_level_mismatch,
 	warn_net_hard_turn,
 	warn_object_custom_elev,
@@ -220,4 +222,11 @@ enum validation_result_t {
 validation_result_t	WED_ValidateApt(WED_Document * resolver, WED_MapPane * pane, WED_Thing * root = NULL,
 	bool skipErrorDialog = false, const char * abortMsg = "Dismiss");	// if root not null, only do this sub-tree
 
+// The validation core without any UI - usable headless on any archive whose resolver provides a library and resource
+// manager. Airports are validated in parallel; msgs comes back in the same order a serial run produces.
+validation_result_t	WED_ValidateArchive(WED_Archive * archive, validation_error_vector& msgs, WED_Thing * root = NULL);
+
+// One line per error, as in validation_report.txt
+void	WED_WriteValidationReport(FILE * fi, const validation_error_vector& msgs);
+
 #endif
@@ -21,6 +21,8 @@
 #include "WED_HierarchyUtils.h"
 #include "CompGeomUtils.h"
 #include "GISUtils.h"
+#include "RTree2.h"
+#include "XESConstants.h"
 #include "WED_PreviewLayer.h"
 
 #include <sstream>
@@ -32,6 +34,76 @@ typedef vector<WED_GISPoint*>      TaxiRouteNodeVec_t;
 typedef vector<RunwayInfo>         RunwayInfoVec_t;
 typedef vector<TaxiRouteInfo>      TaxiRouteInfoVec_t;
 
+// AirportSpatialIndex - range trees over the bounding boxes of an airport's taxi routes, ramp starts and road edges,
+// built once per airport so the proximity checks only run their exact tests on elements that can possibly be close,
+// instead of testing everything against every runway or every other route.
+//
+// Queries return positions in the vectors the index was built from, sorted ascending - a check walking the hits
+// visits the elements in the same order as a loop over the whole vector, so the errors come out the same and in the same order.
+
+class AirportSpatialIndex {
+public:
+	AirportSpatialIndex(const TaxiRouteInfoVec_t& taxiroutes, const vector<WED_RampPosition*>& ramps, const vector<WED_RoadEdge*>& roads);
+
+	void	FindTaxiRoutes(const Bbox2& where, vector<int>& hits) { find(mTaxiRoutes, where, hits); }
+	void	FindRamps     (const Bbox2& where, vector<int>& hits) { find(mRamps, where, hits); }
+	void	FindRoads     (const Bbox2& where, vector<int>& hits) { find(mRoads, where, hits); }
+
+private:
+
+	typedef RTree2<int, 8>	tree_t;
+
+	static void	find(tree_t& tree, const Bbox2& where, vector<int>& hits)
+	{
+		hits.clear();
+		tree.query_value(where, back_inserter(hits));
+		sort(hits.begin(), hits.end());
+	}
+
+	tree_t	mTaxiRoutes;
+	tree_t	mRamps;
+	tree_t	mRoads;
+
+	AirportSpatialIndex(const AirportSpatialIndex&);
+	AirportSpatialIndex& operator=(const AirportSpatialIndex&);
+};
+
+AirportSpatialIndex::AirportSpatialIndex(const TaxiRouteInfoVec_t& taxiroutes, const vector<WED_RampPosition*>& ramps, const vector<WED_RoadEdge*>& roads)
+{
+	vector<tree_t::item_type> items;
+
+	items.reserve(taxiroutes.size());
+	for(int n = 0; n < taxiroutes.size(); ++n)
+		items.push_back(tree_t::item_type(Bbox2(taxiroutes[n].segment_geo), n));
+	mTaxiRoutes.insert(items.begin(), items.end());
+
+	items.clear();
+	for(int n = 0; n < ramps.size(); ++n)
+	{
+		Point2 pt[4];
+		ramps[n]->GetTips(pt);
+		Bbox2 b(pt[0]);
+		for(int i = 1; i < 4; ++i)
+			b += pt[i];
+		items.push_back(tree_t::item_type(b, n));
+	}
+	mRamps.insert(items.begin(), items.end());
+
+	items.clear();
+	for(int n = 0; n < roads.size(); ++n)
+	{
+		Bbox2 b;
+		Bezier2 s;
+		for(int i = 0; i < roads[n]->GetNumSides(); ++i)
+		{
+			roads[n]->GetSide(gis_Geo, i, s);
+			b += Bbox2(s.as_segment());
+		}
+		items.push_back(tree_t::item_type(b, n));
+	}
+	mRoads.insert(items.begin(), items.end());
+}
+
 //Collects 'potentially active' runways.
 // - any runway that is referenced in at least one flow AND there is at least one runway segement taxi route on it
 // - if no flows are defined, all runways are considered active
@@ -748,13 +820,15 @@ static Polygon2 MakeHotZoneHitBox( const RunwayInfo& runway_info, // The relevan
 }
 
 static bool DoHotZoneChecks( const RunwayInfo& runway_info,
-							 const TaxiRouteInfoVec_t& all_taxiroutes,
+							 const TaxiRouteInfoVec_t& all_taxiroutes,		// All the taxiroutes in the airport, only aircraft routes are checked
 							const vector<WED_RampPosition*>& ramps,
+							 AirportSpatialIndex& index,
 							 validation_error_vector& msgs,
 							 WED_Airport* apt)
 {
 	int original_num_errors = msgs.size();
 	set<WED_RampPosition *> ramps_near_rwy;
+	vector<int> hits;
 
 	for (int runway_side = 0; runway_side < 2; ++runway_side)
 	{
@@ -768,8 +842,10 @@ static bool DoHotZoneChecks( const RunwayInfo& runway_info,
 
 			if(hit_box.empty()) continue;
 
-			for (auto r : ramps)
+			index.FindRamps(hit_box.bounds(), hits);
+			for (auto h : hits)
 			{
+				WED_RampPosition * r = ramps[h];
 				if (r->GetType() != atc_Ramp_Misc)
 				{
 					Point2 pt[4];
@@ -788,8 +864,11 @@ static bool DoHotZoneChecks( const RunwayInfo& runway_info,
 				}
 			}
 
-			for(auto& taxiroute_itr : all_taxiroutes)
+			index.FindTaxiRoutes(hit_box.bounds(), hits);
+			for(auto h : hits)
 			{
+				const TaxiRouteInfo& taxiroute_itr = all_taxiroutes[h];
+				if(!taxiroute_itr.is_aircraft_route) continue;
 				// even if its not intersecting the box - it could be completely inside
 				if(hit_box.intersects(taxiroute_itr.segment_geo) || hit_box.inside(taxiroute_itr.segment_geo.p1))
 				{
@@ -826,7 +905,7 @@ static bool DoHotZoneChecks( const RunwayInfo& runway_info,
 // flag all ground traffic routes that cross a runways hitbox
 
 static void AnyTruckRouteNearRunway( const RunwayInfo& runway_info,
-							 const TaxiRouteInfoVec_t& all_routes, const vector<WED_RoadEdge*>& roads,
+							 const TaxiRouteInfoVec_t& all_routes, const vector<WED_RoadEdge*>& roads, AirportSpatialIndex& index,
 							 validation_error_vector& msgs, WED_Airport* apt)
 {
 	Polygon2 runway_hit_box(runway_info.corners_geo);
@@ -838,14 +917,22 @@ static void AnyTruckRouteNearRunway( const RunwayInfo& runway_info,
 	runway_hit_box[2] += len_ext + side_ext;
 	runway_hit_box[3] -= len_ext - side_ext;
 
+	vector<int> hits;
 	set<WED_TaxiRoute*> close_routes;
-	for(auto& route_itr : all_routes)
-		if(runway_hit_box.intersects(route_itr.segment_geo) || runway_hit_box.inside(route_itr.segment_geo.p1))
-			close_routes.insert(route_itr.ptr);
+	index.FindTaxiRoutes(runway_hit_box.bounds(), hits);
+	for(auto h : hits)
+	{
+		const TaxiRouteInfo& route_itr = all_routes[h];
+		if(!route_itr.is_aircraft_route)
+			if(runway_hit_box.intersects(route_itr.segment_geo) || runway_hit_box.inside(route_itr.segment_geo.p1))
+				close_routes.insert(route_itr.ptr);
+	}
 
 	set<WED_RoadEdge*> close_roads;
-	for(auto road_itr : roads)
+	index.FindRoads(runway_hit_box.bounds(), hits);
+	for(auto h : hits)
 	{
+		WED_RoadEdge * road_itr = roads[h];
 		Bezier2 b;
 		Segment2 s;
 		for(int i = road_itr->GetNumSides() -1; i >= 0; --i)
@@ -927,7 +1014,8 @@ static void	AnyPolgonsOnRunway( const RunwayInfo& runway_info,	 const vector<WED
 	}
 }
 
-static void TJunctionCrossingTest(const TaxiRouteInfoVec_t& all_taxiroutes, validation_error_vector& msgs, WED_Airport * apt)
+static void TJunctionCrossingTest(const TaxiRouteInfoVec_t& all_taxiroutes, AirportSpatialIndex& index, const CoordTranslator2& translator,
+									validation_error_vector& msgs, WED_Airport * apt)
 {
 	/*For each edge A
 		for each OTHER edge B
@@ -943,15 +1031,30 @@ static void TJunctionCrossingTest(const TaxiRouteInfoVec_t& all_taxiroutes, vali
 	const double TJUNCTION_THRESHOLD = 1.00;
 	const double ZERO_LENGTH_THRESHOLD = 1.00;
 
+	// Only edges whose boxes come within the threshold of A's box can intersect A or have a node close to it - so pad
+	// A's lat/lon box by the threshold (plus some slack) using the same scale the translator uses to make segment_m.
+	double mtr_to_deg_lat = 1.0 / DEG_TO_MTR_LAT;
+	double mtr_to_deg_lon = mtr_to_deg_lat / cos((translator.mSrcMin.y() + translator.mSrcMax.y()) * 0.5 * DEG_TO_RAD);
+	double pad_lon = (TJUNCTION_THRESHOLD + 1.0) * fabs(mtr_to_deg_lon);
+	double pad_lat = (TJUNCTION_THRESHOLD + 1.0) * mtr_to_deg_lat;
+
+	vector<int> hits;
 	set<WED_TaxiRoute *> crossing_edges, short_edges;
-	for (auto tr_a = all_taxiroutes.cbegin(); tr_a != all_taxiroutes.cend(); ++tr_a)
+	for (int a = 0; a < all_taxiroutes.size(); ++a)
 	{
+		auto tr_a = &all_taxiroutes[a];
 		Segment2 edge_a = tr_a->segment_m;
 		if (Vector2(edge_a.p1, edge_a.p2).squared_length() < ZERO_LENGTH_THRESHOLD * ZERO_LENGTH_THRESHOLD)
 			short_edges.insert(tr_a->ptr);
 
-		for (auto tr_b = tr_a + 1; tr_b != all_taxiroutes.end(); ++tr_b)
+		Bbox2 near_a(tr_a->segment_geo);
+		near_a = Bbox2(near_a.xmin() - pad_lon, near_a.ymin() - pad_lat, near_a.xmax() + pad_lon, near_a.ymax() + pad_lat);
+		index.FindTaxiRoutes(near_a, hits);
+
+		for (auto b : hits)
 		{
+			if (b <= a) continue;
+			auto tr_b = &all_taxiroutes[b];
 			Segment2 edge_b = tr_b->segment_m;
 
 			// Skip if the edges are colocated at one end, i.e. are propper merged or not so propper unmerged nodes
@@ -1111,7 +1214,9 @@ void WED_DoATCRunwayChecks(WED_Airport& apt, validation_error_vector& msgs, cons
 			all_truckroutes.push_back(tr_info);
 	}
 
-	TJunctionCrossingTest(all_taxiroutes_info, msgs, &apt);
+	AirportSpatialIndex index(all_taxiroutes_info, ramps, roads);
+
+	TJunctionCrossingTest(all_taxiroutes_info, index, translator, msgs, &apt);
 	TwyNameCheck(all_taxiroutes_info, msgs, &apt);
 
 	RunwayInfoVec_t all_runways_info;
@@ -1168,7 +1273,7 @@ void WED_DoATCRunwayChecks(WED_Airport& apt, validation_error_vector& msgs, cons
 			}
 	#endif
 			AssignRunwayUse(runway_info_itr, all_use_rules);
-			bool passes_hotzone_checks = DoHotZoneChecks(runway_info_itr, all_aircraftroutes, ramps, msgs, &apt);
+			bool passes_hotzone_checks = DoHotZoneChecks(runway_info_itr, all_taxiroutes_info, ramps, index, msgs, &apt);
 			//Nothing to do here yet until we have more checks after this
 		}
 	}
@@ -1186,7 +1291,7 @@ void WED_DoATCRunwayChecks(WED_Airport& apt, validation_error_vector& msgs, cons
 	if(!all_truckroutes.empty())
 	{
 		for(auto runway_info_itr : all_runways_info)
-			AnyTruckRouteNearRunway(runway_info_itr, all_truckroutes, roads, msgs, &apt);
+			AnyTruckRouteNearRunway(runway_info_itr, all_taxiroutes_info, roads, index, msgs, &apt);
 	}
 
 }
@@ -105,7 +105,8 @@ void	WED_Entity::CacheInval(int flags)
 int	WED_Entity::CacheBuild(int flags) const
 {
 	int needed_flags = flags & ~cache_valid_;
-	cache_valid_ |= needed_flags;
+	if (needed_flags)					// a valid cache is only read - validation reads entities from several threads at once
+		cache_valid_ |= needed_flags;
 	return needed_flags;
 }
 
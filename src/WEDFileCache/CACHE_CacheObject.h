@@ -52,7 +52,7 @@ public:
 	time_t           get_last_time_modified() const;
 	void             set_last_time_modified(time_t mtime);
 
-	void             create_RAII_curl_hndl(const string& url, int buf_reserve_size=0);
+	void             create_RAII_curl_hndl(const string& url, int buf_reserve_size=0, float priority=0.0f, curl_http_done_f done_cb=NULL, void * done_ref=NULL);
 
 	//Returns the current RAII_CurlHandle object or NULL if there is none
 	RAII_CurlHandle* const get_RAII_curl_hndl();
@@ -34,14 +34,16 @@ WED_FileCache gFileCache;
 WED_file_cache_request::WED_file_cache_request()
 	: in_domain(cache_domain_none),
 	  in_folder_prefix(""),
-	  in_url("")
+	  in_url(""),
+	  in_priority(0.0f)
 {
 }
 
-WED_file_cache_request::WED_file_cache_request(CACHE_domain domain, const string & folder_prefix, const string & url)
+WED_file_cache_request::WED_file_cache_request(CACHE_domain domain, const string & folder_prefix, const string & url, float priority)
 	: in_domain(domain),
 	  in_folder_prefix(folder_prefix),
-	  in_url(url)
+	  in_url(url),
+	  in_priority(priority)
 {
 }
 
@@ -157,7 +159,7 @@ void WED_FileCache::init(void)
 
 		for (auto p : paired_files)
 		{
-			CACHE_file_cache.push_back(new CACHE_CacheObject());
+			CACHE_CacheObject * co = new CACHE_CacheObject();
 
 			bool info_read_success = false;
 
@@ -173,21 +175,24 @@ void WED_FileCache::init(void)
 
 				if(json_parse_result == true)
 				{
-					CACHE_file_cache.back()->m_last_time_modified = root["last_time_modified"].asInt();
-					CACHE_file_cache.back()->m_domain = static_cast<CACHE_domain>(root["domain"].asInt());
-					CACHE_file_cache.back()->set_disk_location(files[p.first]);
+					co->m_last_time_modified = root["last_time_modified"].asInt();
+					co->m_domain = static_cast<CACHE_domain>(root["domain"].asInt());
+					co->set_disk_location(files[p.first]);
 
-					time_t age = difftime(now,CACHE_file_cache.back()->m_last_time_modified);
+					time_t age = difftime(now,co->m_last_time_modified);
 
-					if(age < (GetDomainPolicy(CACHE_file_cache.back()->m_domain)).cache_domain_pol_max_seconds_on_disk /* + margin ? */)
+					if(age < (GetDomainPolicy(co->m_domain)).cache_domain_pol_max_seconds_on_disk /* + margin ? */)
 						info_read_success = true;
 				}
 			}
 
-			if(info_read_success == false)
+			if(info_read_success)
 			{
-				delete CACHE_file_cache.back();
-				CACHE_file_cache.pop_back();
+				CACHE_file_cache[files[p.first]] = co;
+			}
+			else
+			{
+				delete co;
 #if KEEP_EXPIRED_CACHE_FILES
 				files_to_delete.push_back(p.first);
 				files_to_delete.push_back(p.second);
@@ -292,12 +297,21 @@ static void interpret_error(curl_http_get_file& mCurl, string& out_error_human,
 	out_error_human = ss.str();
 }
 
+// Runs on the download thread - just count, whoever polls us sees the count move.
+void WED_FileCache::download_done(void * ref)
+{
+	WED_FileCache * me = static_cast<WED_FileCache *>(ref);
+	me->m_completed_count++;
+}
+
 WED_file_cache_response WED_FileCache::start_new_cache_object(WED_file_cache_request req)
 {
-	CACHE_file_cache.push_back(new CACHE_CacheObject());
-	CACHE_CacheObject& co = *CACHE_file_cache.back();
+	CACHE_CacheObject*& slot = CACHE_file_cache[url_to_cache_path(req)];
+	delete slot;
+	slot = new CACHE_CacheObject();
+	CACHE_CacheObject& co = *slot;
 	
-	co.create_RAII_curl_hndl(req.in_url);
+	co.create_RAII_curl_hndl(req.in_url, 0, req.in_priority, download_done, this);
 	
 	return WED_file_cache_response(co.get_RAII_curl_hndl()->get_curl_handle().get_progress(),
 								   "",
@@ -306,9 +320,9 @@ WED_file_cache_response WED_FileCache::start_new_cache_object(WED_file_cache_req
 								   cache_status_downloading);
 }
 
-void WED_FileCache::remove_cache_object(vector<CACHE_CacheObject* >::iterator itr)
+void WED_FileCache::remove_cache_object(cache_index::iterator itr)
 {
-	delete *itr;
+	delete itr->second;
 	CACHE_file_cache.erase(itr);
 }
 
@@ -343,18 +357,7 @@ WED_file_cache_response WED_FileCache::request_file(const WED_file_cache_request
 	---------------------------------------------------------------------------
 	*/
 	
-	vector<CACHE_CacheObject* >::iterator itr = CACHE_file_cache.begin();
-	for ( ; itr != CACHE_file_cache.end(); ++itr)
-	{
-		if((**itr).get_disk_location() == url_to_cache_path(req))
-		{
-			break;
-		}
-		else if ((**itr).get_last_url() == req.in_url)
-		{
-			break;
-		}
-	}
+	cache_index::iterator itr = CACHE_file_cache.find(url_to_cache_path(req));
 
 	if(itr == CACHE_file_cache.end()) //1. Not in CACHE_file_cache?
 	{
@@ -362,10 +365,10 @@ WED_file_cache_response WED_FileCache::request_file(const WED_file_cache_request
 		return start_new_cache_object(req);
 	}
 	
-	CACHE_CacheObject & co = **itr;
+	CACHE_CacheObject & co = *itr->second;
 
 	//2. In CACHE_file_cache with active cURL_handle?
-	if((**itr).get_RAII_curl_hndl() != NULL)
+	if(co.get_RAII_curl_hndl() != NULL)
 	{
 		curl_http_get_file & hndl = co.get_RAII_curl_hndl()->get_curl_handle();
 		
@@ -402,10 +405,8 @@ WED_file_cache_response WED_FileCache::request_file(const WED_file_cache_request
 				if(f() != NULL)
 				{
 					const vector<char>& buf = co.get_RAII_curl_hndl()->get_dest_buffer();
-					for(vector<char>::const_iterator itr = buf.begin(); itr != buf.end(); ++itr)
-					{
-						fprintf(f(),"%c",*itr);
-					}
+					if(!buf.empty())
+						fwrite(&buf[0], 1, buf.size(), f());
 
 					good_file_save = ferror(f()) == 0 ? true : false;
 				}
@@ -465,6 +466,8 @@ WED_file_cache_response WED_FileCache::request_file(const WED_file_cache_request
 		}
 		else
 		{
+			hndl.set_priority(req.in_priority);
+
 			// Tyler says: This assert intermittently fails for me. It appears to do so because the hndl continues progressing asynchronously,
 			// so between the time we call co.get_response_from_object_state() and the time we call hndl.get_progress(), the progress has increased by, say, 1%.
 			// Thus, I'm turning it off, but leaving it commented out for the sake of posterity.
@@ -480,12 +483,12 @@ WED_file_cache_response WED_FileCache::request_file(const WED_file_cache_request
 		{
 			return WED_file_cache_response(-1, "Cache cooling after failed network attempt, please wait: " + to_string(seconds_left) + " seconds...", cache_error_type_none, "", cache_status_cooling);
 		}
-		else if(FILE_exists((*itr)->get_disk_location().c_str()) == true) //Check if file was deleted between requests
+		else if(FILE_exists(co.get_disk_location().c_str()) == true) //Check if file was deleted between requests
 		{
 			if(co.needs_refresh(pol) == false)
 			{
-				DebugAssert((*itr)->get_disk_location() != "");
-				return WED_file_cache_response(-1, "", cache_error_type_none, (*itr)->get_disk_location(), cache_status_available);
+				DebugAssert(co.get_disk_location() != "");
+				return WED_file_cache_response(-1, "", cache_error_type_none, co.get_disk_location(), cache_status_available);
 			}
 			else
 			{
@@ -519,11 +522,11 @@ vector<string> WED_FileCache::get_files_available(CACHE_domain domain, string fo
 
 WED_FileCache::~WED_FileCache()
 {
-	for(vector<CACHE_CacheObject* >::iterator co = CACHE_file_cache.begin();
+	for(cache_index::iterator co = CACHE_file_cache.begin();
 		co != CACHE_file_cache.end();
 		++co)
 	{
-		delete *co;
+		delete co->second;
 	}
 	CACHE_file_cache.clear();
 }
@@ -25,6 +25,7 @@
 #define WED_FILECACHE_H
 
 #include "CACHE_DomainPolicy.h"
+#include <atomic>
 
 class CACHE_CacheObject;
 
@@ -39,6 +40,9 @@ class CACHE_CacheObject;
 		* Clients can use the error information to decide whether or not to try again
 	- Cached files that are too old are re-downloaded
 	- A cache domain policy determines maximum age and minimum cool down periods
+	- Downloads run concurrently on curl_http's I/O thread; requests carry a priority for downloads that haven't started
+	  yet, updated on every poll, so a client can re-rank what it still wants as the user moves around
+	- get_completed_count goes up whenever a download finishes, so a client can skip its polls until something happened
 */
 
 enum CACHE_status
@@ -62,11 +66,12 @@ enum CACHE_error_type
 struct WED_file_cache_request
 {
 	WED_file_cache_request();
-	WED_file_cache_request(CACHE_domain domain, const string& folder_prefix, const string& url);
+	WED_file_cache_request(CACHE_domain domain, const string& folder_prefix, const string& url, float priority = 0.0f);
 
 	CACHE_domain in_domain;   // Domain policy for the file, stores information on how files should be downloaded and kept
 	string in_folder_prefix;  // A folder prefix to place this cached file in, no leading or trailing slash
 	string in_url;            // The URL to request from, cached inside CACHE_CacheObject
+	float in_priority;        // Lowest goes first among downloads waiting to start
 };
 
 ostream& operator << (ostream& os, const WED_file_cache_request& rhs);
@@ -88,24 +93,29 @@ struct WED_file_cache_response
 class WED_FileCache
 {
 	public:
-							WED_FileCache(void) {};
+							WED_FileCache(void) : m_completed_count(0) {};
 							~WED_FileCache(void); // WED_file_cache_shutdown()
 		void				init(void);           // WED_file_cache_init()
 
 		WED_file_cache_response	request_file(const WED_file_cache_request& req);
 		string			file_in_cache(const WED_file_cache_request& req);
 		string			url_to_cache_path(const WED_file_cache_request& req);
+		int				get_completed_count(void) const { return m_completed_count; }
 
 	private:
 
 		vector<string>	get_files_available(CACHE_domain domain, string folder_prefix);
 		WED_file_cache_response Request_file(const WED_file_cache_request& req);
 		WED_file_cache_response start_new_cache_object(WED_file_cache_request req);
-		void 				remove_cache_object(vector<CACHE_CacheObject* >::iterator itr);
+		typedef hash_map<string, CACHE_CacheObject*> cache_index;
+
+		void 				remove_cache_object(cache_index::iterator itr);
+		static void			download_done(void * ref);     // curl_http_done_f, on the I/O thread
 
 		const string 	CACHE_INFO_FILE_EXT = ".cache_object_info";
 		string 			CACHE_folder;	                  // The fully qualified path to the file cache folder
-		vector<CACHE_CacheObject* > CACHE_file_cache;   // Our vector of CacheObjects
+		cache_index		CACHE_file_cache;               // Our CacheObjects, by path in the cache folder
+		atomic<int>		m_completed_count;
 };
 
 extern WED_FileCache gFileCache;
@@ -66,6 +66,7 @@
 
 #include "WED_UIDefs.h"
 #include <stdarg.h>
+#include <sys/stat.h>
 
 
 #if ERROR_CHECK
@@ -1088,6 +1089,8 @@ int		WED_CanImportApt(IResolver * resolver)
 	return 1;
 }
 
+#define INDEXED_IMPORT_SIZE	(16*1024*1024)
+
 void	WED_DoImportApt(WED_Document * resolver, WED_Archive * archive, WED_MapPane * pane)
 {
 	vector<string>	fnames;
@@ -1109,8 +1112,14 @@ void	WED_DoImportApt(WED_Document * resolver, WED_Archive * archive, WED_MapPane
 	if(fnames.empty())
 		return;
 		
-	AptVector	apts, one_apt;
-	
+	AptVector		apts, one_apt;
+	AptFileIndex_t	index;
+
+	// A single big apt.dat (like the global one) goes through its index: the picker only needs ids and names, and
+	// just the airports the user picks get parsed.
+	struct stat ss;
+	bool use_index = fnames.size() == 1 && FILE_get_file_meta_data(fnames[0], ss) == 0 && ss.st_size >= INDEXED_IMPORT_SIZE;
+
 	for(vector<string>::iterator f = fnames.begin(); f != fnames.end(); ++f)
 	{
 
@@ -1124,7 +1133,19 @@ void	WED_DoImportApt(WED_Document * resolver, WED_Archive * archive, WED_MapPane
 				return;
 		
 		LOG_MSG("I/Apt Importing apt.dat from %s\n",f->c_str());
-		string result = ReadAptFile(f->c_str(), one_apt);
+		string result;
+		if(use_index)
+		{
+			result = ReadAptFileIndex(f->c_str(), index);
+			one_apt.resize(index.airports.size());
+			for(int n = 0; n < index.airports.size(); ++n)
+			{
+				one_apt[n].icao = index.airports[n].icao;
+				one_apt[n].name = index.airports[n].name;
+			}
+		}
+		else
+			result = ReadAptFile(f->c_str(), one_apt);
 		if (!result.empty())
 		{
 			string msg = string("The apt.dat file '") + *f + string("' could not be imported:\n") + result;
@@ -1135,7 +1156,7 @@ void	WED_DoImportApt(WED_Document * resolver, WED_Archive * archive, WED_MapPane
 		apts.insert(apts.end(),one_apt.begin(),one_apt.end());
 	}
 	
-	WED_AptImportDialog * importer = new WED_AptImportDialog(gApplication, apts, fnames[0], resolver, archive, pane);
+	WED_AptImportDialog * importer = new WED_AptImportDialog(gApplication, apts, fnames[0], resolver, archive, pane, use_index ? &index : nullptr);
 }
 
 void	WED_ImportOneAptFile(
@@ -36,6 +36,7 @@
 #include "WED_Document.h"
 #include "WED_MapPane.h"
 #include "WED_Airport.h"
+#include "PlatformUtils.h"
 
 static int import_bounds_default[4] = { 0, 0, 500, 500 };
 
@@ -51,7 +52,8 @@ WED_AptImportDialog::WED_AptImportDialog(
 		const string&	file_path,
 		WED_Document *	resolver, 
 		WED_Archive *	archive,
-		WED_MapPane *	pane) : 
+		WED_MapPane *	pane,
+		const AptFileIndex_t * index) : 
 	GUI_Window("Import apt.dat", xwin_style_resizable|xwin_style_visible|xwin_style_centered|xwin_style_modal, import_bounds_default, cmdr),
 	mTextTable(this,100,0),
 	mMapPane(pane),
@@ -63,6 +65,8 @@ WED_AptImportDialog::WED_AptImportDialog(
 	resolver->AddListener(this);
 
 	swap(mApts,apts);
+	if(index)
+		mIndex = *index;
 
 	int bounds[4];
 	GUI_Packer * packer = new GUI_Packer;
@@ -198,9 +202,23 @@ void WED_AptImportDialog::DoIt(void)
 	set<int>	selected;
 	mAptTable.GetSelection(selected);
 	
-	for(int n = 0; n < mApts.size(); ++n)
-	if(selected.count(n))
-		apts.push_back(mApts[n]);
+	if(mIndex.airports.empty())
+	{
+		for(int n = 0; n < mApts.size(); ++n)
+		if(selected.count(n))
+			apts.push_back(mApts[n]);
+	}
+	else
+	{
+		vector<int> entries(selected.begin(), selected.end());
+		string result = ReadAptFileSubset(mPath.c_str(), mIndex, entries, apts);
+		if(!result.empty())
+		{
+			string msg = string("The apt.dat file '") + mPath + string("' could not be imported:\n") + result;
+			DoUserAlert(msg.c_str());
+			return;
+		}
+	}
 	
 	
 	
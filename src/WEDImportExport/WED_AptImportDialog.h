@@ -34,6 +34,7 @@ class	WED_MapPane;
 #include "GUI_Destroyable.h"
 
 #include "WED_AptTable.h"
+#include "AptIO.h"
 
 class GUI_Broadcaster;
 
@@ -41,7 +42,8 @@ class WED_AptImportDialog : public GUI_Window, public GUI_Listener, public GUI_D
 		
 public:
 
-						 WED_AptImportDialog(GUI_Commander * cmdr, AptVector& apts, const string& path, WED_Document * resolver, WED_Archive * archive, WED_MapPane * pane);
+						 WED_AptImportDialog(GUI_Commander * cmdr, AptVector& apts, const string& path, WED_Document * resolver, WED_Archive * archive, WED_MapPane * pane,
+												const AptFileIndex_t * index = nullptr);	// if set, apts only carry ids and names - the picks are read from path
 	virtual				~WED_AptImportDialog();
 	
 	virtual	bool		Closed(void);
@@ -67,6 +69,7 @@ private:
 	GUI_TextTableHeader		mTextTableHeader;
 
 	AptVector				mApts;
+	AptFileIndex_t			mIndex;
 	
 	WED_AptTable			mAptTable;
 
@@ -36,6 +36,8 @@
 #include "GUI_GraphState.h"
 #include "GUI_Fonts.h"
 #include "curl_http.h"
+#include "WorkerPool.h"
+#include <mutex>
 
 #include "WED_FileCache.h"
 #define _USE_MATH_DEFINES
@@ -62,6 +64,17 @@
 
 #define PREDEFINED_MAPS 2
 
+#define MAX_UPLOADS_PER_DRAW 4		// textures made per draw, the rest wait for the next one - keeps panning smooth
+									// when a whole screen of tiles comes in at once
+
+#define EVICT_AGE_WEIGHT (1.0f / 64.0f)	// an unused tile ages by one screen of distance (or one zoom level) per 64 draws
+#define EVICT_ERROR_AGE 64				// tiles that failed are forgotten after this many draws off screen, and asked for again
+
+#if defined(__SSE2__) || defined(_M_X64)
+	#include <emmintrin.h>
+	#define COLOR_SSE2 1
+#endif
+
 static const char * attributions[PREDEFINED_MAPS] = {
 "© OpenStreetMap Contributors",
 // ToDo: use shorter specific ESRI attribution by downloading https://static.arcgis.com/attribution/World_Imagery
@@ -170,23 +183,100 @@ static void get_tile_range_for_box(const double bounds[4], int z, int tiles[4])
 }
 
 
+/*
+	Darken and desaturate a 3 channel tile so the airport drawn on top of it stands out:
+		out = (1 - saturation) * luminance + saturation * in + brightness
+	in 7 bit fixed point. The luminance part is the same for the 3 channels of a pixel, so it is worked out per pixel
+	into a row of per byte offsets first - after that it's the same multiply-add for every byte of the row, 16 at a
+	time with SSE2. Brightness must be <= 0 for the sums to stay within 16 bits.
+*/
+static void adjust_tile_colors(ImageInfo& info, float brightness, float saturation)
+{
+	if(info.channels != 3) return;
+
+	int s = saturation * 128.0f + 0.5f;
+	int b = brightness * 128.0f;
+	int row_bytes = info.width * 3;
+	vector<short> offset(row_bytes + 16);
+
+	for(int y = 0; y < info.height; ++y)
+	{
+		unsigned char * p = info.data + y * (row_bytes + info.pad);
+
+		for(int x = 0; x < row_bytes; x += 3)
+		{
+			int val = (77 * p[x] + 153 * p[x+1] + 26 * p[x+2]) >> 8;  // deliberately not HSV weighing - want red's brighter
+			offset[x] = offset[x+1] = offset[x+2] = (128 - s) * val + b;
+		}
+
+		int x = 0;
+#if COLOR_SSE2
+		__m128i zero = _mm_setzero_si128();
+		__m128i mul = _mm_set1_epi16(s);
+		for(; x + 16 <= row_bytes; x += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i *) (p + x));
+			__m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(v, zero), mul), _mm_loadu_si128((const __m128i *) &offset[x]));
+			__m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(v, zero), mul), _mm_loadu_si128((const __m128i *) &offset[x+8]));
+			_mm_storeu_si128((__m128i *) (p + x), _mm_packus_epi16(_mm_srai_epi16(lo, 7), _mm_srai_epi16(hi, 7)));
+		}
+#endif
+		for(; x < row_bytes; ++x)
+			p[x] = intlim((s * p[x] + offset[x]) >> 7, 0, 255);
+	}
+}
+
+// Decoded tiles, on their way from the worker pool back to the UI thread.
+struct	WED_SlippyMap::decode_queue_t {
+	struct	result_t {
+		string		path;
+		int			z, x, y;
+		int			err;
+		ImageInfo	info;
+	};
+
+	mutex				lock;
+	vector<result_t>	done;
+
+	~decode_queue_t()
+	{
+		for(vector<result_t>::iterator r = done.begin(); r != done.end(); ++r)
+		if(r->err == 0)
+			DestroyBitmap(&r->info);
+	}
+
+	bool	has_results(void)
+	{
+		lock_guard<mutex> l(lock);
+		return !done.empty();
+	}
+};
+
 WED_SlippyMap::WED_SlippyMap(GUI_Pane * h, WED_MapZoomerNew * zoomer, IResolver * resolver)
 	: WED_MapLayer(h, zoomer, resolver),
-	m_cache_request(NULL),
+	m_completed_seen(0),
+	m_loaded_late(false),
+	m_cache_bytes(0),
+	m_frame(0),
+	m_decoded(make_shared<decode_queue_t>()),
+	m_decoding(0),
 	mMapMode(0)
 {
+	memset(&m_stats, 0, sizeof(m_stats));
 }
 
 WED_SlippyMap::~WED_SlippyMap()
 {
-	delete m_cache_request;
-	m_cache_request = NULL;
 }
 
 void	WED_SlippyMap::DrawVisualization(bool inCurrent, GUI_GraphState * g)
 {
 	if (mMapMode ==0) return;
-	finish_loading_tile();
+	m_completed_seen = gFileCache.get_completed_count();
+	m_loaded_late = false;
+	++m_frame;
+	finish_loading_tiles();
+	upload_tiles(MAX_UPLOADS_PER_DRAW);
 
 	double map_bounds[4];
 
@@ -202,6 +292,13 @@ void	WED_SlippyMap::DrawVisualization(bool inCurrent, GUI_GraphState * g)
 	int min_zoom = flt_abs(map_bounds[1]) > 60.0 ? MIN_ZOOM-1 : MIN_ZOOM; // get those ant/artic designers a bit more visibility
 	if(z_max < min_zoom) return;
 
+	for(map<string,tile_request_t>::iterator r = m_requests.begin(); r != m_requests.end(); ++r)
+		r->second.wanted = false;
+
+	// Downloads are ranked by how far the tile is from the middle of the view, in tiles
+	double ctr_x = (zoomer->LonToXPixel(map_bounds[0]) + zoomer->LonToXPixel(map_bounds[2])) * 0.5;
+	double ctr_y = (zoomer->LatToYPixel(map_bounds[1]) + zoomer->LatToYPixel(map_bounds[3])) * 0.5;
+
 	int want = 0, got = 0, bad = 0;
 	for(int z = max(min_zoom,z_max-1); z <= z_max; ++z)      // Display only the next lower zoom level
 	{                                                        // avoids having to load up to 4x14 extra tiles at ZL16
@@ -264,11 +361,13 @@ void	WED_SlippyMap::DrawVisualization(bool inCurrent, GUI_GraphState * g)
 			//The potential place the tile could appear on disk, were it to be downloaded or have been downloaded
 			string potential_path = gFileCache.url_to_cache_path(WED_file_cache_request(cache_domain_osm_tile, folder_prefix , url));
 
-			if (m_cache.count(potential_path))
+			hash_map<string,tile_t>::iterator cached = m_cache.find(potential_path);
+			if (cached != m_cache.end())
 			{
 				++got;
+				cached->second.last_drawn = m_frame;
 
-				int id = m_cache[potential_path];
+				int id = cached->second.tex_id;
 				if(id != 0)
 				{
 					g->SetState(0, 1, 0, 0, 0, 0, 0);
@@ -298,14 +397,54 @@ void	WED_SlippyMap::DrawVisualization(bool inCurrent, GUI_GraphState * g)
 					++bad;
 				}
 			}
-			else if(m_cache_request == NULL)
+			else
 			{
-				m_cache_request = new WED_file_cache_request(cache_domain_osm_tile, folder_prefix, url);
+				double tile_size = max(1.0, pbounds[2] - pbounds[0]);
+				float dist = sqrt(sqr((pbounds[0] + pbounds[2]) * 0.5 - ctr_x) + sqr((pbounds[1] + pbounds[3]) * 0.5 - ctr_y)) / tile_size;
+
+				map<string,tile_request_t>::iterator r = m_requests.find(potential_path);
+				if(r == m_requests.end())
+				{
+					tile_request_t& t = m_requests[potential_path];
+					t.req = WED_file_cache_request(cache_domain_osm_tile, folder_prefix, url, dist);
+					t.z = z; t.x = x; t.y = y;
+					t.started = false;
+					t.wanted = true;
+					t.decoding = false;
+				}
+				else
+				{
+					r->second.req.in_priority = dist;
+					r->second.wanted = true;
+				}
 			}
 		}
 	}
 
-	if (m_cache_request)
+	// Tiles that scrolled off go to the back of the queue. They aren't cancelled - whatever arrives still lands in the disk cache.
+	for(map<string,tile_request_t>::iterator r = m_requests.begin(); r != m_requests.end(); )
+	{
+		if(!r->second.wanted && !r->second.decoding)
+		{
+			if(r->second.started)
+			{
+				r->second.req.in_priority = 1e9f;
+				gFileCache.request_file(r->second.req);
+			}
+			m_requests.erase(r++);
+		}
+		else
+			++r;
+	}
+
+	m_stats.hits += got;
+	m_stats.misses += want - got;
+
+	// Hand the new ones to the file cache. Some may be on disk already and go straight to the decoder.
+	finish_loading_tiles();
+	evict_tiles(z_max, ctr_x, ctr_y, max(1.0, sqrt(dob_sqr(ctr_x - zoomer->LonToXPixel(map_bounds[0])) + dob_sqr(ctr_y - zoomer->LatToYPixel(map_bounds[1])))));
+
+	if (!m_requests.empty() || m_decoding > 0 || m_loaded_late)
 	{
 		this->Start(0.05);
 	}
@@ -314,11 +453,15 @@ void	WED_SlippyMap::DrawVisualization(bool inCurrent, GUI_GraphState * g)
 		this->Stop();
 	}
 
+	slippy_stats_t stats;
+	GetStats(stats);
+	long long lookups = stats.hits + stats.misses;
 	stringstream zoom_msg;
 	zoom_msg << "ZL" << z_max << ": "
 			 << got << " of " << want
 			 << " (" << (float)got * 100.0f / (float)want << "% done, " << bad << " errors). "
-			 << (int)m_cache.size() << " tiles cached (" << (int)m_cache.size() / 4 << " MB)";
+			 << stats.tiles << " tiles cached (" << (int)(stats.bytes >> 20) << " of " << (int)(stats.budget >> 20) << " MB, "
+			 << (int)(lookups ? stats.hits * 100 / lookups : 0) << "% hits)";
 
 	int bnds[4];
 	GetHost()->GetBounds(bnds);
@@ -346,51 +489,45 @@ void	WED_SlippyMap::GetCaps(bool& draw_ent_v, bool& draw_ent_s, bool& cares_abou
 	draw_ent_v = draw_ent_s = cares_about_sel = wants_clicks = 0;
 }
 
-void	WED_SlippyMap::finish_loading_tile()
+// Poll every outstanding tile, closest to the middle first. Tiles that arrived go to the worker pool to be decoded.
+void	WED_SlippyMap::finish_loading_tiles()
 {
-	if (m_cache_request != NULL)
+	vector<pair<float,string> > order;
+	order.reserve(m_requests.size());
+	for(map<string,tile_request_t>::iterator r = m_requests.begin(); r != m_requests.end(); ++r)
+	if(!r->second.decoding)
+		order.push_back(make_pair(r->second.req.in_priority, r->first));
+	sort(order.begin(), order.end());
+
+	float brightness = mMapMode == 1 ? -140.0f : -20.0f;
+	float saturation = mMapMode == 1 ?    0.4f :   1.0f;
+
+	for(vector<pair<float,string> >::iterator o = order.begin(); o != order.end(); ++o)
 	{
-		WED_file_cache_response res = gFileCache.request_file(*m_cache_request);
+		tile_request_t& t = m_requests[o->second];
+		t.started = true;
+
+		WED_file_cache_response res = gFileCache.request_file(t.req);
 		if (res.out_status == cache_status_available)
 		{
-			struct ImageInfo info;
-			int r = CreateBitmapFromPNG(res.out_path.c_str(), &info, false, 0);
-			if(r != 0)
-				r = CreateBitmapFromJPEG(res.out_path.c_str(), &info);
-			if(r == 0)
-			{
-				if (info.channels == 3)                                                        // apply to color changes
-					for (int x = 0; x < info.height * (info.width+info.pad) * info.channels; x += info.channels)
-						{
-							double BRIGHTNESS = -20;
-							double SATURATION = 1.0;
-							if(mMapMode == 1) { BRIGHTNESS = -140.0; SATURATION = 0.4; }
-
-							int val = 0.3 * info.data[x] + 0.6 * info.data[x+1] + 0.1 * info.data[x+2];  // deliberately not HSV weighing - want red's brighter
-							for (int c = 0; c < info.channels; ++c)
-								info.data[x+c] = intlim((1.0-SATURATION) * val + SATURATION * info.data[x+c] + BRIGHTNESS, 0, 255);
-						}
-
-				GLuint tex_id;
-				glGenTextures(1, &tex_id);
-				if (LoadTextureFromImage(info, tex_id, tex_Linear, NULL, NULL, NULL, NULL))
-				{
-					m_cache[res.out_path] = tex_id;
-				}
-				else
-				{
-					printf("Failed texture load from image.\n");
-					m_cache[res.out_path] = 0;
-				}
-			}
-			else
-			{
-				printf("Can not read image tile - bad PNG or JPG data.\n");
-				m_cache[res.out_path] = 0;
-			}
-			DestroyBitmap(&info);
-			delete m_cache_request;
-			m_cache_request = NULL;
+			shared_ptr<decode_queue_t> q(m_decoded);
+			string key(o->second), path(res.out_path);
+			int z = t.z, x = t.x, y = t.y;
+			WorkerPool_Post([q, key, path, z, x, y, brightness, saturation]() {
+				decode_queue_t::result_t r;
+				r.path = key;
+				r.z = z; r.x = x; r.y = y;
+				r.err = CreateBitmapFromPNG(path.c_str(), &r.info, false, 0);
+				if(r.err != 0)
+					r.err = CreateBitmapFromJPEG(path.c_str(), &r.info);
+				if(r.err == 0)
+					adjust_tile_colors(r.info, brightness, saturation);
+
+				lock_guard<mutex> l(q->lock);
+				q->done.push_back(r);
+			});
+			t.decoding = true;
+			++m_decoding;
 		}
 		else if (res.out_status == cache_status_error)
 		{
@@ -398,17 +535,115 @@ void	WED_SlippyMap::finish_loading_tile()
 
 			printf("%s: %d\n%s\n", res.out_path.c_str(), code, res.out_error_human.c_str());
 
-			m_cache[res.out_path] = 0;
+			tile_t bad = { 0, 0, t.z, t.x, t.y, m_frame };
+			m_cache[o->second] = bad;
+			m_requests.erase(o->second);
+		}
+	}
+}
 
-			delete m_cache_request;
-			m_cache_request = NULL;
+// Make textures out of up to max_count decoded tiles. If there are more, draw again soon for the rest.
+void	WED_SlippyMap::upload_tiles(int max_count)
+{
+	vector<decode_queue_t::result_t> ready;
+	{
+		lock_guard<mutex> l(m_decoded->lock);
+		int n = min((int) m_decoded->done.size(), max_count);
+		ready.assign(m_decoded->done.begin(), m_decoded->done.begin() + n);
+		m_decoded->done.erase(m_decoded->done.begin(), m_decoded->done.begin() + n);
+		m_stats.uploads_waiting = m_decoded->done.size();
+	}
+	if(m_stats.uploads_waiting > 0)
+		m_loaded_late = true;
+
+	for(vector<decode_queue_t::result_t>::iterator r = ready.begin(); r != ready.end(); ++r)
+	{
+		--m_decoding;
+		m_requests.erase(r->path);
+
+		tile_t t = { 0, 0, r->z, r->x, r->y, m_frame };
+		if(r->err == 0)
+		{
+			GLuint tex_id;
+			glGenTextures(1, &tex_id);
+			if (LoadTextureFromImage(r->info, tex_id, tex_Linear, NULL, NULL, NULL, NULL))
+			{
+				t.tex_id = tex_id;
+				t.bytes = r->info.width * r->info.height * 4;	// RGB is padded to RGBA by about every driver
+			}
+			else
+			{
+				printf("Failed texture load from image.\n");
+				glDeleteTextures(1, &tex_id);
+			}
+			DestroyBitmap(&r->info);
 		}
+		else
+			printf("Can not read image tile - bad PNG or JPG data.\n");
+
+		m_cache[r->path] = t;
+		m_cache_bytes += t.bytes;
 	}
 }
 
+// Drop textures until we are within gSlippyCacheMB. Whatever was drawn this time stays; of the rest the ones that score
+// highest go first: distance from the middle of the view in view sizes, plus one per zoom level away from the view's,
+// plus the draws since they were last seen, 64 draws to one. Failed tiles take no memory, they just age out.
+void	WED_SlippyMap::evict_tiles(int z, double ctr_x, double ctr_y, double view_size)
+{
+	for(hash_map<string,tile_t>::iterator t = m_cache.begin(); t != m_cache.end(); )
+	{
+		if(t->second.tex_id == 0 && m_frame - t->second.last_drawn > EVICT_ERROR_AGE)
+			m_cache.erase(t++);
+		else
+			++t;
+	}
+
+	long long budget = (long long) gSlippyCacheMB << 20;
+	if(m_cache_bytes <= budget)
+		return;
+
+	WED_MapZoomerNew * zoomer = GetZoomer();
+	vector<pair<float, hash_map<string,tile_t>::iterator> > victims;
+	for(hash_map<string,tile_t>::iterator t = m_cache.begin(); t != m_cache.end(); ++t)
+	if(t->second.tex_id != 0 && t->second.last_drawn != m_frame)
+	{
+		const tile_t& tile = t->second;
+		double x = zoomer->LonToXPixel(0.5 * (tilex2long(tile.x, tile.z) + tilex2long(tile.x + 1, tile.z)));
+		double y = zoomer->LatToYPixel(0.5 * (tiley2lat (tile.y, tile.z) + tiley2lat (tile.y + 1, tile.z)));
+		float score = sqrt(dob_sqr(x - ctr_x) + dob_sqr(y - ctr_y)) / view_size
+					+ abs(tile.z - z)
+					+ (m_frame - tile.last_drawn) * EVICT_AGE_WEIGHT;
+		victims.push_back(make_pair(-score, t));
+	}
+	sort(victims.begin(), victims.end(),
+		[](const pair<float, hash_map<string,tile_t>::iterator>& a, const pair<float, hash_map<string,tile_t>::iterator>& b) { return a.first < b.first; });
+
+	for(int n = 0; n < victims.size() && m_cache_bytes > budget; ++n)
+	{
+		GLuint id = victims[n].second->second.tex_id;
+		glDeleteTextures(1, &id);
+		m_cache_bytes -= victims[n].second->second.bytes;
+		m_cache.erase(victims[n].second);
+		++m_stats.evicted;
+	}
+}
+
+void	WED_SlippyMap::GetStats(slippy_stats_t& out_stats) const
+{
+	out_stats = m_stats;
+	out_stats.tiles = m_cache.size();
+	out_stats.bytes = m_cache_bytes;
+	out_stats.budget = (long long) gSlippyCacheMB << 20;
+	out_stats.decoding = m_decoding - m_stats.uploads_waiting;
+}
+
+// The file cache counts finished downloads from its I/O thread - only redraw once one of ours may have come in,
+// or a decoded tile is waiting to be made into a texture.
 void	WED_SlippyMap::TimerFired()
 {
-	GetHost()->Refresh();
+	if(m_loaded_late || gFileCache.get_completed_count() != m_completed_seen || m_decoded->has_results())
+		GetHost()->Refresh();
 }
 
 static bool replace_token(string& str, const string& from, const string& to)
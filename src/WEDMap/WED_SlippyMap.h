@@ -25,13 +25,24 @@
 #ifndef WED_SlippyMap_h
 #define WED_SlippyMap_h
 
-class	WED_file_cache_request;
-
 #include "GUI_Timer.h"
 #include "WED_MapLayer.h"
+#include "WED_FileCache.h"
+#include <memory>
 
 enum yCoord_t { yNone, yNormal, yYahoo, yOSGeo };
 
+struct	slippy_stats_t {
+	int			tiles;			// textures held
+	long long	bytes;			// their estimated size in video memory
+	long long	budget;			// gSlippyCacheMB
+	long long	hits;			// tiles that were ready when they had to be drawn, over all draws
+	long long	misses;			// and those that weren't
+	long long	evicted;		// textures dropped to stay within the budget
+	int			decoding;		// downloaded, being decoded on the worker pool
+	int			uploads_waiting;	// decoded, waiting for their turn to become a texture
+};
+
 class	WED_SlippyMap : public WED_MapLayer, public GUI_Timer {
 public:
 
@@ -43,16 +54,48 @@ public:
 	virtual	void	TimerFired(void);
 			void	SetMode(int mode);  // mode 0 = custom map string, 1..2 OSM and ERSI maps
 			int		GetMode(void);
+			void	GetStats(slippy_stats_t& out_stats) const;
 
 private:
 
-			void	finish_loading_tile();
+	struct	decode_queue_t;
+
+			void	finish_loading_tiles();
+			void	upload_tiles(int max_count);
+			void	evict_tiles(int z, double ctr_x, double ctr_y, double view_size);
 			int 	get_zl_for_map(double in_ppm, double lattitude);
 
-	WED_file_cache_request* m_cache_request;
+	struct	tile_request_t {
+		WED_file_cache_request	req;
+		int						z, x, y;
+		bool					started;	// been handed to the file cache at least once
+		bool					wanted;		// still on screen as of the last draw
+		bool					decoding;	// the file is here and on its way to the decoder
+	};
+
+	struct	tile_t {
+		int			tex_id;			// 0 if the tile couldn't be had
+		int			bytes;
+		int			z, x, y;
+		unsigned	last_drawn;		// m_frame
+	};
+
+	//The tiles we are waiting for, by the same key as m_cache. Any number of them can be downloading at once - the file
+	//cache starts the waiting ones closest to the middle of the view first.
+	map<string,tile_request_t>	m_requests;
+	int							m_completed_seen;	// gFileCache's completed count when we last looked
+	bool						m_loaded_late;		// tiles came in after we drew, so draw again
+
+	//The texture cache, where they key is the tile texture path on disk. Once over gSlippyCacheMB, the textures drawn longest
+	//ago, furthest from the middle of the view and at other zoom levels than the view are deleted first. Tiles that failed
+	//stay in here with tex_id 0 until they have been off screen for a while, so they aren't asked for again on every draw.
+	hash_map<string,tile_t>		m_cache;
+	long long					m_cache_bytes;
+	unsigned					m_frame;
 
-	//The texture cache, where they key is the tile texture path on disk and the value is the texture id
-	map<string,int>	m_cache;
+	shared_ptr<decode_queue_t>	m_decoded;			// shared with the decode jobs, which may outlive us
+	int							m_decoding;			// jobs posted and not collected yet
+	slippy_stats_t				m_stats;
 
 			int		mMapMode;
 			string	url_printf_fmt;
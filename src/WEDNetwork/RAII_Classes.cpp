@@ -1,9 +1,9 @@
 #include "RAII_Classes.h"
 
 //--RAII_CurlHandle------------------------------------------------------------
-RAII_CurlHandle::RAII_CurlHandle(const string& url, int buf_reserve_size) :
+RAII_CurlHandle::RAII_CurlHandle(const string& url, int buf_reserve_size, float priority, curl_http_done_f done_cb, void * done_ref) :
 	m_dest_buffer(vector<char>(buf_reserve_size)),
-	m_curl_handle(url, &m_dest_buffer)
+	m_curl_handle(url, &m_dest_buffer, priority, done_cb, done_ref)
 {
 }
 
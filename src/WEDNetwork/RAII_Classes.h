@@ -34,7 +34,7 @@
 class RAII_CurlHandle
 {
 public:
-	RAII_CurlHandle(const string& url, int buf_reserve_size=0);
+	RAII_CurlHandle(const string& url, int buf_reserve_size=0, float priority=0.0f, curl_http_done_f done_cb=NULL, void * done_ref=NULL);
 	
 	//Get curl_http_get_file handle
 	curl_http_get_file& get_curl_handle();
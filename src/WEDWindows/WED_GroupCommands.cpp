@@ -34,6 +34,7 @@
 #include "MathUtils.h"
 #include "MemFileUtils.h"
 #include "PlatformUtils.h"
+#include "RTree2.h"
 
 #include "AptDefs.h"
 #include "XObjDefs.h"
@@ -1131,28 +1132,38 @@ set<WED_Thing *> WED_select_doubles(WED_Thing * t)
 
 	set<WED_Thing *> doubles;
 
-	// Ben says: yes this totally sucks - replace it someday?
+	// Each node is paired with the first later node that is too close - a range tree over the locations means we only
+	// distance-test the few nodes within DOUBLE_PT_DIST of it, rather than every later node.
+	vector<Point2> locs(pts.size());
+	vector<RTree2<int, 8>::item_type> items;
+	items.reserve(pts.size());
 	for(int i = 0; i < pts.size(); ++i)
 	{
-		Point2 p1, p2;
 		IGISPoint * ii = dynamic_cast<IGISPoint *>(pts[i]);
-		ii->GetLocation(gis_Geo, p1);
+		DebugAssert(ii);
+		ii->GetLocation(gis_Geo, locs[i]);
+		items.push_back(RTree2<int, 8>::item_type(Bbox2(locs[i]), i));
+	}
+	RTree2<int, 8> index;
+	index.insert(items.begin(), items.end());
 
-		for(int j = i + 1; j < pts.size(); ++j)
+	vector<int> near_i;
+	for(int i = 0; i < pts.size(); ++i)
+	{
+		Bbox2 b(locs[i]);
+		b.expand(DOUBLE_PT_DIST);
+		near_i.clear();
+		index.query_value(b, back_inserter(near_i));
+		sort(near_i.begin(), near_i.end());
+
+		for(auto j : near_i)
+		if(j > i)
 		{
-			IGISPoint * jj = dynamic_cast<IGISPoint *>(pts[j]);
-			jj->GetLocation(gis_Geo, p2);
-			DebugAssert(ii != jj);
-			DebugAssert(ii);
-			DebugAssert(jj);
+			DebugAssert(pts[i] != pts[j]);
 
 //			if(!(ii->GetGISSubtype() == jj->GetGISSubtype())) continue;
 
-//			Point2 p1, p2;
-//			ii->GetLocation(gis_Geo, p1);
-//			jj->GetLocation(gis_Geo, p2);
-
-			if(p1.squared_distance(p2) < (DOUBLE_PT_DIST*DOUBLE_PT_DIST))
+			if(locs[i].squared_distance(locs[j]) < (DOUBLE_PT_DIST*DOUBLE_PT_DIST))
 			{
 				doubles.insert(pts[i]);
 				doubles.insert(pts[j]);
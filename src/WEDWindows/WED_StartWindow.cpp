@@ -381,6 +381,7 @@ int			WED_StartWindow::HandleCommand(int command)
 					mPackageList->LockPackage(nd.n);
 					gPackageMgr->SetRecentName(name);
 					nd.d->AddListener(this);
+					nd.d->RecoverAutosave();
 				} catch(exception& e) {
 					DoUserAlert(e.what());				
 				} catch (...) {
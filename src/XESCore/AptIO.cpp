@@ -29,6 +29,10 @@
 #include "AssertUtils.h"
 #include "CompGeomUtils.h"
 #include "STLUtils.h"
+#include "WorkerPool.h"
+#include "FileUtils.h"
+#include <sys/stat.h>
+#include <float.h>
 
 #include "WED_Version.h"
 // for now
@@ -36,18 +40,94 @@
 #define ATC_VERS2 1050
 #define ATC_VERS3 1100
 
-#if TYLER_MODE                         // minimize apt.dat size by reducing precision, dropping irrelevant names
-  #define LLFMT  " %.7lf %.7lf"        // 1e-7 deg ~1 cm resolution
-  #define LLFMT2 " %.6lf %.6lf"        // 10 cm resolution for 'dynamic' scenery items
-  #define NFMT
-  #define N(x)
+// apt.dat text is built in memory by AptRecordWriter - it produces exactly what the printf formats noted next to
+// each call would, but without varargs or a stdio call per field.  Fixed-point numbers are rounded from the exact
+// binary value, like printf; the few that land too close to a rounding tie to be sure are handed to snprintf.
+class	AptRecordWriter {
+public:
+
+	AptRecordWriter() { mBuf.reserve(64*1024); }
+
+	// %d, %<width>d, %0<width>d
+	AptRecordWriter&	i(int v, int width = 0, char pad = ' ')
+	{
+		char	digits[16];
+		char *	d = digits + sizeof(digits);
+		unsigned int u = v < 0 ? 0u - (unsigned int) v : v;
+		do { *--d = '0' + u % 10; u /= 10; } while (u);
+		return number(v < 0 ? '-' : 0, d, digits + sizeof(digits) - d, width, pad);
+	}
+
+	// %.<prec>f, %<width>.<prec>f, and with sign_space and pad '0' "% 0<width>.<prec>f"
+	AptRecordWriter&	f(double v, int prec, int width = 0, char pad = ' ', bool sign_space = false)
+	{
+		static const double k_scale[] = { 1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8 };
+		double y = fabs(v) * k_scale[prec];
+		double r = floor(y + 0.5);
+		// y is within half an ulp of |v| * 10^prec; if that could straddle a .5, only printf's exact arithmetic will do.
+		if (!(y < 1e15) || fabs(fabs(y - floor(y)) - 0.5) <= 4.0 * DBL_EPSILON * y)
+		{
+			char fmt[16], buf[400];
+			snprintf(fmt, sizeof(fmt), "%%%s%s%d.%df", sign_space ? " " : "", pad == '0' ? "0" : "", width, prec);
+			snprintf(buf, sizeof(buf), fmt, v);
+			mBuf += buf;
+			return *this;
+		}
+
+		unsigned long long	n = r;
+		char	digits[32];
+		char *	d = digits + sizeof(digits);
+		for (int k = 0; k < prec; ++k, n /= 10)
+			*--d = '0' + n % 10;
+		if (prec > 0)
+			*--d = '.';
+		do { *--d = '0' + n % 10; n /= 10; } while (n);
+		return number(signbit(v) ? '-' : (sign_space ? ' ' : 0), d, digits + sizeof(digits) - d, width, pad);
+	}
+
+	// %s, %<width>s
+	AptRecordWriter&	s(const char * str, int width = 0)
+	{
+		size_t len = strlen(str);
+		if ((int) len < width)
+			mBuf.append(width - len, ' ');
+		mBuf.append(str, len);
+		return *this;
+	}
+
+	AptRecordWriter&	s(const string& str, int width = 0)	{ return s(str.c_str(), width); }
+	AptRecordWriter&	c(char ch)							{ mBuf += ch;	return *this; }
+	AptRecordWriter&	eol(void)							{ mBuf += CRLF;	return *this; }
+
+#if TYLER_MODE		// minimize apt.dat size by reducing precision, dropping irrelevant names
+	AptRecordWriter&	ll (double lat, double lon)	{ return c(' ').f(lat, 7).c(' ').f(lon, 7); }		// " %.7lf %.7lf"  1e-7 deg ~1 cm resolution
+	AptRecordWriter&	ll2(double lat, double lon)	{ return c(' ').f(lat, 6).c(' ').f(lon, 6); }		// " %.6lf %.6lf"  10 cm resolution for 'dynamic' scenery items
+	AptRecordWriter&	name(const string& n)		{ return *this; }
 #else
-  #define LLFMT  " % 012.8lf % 013.8lf"
-  #define LLFMT2 " % 012.8lf % 013.8lf"
-  #define NFMT   " %s"
-  #define N(x)   ,x->name.c_str()
+	AptRecordWriter&	ll (double lat, double lon)	{ return c(' ').f(lat, 8, 12, '0', true).c(' ').f(lon, 8, 13, '0', true); }	// " % 012.8lf % 013.8lf"
+	AptRecordWriter&	ll2(double lat, double lon)	{ return ll(lat, lon); }
+	AptRecordWriter&	name(const string& n)		{ return c(' ').s(n); }								// " %s"
 #endif
 
+	const char *		data(void) const	{ return mBuf.data(); }
+	size_t				size(void) const	{ return mBuf.size(); }
+	void				clear(void)			{ mBuf.clear(); }
+
+private:
+
+	AptRecordWriter&	number(char sign, const char * digits, int len, int width, char pad)
+	{
+		int fill = width - len - (sign ? 1 : 0);
+		if (fill > 0 && pad != '0') mBuf.append(fill, ' ');
+		if (sign) mBuf += sign;
+		if (fill > 0 && pad == '0') mBuf.append(fill, '0');
+		mBuf.append(digits, len);
+		return *this;
+	}
+
+	string	mBuf;
+};
+
 #if OPENGL_MAP
 #include "Airports.h"
 void	GenerateOGL(AptInfo_t * a);
@@ -123,7 +203,7 @@ int scan_enum(const char * str, const char * enums[])
 }
 
 
-void print_bitfields(int(*fprintf)(void *, const char *, ...), void * fi, int flags, const char * bits[])
+static void write_bitfields(AptRecordWriter& w, int flags, const char * bits[])
 {
 	int n = 0, b = 1;
 	bool any = false;
@@ -131,9 +211,9 @@ void print_bitfields(int(*fprintf)(void *, const char *, ...), void * fi, int fl
 	{
 		if(flags & b)
 		{
-			if(any) fprintf(fi,"|");
+			if(any) w.c('|');
 			any = true;
-			fprintf(fi,"%s", bits[n]);
+			w.s(bits[n]);
 		}
 		++n;
 		b <<= 1;
@@ -150,13 +230,13 @@ static void	parse_linear_codes(const string& codes, set<int> * attributes)
 		attributes->insert(code);
 }
 
-static void	print_apt_poly(int (*fprintf)(void * fi, const char * fmt, ...), void * fi, const AptPolygon_t& poly, int version)
+static void	write_apt_poly(AptRecordWriter& w, const AptPolygon_t& poly, int version)
 {
 	for (AptPolygon_t::const_iterator s = poly.begin(); s != poly.end(); ++s)
 	{
-		fprintf(fi,"%d" LLFMT, s->code,CGAL2DOUBLE(s->pt.y()),CGAL2DOUBLE(s->pt.x()));
+		w.i(s->code).ll(CGAL2DOUBLE(s->pt.y()),CGAL2DOUBLE(s->pt.x()));
 		if (s->code == apt_lin_crv || s->code == apt_rng_crv || s-> code == apt_end_crv)
-		fprintf(fi, LLFMT, CGAL2DOUBLE(s->ctrl.y()),CGAL2DOUBLE(s->ctrl.x()));
+		w.ll(CGAL2DOUBLE(s->ctrl.y()),CGAL2DOUBLE(s->ctrl.x()));
 		if (s->code != apt_end_seg && s->code != apt_end_crv)
 			for (set<int>::const_iterator a = s->attributes.begin(); a != s->attributes.end(); ++a)
 			{
@@ -173,12 +253,12 @@ static void	print_apt_poly(int (*fprintf)(void * fi, const char * fmt, ...), voi
 					else if (b == 107)  b = 101;                     // unidirectional green centerline lights
 					else if (b == 108)  b = 105;                     // unidirectional yellow/green lights
 
-					fprintf(fi, " %d", b);
+					w.c(' ').i(b);
 				}
 				else
-					fprintf(fi, " %d", *a);
+					w.c(' ').i(*a);
 			}
-		fputs(CRLF, (FILE *) fi);
+		w.eol();
 	}
 }
 
@@ -248,6 +328,148 @@ static void CenterToCorners(Point2 location, double heading, double len, double
 }
 
 
+// A cut-down TextScanner_FormatScan for the records that make up the bulk of an apt.dat: same tokens and the same
+// atoi/atof conversions, but no varargs, no format string and no heap string per field.  Each call takes the next
+// field if the line has one; count() is what TextScanner_FormatScan would have returned.
+class	AptFieldScanner {
+public:
+	AptFieldScanner(MFTextScanner * s) : mPos(TextScanner_GetBegin(s)), mEnd(TextScanner_GetEnd(s)), mCount(0) { }
+
+	AptFieldScanner&	i(int& v)		{ const char * b, * e; if (token(b, e, false)) v = atoi(terminate(b, e));	return *this; }
+	AptFieldScanner&	d(double& v)	{ const char * b, * e; if (token(b, e, false)) v = atof(terminate(b, e));	return *this; }
+	AptFieldScanner&	T(string& v)	{ const char * b, * e; if (token(b, e, false)) v.assign(b, e);				return *this; }
+	AptFieldScanner&	rest(string& v)	{ const char * b, * e; if (token(b, e, true )) v.assign(b, e);				return *this; }	// "T|"
+
+	int					count(void) const { return mCount; }
+
+private:
+
+	bool	token(const char *& b, const char *& e, bool to_end)
+	{
+		while (mPos < mEnd && (*mPos == ' ' || *mPos == '\t')) ++mPos;
+		if (mPos == mEnd || *mPos == 0)
+		{
+			mEnd = mPos;
+			return false;
+		}
+		b = mPos;
+		while (mPos < mEnd && *mPos != 0 && (to_end || (*mPos != ' ' && *mPos != '\t'))) ++mPos;
+		e = mPos;
+		++mCount;
+		return true;
+	}
+
+	const char *	terminate(const char * b, const char * e)
+	{
+		if (e - b < sizeof(mBuf))
+		{
+			memcpy(mBuf, b, e - b);
+			mBuf[e - b] = 0;
+			return mBuf;
+		}
+		mLong.assign(b, e);
+		return mLong.c_str();
+	}
+
+	const char *	mPos;
+	const char *	mEnd;
+	int				mCount;
+	char			mBuf[64];
+	string			mLong;
+};
+
+static void	CalcAptBounds(AptInfo_t * a)
+{
+	a->bounds = Bbox2();
+	if (a->tower.draw_obj != -1)
+		a->bounds = Bbox2(a->tower.location);
+	if(a->beacon.color_code != apt_beacon_none)
+		a->bounds += a->beacon.location;
+	for (int w = 0; w < a->windsocks.size(); ++w)
+		a->bounds += a->windsocks[w].location;
+	for (int r = 0; r < a->gates.size(); ++r)
+		a->bounds += a->gates[r].location;
+	for (AptPavementVector::iterator p = a->pavements.begin(); p != a->pavements.end(); ++p)
+	{
+		a->bounds +=  p->ends.source();
+		a->bounds +=  p->ends.target();
+	}
+	for (AptRunwayVector::iterator r = a->runways.begin(); r != a->runways.end(); ++r)
+	{
+		a->bounds +=  r->ends.source();
+		a->bounds +=  r->ends.target();
+	}
+	for(AptSealaneVector::iterator s = a->sealanes.begin(); s != a->sealanes.end(); ++s)
+	{
+		a->bounds +=  s->ends.source();
+		a->bounds +=  s->ends.target();
+	}
+	for(AptHelipadVector::iterator h = a->helipads.begin(); h != a->helipads.end(); ++h)
+		a->bounds +=  h->location;
+
+	for(AptTaxiwayVector::iterator t = a->taxiways.begin(); t != a->taxiways.end(); ++t)
+	for(AptPolygon_t::iterator pt = t->area.begin(); pt != t->area.end(); ++pt)
+	{
+		a->bounds +=  pt->pt;
+		if(pt->code == apt_lin_crv || pt->code == apt_rng_crv || pt-> code == apt_end_crv)
+			a->bounds +=  pt->ctrl;
+	}
+
+	for(AptBoundaryVector::iterator b = a->boundaries.begin(); b != a->boundaries.end(); ++b)
+	for(AptPolygon_t::iterator pt = b->area.begin(); pt != b->area.end(); ++pt)
+	{
+		a->bounds +=  pt->pt;
+		if(pt->code == apt_lin_crv || pt->code == apt_rng_crv || pt-> code == apt_end_crv)
+			a->bounds +=  pt->ctrl;
+	}
+
+	//a->bounds.expand(0.001);
+}
+
+// Nothing carries over from one airport to the next, so a big apt.dat is cut into chunks at airport headers (1, 16
+// and 17), the chunks are parsed on the worker pool and the results are put back together in file order.  Only
+// plain "1", "16" or "17" tokens are taken as cut points - anything odder just stays inside its chunk.
+#define APT_CHUNK_MIN	(1024*1024)
+
+static bool	is_airport_header(const char * p, const char * e)
+{
+	while (p < e && (*p == ' ' || *p == '\t')) ++p;
+	const char * t = p;
+	while (p < e && *p >= '0' && *p <= '9') ++p;
+	if (p < e && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+		return false;
+	return (p - t == 1 && t[0] == '1') ||
+		   (p - t == 2 && t[0] == '1' && (t[1] == '6' || t[1] == '7'));
+}
+
+// First airport header at or after the line following p - the byte after a \n always starts a scanner line.
+static const char *	next_airport_line(const char * p, const char * e)
+{
+	while (p < e)
+	{
+		p = (const char *) memchr(p, '\n', e - p);
+		if (p == NULL)
+			return e;
+		++p;
+		if (is_airport_header(p, e))
+			return p;
+	}
+	return e;
+}
+
+struct apt_chunk_t {
+	apt_chunk_t(const char * b, const char * e) : begin(b), end(e), lines(0), done(false) { }
+	const char *	begin;
+	const char *	end;
+	AptVector		apts;
+	string			err;
+	string			warnings;
+	int				lines;
+	bool			done;		// hit the 99 record
+};
+
+static string	ReadAptRecords(const char * inBegin, const char * inEnd, int vers, AptVector& outApts, int& ln, bool& forceDone, string& warnings);
+
 string	ReadAptFile(const char * inFileName, AptVector& outApts)
 {
 	outApts.clear();
@@ -259,22 +481,18 @@ string	ReadAptFile(const char * inFileName, AptVector& outApts)
 	return err;
 }
 
-string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outApts)
+// Checks the two header lines and leaves the scanner on the first record.
+static string	ReadAptHeader(MFTextScanner * s, int& vers, int& ln)
 {
-	outApts.clear();
-
-	MFTextScanner * s = TextScanner_OpenMem(inBegin, inEnd);
 	string ok;
 
-	int ln = 0;
-
 	// Versioning:
 	// 703 (base)
 	// 715 - addded vis flag to tower
 	// 810 - added vasi slope to towers
 	// 850 - added next-gen stuff
 
-		int vers = 0;
+		vers = 0;
 
 	if (TextScanner_IsDone(s))
 		ok = string("File is empty.");
@@ -299,6 +517,78 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 		TextScanner_Next(s);
 		++ln;
 	}
+	return ok;
+}
+
+string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outApts)
+{
+	outApts.clear();
+
+	MFTextScanner * s = TextScanner_OpenMem(inBegin, inEnd);
+
+	int ln = 0;
+	int vers;
+	string ok = ReadAptHeader(s, vers, ln);
+
+	if (ok.empty())
+	{
+		const char * body = TextScanner_GetBegin(s);
+		size_t chunk_size = max<size_t>(APT_CHUNK_MIN, (inEnd - body) / (WorkerPool_Concurrency() * 4));
+
+		vector<apt_chunk_t>	chunks;
+		for (const char * b = body; b < inEnd; b = chunks.back().end)
+			chunks.push_back(apt_chunk_t(b, (inEnd - b > chunk_size) ? next_airport_line(b + chunk_size, inEnd) : inEnd));
+
+		WorkerPool_ParallelFor(chunks.size(), [&](int n) {
+			apt_chunk_t& c = chunks[n];
+			// AptInfo_t can't move cheaply, so growing the vector would copy every airport - size it up front instead.
+			int apt_count = 0;
+			for (const char * p = c.begin; p < c.end; p = next_airport_line(p, c.end))
+				++apt_count;
+			c.apts.reserve(apt_count);
+			c.err = ReadAptRecords(c.begin, c.end, vers, c.apts, c.lines, c.done, c.warnings);
+			for_each(c.apts.begin(), c.apts.end(), [](AptInfo_t& a) { CalcAptBounds(&a); });
+		});
+
+		// Keep everything up to the first chunk that stopped early - exactly what one pass over the file would have read.
+		size_t total = 0;
+		for (vector<apt_chunk_t>::iterator c = chunks.begin(); c != chunks.end(); ++c)
+			total += c->apts.size();
+		outApts.reserve(total);
+		for (vector<apt_chunk_t>::iterator c = chunks.begin(); c != chunks.end(); ++c)
+		{
+			fputs(c->warnings.c_str(), stdout);
+			ln += c->lines;
+			outApts.insert(outApts.end(), make_move_iterator(c->apts.begin()), make_move_iterator(c->apts.end()));
+			if (!c->err.empty() || c->done)
+			{
+				ok = c->err;
+				break;
+			}
+		}
+	}
+	TextScanner_Close(s);
+
+	if (!ok.empty())
+	{
+		char buf[50];
+		sprintf(buf," (Line %d)",ln);
+		ok += buf;
+	}
+
+	#if OPENGL_MAP
+	for (AptVector::iterator a = outApts.begin(); a != outApts.end(); ++a)
+		GenerateOGL(&*a);
+	#endif
+	return ok;
+}
+
+// Parses the records of [inBegin, inEnd), which is either everything after the header or a piece of it starting at
+// an airport header.  Stops at the first error or the 99 record; ln counts the lines consumed.
+static string	ReadAptRecords(const char * inBegin, const char * inEnd, int vers, AptVector& outApts, int& ln, bool& forceDone, string& warnings)
+{
+	MFTextScanner * s = TextScanner_OpenMem(inBegin, inEnd);
+	string ok;
 
 	set<string>		centers;
 	string codez;
@@ -309,7 +599,6 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 	
 	AptEdgeBase_t *	last_edge = NULL;
 	
-	bool forceDone = false;
 	while (ok.empty() && !TextScanner_IsDone(s) && !forceDone)
 	{
 		int		rec_code;
@@ -320,7 +609,7 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 		AptPavement_t * rwy;
 		double p1x, p1y, p2x, p2y;
 
-		if (TextScanner_FormatScan(s, "i", &rec_code) != 1)
+		if (AptFieldScanner(s).i(rec_code).count() != 1)
 		{
 			TextScanner_Next(s);
 			++ln;
@@ -334,6 +623,7 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 			centers.clear();
 			hit_prob = false;
 			last_edge = NULL;
+			open_poly = NULL;
 			outApts.push_back(AptInfo_t());
 			if (TextScanner_FormatScan(s, "iiiiTT|",
 				&rec_code,
@@ -366,7 +656,7 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 				if (centers.count(lat_str) > 0)
 				{
 					hit_prob = true;
-					printf("WARNING: duplicate runway for airport '%s' %s: %s\n", outApts.back().icao.c_str(), outApts.back().name.c_str(), lat_str.c_str());
+					warnings += "WARNING: duplicate runway for airport '" + outApts.back().icao + "' " + outApts.back().name + ": " + lat_str + "\n";
 				}
 				centers.insert(lat_str);
 			}
@@ -509,7 +799,7 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 				if (centers.count(lat_str) > 0)
 				{
 					hit_prob = true;
-					printf("WARNING: duplicate runway for airport '%s' %s: %s\n", outApts.back().icao.c_str(), outApts.back().name.c_str(), lat_str.c_str());
+					warnings += "WARNING: duplicate runway for airport '" + outApts.back().icao + "' " + outApts.back().name + ": " + lat_str + "\n";
 				}
 				centers.insert(lat_str);
 			}
@@ -609,51 +899,37 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 		case apt_lin_seg:
 		case apt_rng_seg:
 			if (vers < 850) ok = "Error: new linear segments allowed before 850";
+			if (open_poly == NULL) { ok = "Error: straight segment outside of a taxiway, line or boundary."; break; }
 			codez.clear();
 			open_poly->push_back(AptLinearSegment_t());
-			if (TextScanner_FormatScan(s,"iddT|",
-				&open_poly->back().code,
-				&p1y,
-				&p1x,
-				&codez) < 3) ok = "Illegal straight segment";
+			if (AptFieldScanner(s).i(open_poly->back().code).d(p1y).d(p1x).rest(codez).count() < 3) ok = "Illegal straight segment";
 				open_poly->back().pt = POINT2(p1x, p1y);
 			parse_linear_codes(codez,&open_poly->back().attributes);
 			break;
 		case apt_lin_crv:
 		case apt_rng_crv:
 			if (vers < 850) ok = "Error: new curved segments allowed before 850";
+			if (open_poly == NULL) { ok = "Error: curved segment outside of a taxiway, line or boundary."; break; }
 			codez.clear();
 			open_poly->push_back(AptLinearSegment_t());
-			if (TextScanner_FormatScan(s,"iddddT|",
-				&open_poly->back().code,
-				&p1y,
-				&p1x,
-				&p2y,
-				&p2x,
-				&codez) < 5) ok = "Illegal curved segment";
+			if (AptFieldScanner(s).i(open_poly->back().code).d(p1y).d(p1x).d(p2y).d(p2x).rest(codez).count() < 5) ok = "Illegal curved segment";
 				open_poly->back().pt = POINT2(p1x, p1y);
 				open_poly->back().ctrl = POINT2(p2x, p2y);
 			parse_linear_codes(codez,&open_poly->back().attributes);
 			break;
 		case apt_end_seg:
 			if (vers < 850) ok = "Error: new end segments allowed before 850";
+			if (open_poly == NULL) { ok = "Error: straight end outside of a taxiway, line or boundary."; break; }
 			open_poly->push_back(AptLinearSegment_t());
-			if (TextScanner_FormatScan(s,"idd",
-				&open_poly->back().code,
-				&p1y,
-				&p1x) != 3) ok = "Illegal straight end.";
+			if (AptFieldScanner(s).i(open_poly->back().code).d(p1y).d(p1x).count() != 3) ok = "Illegal straight end.";
 				open_poly->back().pt = POINT2(p1x, p1y);
 			break;
 		case apt_end_crv:
 			if (vers < 850) ok = "Error: new end curves allowed before 850";
+			if (open_poly == NULL) { ok = "Error: curved end outside of a taxiway, line or boundary."; break; }
 			codez.clear();
 			open_poly->push_back(AptLinearSegment_t());
-			if (TextScanner_FormatScan(s,"idddd",
-				&open_poly->back().code,
-				&p1y,
-				&p1x,
-				&p2y,
-				&p2x) != 5) ok = "Illegal curved end";
+			if (AptFieldScanner(s).i(open_poly->back().code).d(p1y).d(p1x).d(p2y).d(p2x).count() != 5) ok = "Illegal curved end";
 			open_poly->back().pt = POINT2(p1x, p1y);
 			open_poly->back().ctrl = POINT2(p2x, p2y);
 			parse_linear_codes(codez,&open_poly->back().attributes);
@@ -887,13 +1163,9 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 			else {
 				outApts.back().taxi_route.nodes.push_back(AptRouteNode_t());
 				string flags;
-				if(TextScanner_FormatScan(s,"iddTiT|",
-					&rec_code,
-					&outApts.back().taxi_route.nodes.back().location.y_,
-					&outApts.back().taxi_route.nodes.back().location.x_,
-					&flags,
-					&outApts.back().taxi_route.nodes.back().id,
-					&outApts.back().taxi_route.nodes.back().name) < 5) ok = "illegal taxi node.";
+				AptRouteNode_t& node = outApts.back().taxi_route.nodes.back();
+				if(AptFieldScanner(s).i(rec_code).d(node.location.y_).d(node.location.x_).T(flags).i(node.id).rest(node.name).count() < 5)
+					ok = "illegal taxi node.";
 			}
 			break;
 		case apt_taxi_edge:
@@ -902,13 +1174,9 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 			else {
 				outApts.back().taxi_route.edges.push_back(AptRouteEdge_t());
 				string oneway_flag, runway_flag;
-				if(TextScanner_FormatScan(s,"iiiTTT|",
-					&rec_code,
-					&outApts.back().taxi_route.edges.back().src,
-					&outApts.back().taxi_route.edges.back().dst,
-					&oneway_flag,
-					&runway_flag,
-					&outApts.back().taxi_route.edges.back().name) < 5) ok = "Error: illegal taxi layout edge.";
+				AptRouteEdge_t& edge = outApts.back().taxi_route.edges.back();
+				if(AptFieldScanner(s).i(rec_code).i(edge.src).i(edge.dst).T(oneway_flag).T(runway_flag).rest(edge.name).count() < 5)
+					ok = "Error: illegal taxi layout edge.";
 				outApts.back().taxi_route.edges.back().oneway = oneway_flag == "oneway";
 				outApts.back().taxi_route.edges.back().runway = runway_flag == "runway";
 				outApts.back().taxi_route.edges.back().width = atc_width_E;
@@ -956,7 +1224,7 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 			else if (outApts.back().taxi_route.edges.empty()) ok = "Error: taxi taxi active zone without an edge.";
 			else {
 				string flags, runways;
-				if(TextScanner_FormatScan(s,"iTT", &rec_code, &flags, &runways) != 3) ok = "Error: illegal active zone record.";
+				if(AptFieldScanner(s).i(rec_code).T(flags).T(runways).count() != 3) ok = "Error: illegal active zone record.";
 				vector<string> runways_parsed;
 				tokenize_string(runways.begin(), runways.end(), back_inserter(runways_parsed), ',');
 				if(flags.find("departure") != flags.npos)
@@ -1108,66 +1376,229 @@ string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outAp
 		++ln;
 	}
 	TextScanner_Close(s);
+	return ok;
+}
+
+/************************************************************************************************************************
+ * INDEXED READING
+ ************************************************************************************************************************/
+
+#define APT_INDEX_VERSION	1
+
+// Parses one indexed byte range - normally exactly one airport.
+static string	ReadAptRange(const char * inBegin, const char * inEnd, int vers, AptVector& outApts, bool& outDone)
+{
+	int lines = 0;
+	string warnings;
+	outDone = false;
+	string ok = ReadAptRecords(inBegin, inEnd, vers, outApts, lines, outDone, warnings);
+	fputs(warnings.c_str(), stdout);
+	for_each(outApts.begin(), outApts.end(), [](AptInfo_t& a) { CalcAptBounds(&a); });
+	return ok;
+}
+
+static string	BuildAptFileIndex(const char * inBegin, const char * inEnd, AptFileIndex_t& outIndex)
+{
+	outIndex.airports.clear();
 
+	MFTextScanner * s = TextScanner_OpenMem(inBegin, inEnd);
+	int ln = 0;
+	string ok = ReadAptHeader(s, outIndex.version, ln);
+	const char * body = TextScanner_GetBegin(s);
+	TextScanner_Close(s);
 	if (!ok.empty())
+		return ok;
+
+	// The same cut points the chunked reader uses, one per airport.
+	vector<const char *>	starts;
+	for (const char * p = is_airport_header(body, inEnd) ? body : next_airport_line(body, inEnd); p < inEnd; p = next_airport_line(p, inEnd))
+		starts.push_back(p);
+	starts.push_back(inEnd);
+
+	int count = starts.size() - 1;
+	vector<AptFileIndexEntry_t>	entries(count);
+	vector<string>				errors(count);
+	vector<char>				done(count, 0);
+
+	const int per_job = 64;
+	WorkerPool_ParallelFor((count + per_job - 1) / per_job, [&](int j) {
+		for (int n = j * per_job; n < min(count, (j + 1) * per_job); ++n)
+		{
+			AptVector	apts;
+			bool		hit_done;
+			errors[n] = ReadAptRange(starts[n], starts[n+1], outIndex.version, apts, hit_done);
+			done[n] = hit_done;
+			if (!apts.empty())
+			{
+				entries[n].icao = apts.front().icao;
+				entries[n].name = apts.front().name;
+			}
+			entries[n].offset = starts[n] - inBegin;
+			entries[n].length = starts[n+1] - starts[n];
+			for (AptVector::iterator a = apts.begin(); a != apts.end(); ++a)
+				entries[n].bounds += a->bounds;
+		}
+	});
+
+	for (int n = 0; n < count; ++n)
 	{
-		char buf[50];
-		sprintf(buf," (Line %d)",ln);
-		ok += buf;
+		if (!errors[n].empty())
+			return errors[n] + " (airport " + entries[n].icao + ")";
+		outIndex.airports.push_back(entries[n]);
+		if (done[n])
+			break;
 	}
+	return ok;
+}
 
-	for (AptVector::iterator a = outApts.begin(); a != outApts.end(); ++a)
+static bool	LoadAptFileIndex(const string& inPath, const struct stat& inAptFile, AptFileIndex_t& outIndex)
+{
+	FILE * fi = fopen(inPath.c_str(), "r");
+	if (fi == NULL)
+		return false;
+
+	char			line[2048];
+	long long		size, mtime;
+	int				idx_vers, n, count = -1;
+
+	bool ok = fgets(line, sizeof(line), fi) &&
+		sscanf(line, "APTIDX %d %lld %lld %d", &idx_vers, &size, &mtime, &outIndex.version) == 4 &&
+		idx_vers == APT_INDEX_VERSION && size == inAptFile.st_size && mtime == inAptFile.st_mtime;
+
+	outIndex.airports.clear();
+	while (ok && fgets(line, sizeof(line), fi))
 	{
-		a->bounds = Bbox2();
-		if (a->tower.draw_obj != -1)
-			a->bounds = Bbox2(a->tower.location);
-		if(a->beacon.color_code != apt_beacon_none)
-			a->bounds += a->beacon.location;
-		for (int w = 0; w < a->windsocks.size(); ++w)
-			a->bounds += a->windsocks[w].location;
-		for (int r = 0; r < a->gates.size(); ++r)
-			a->bounds += a->gates[r].location;
-		for (AptPavementVector::iterator p = a->pavements.begin(); p != a->pavements.end(); ++p)
-		{
-			a->bounds +=  p->ends.source();
-			a->bounds +=  p->ends.target();
-		}
-		for (AptRunwayVector::iterator r = a->runways.begin(); r != a->runways.end(); ++r)
-		{
-			a->bounds +=  r->ends.source();
-			a->bounds +=  r->ends.target();
-		}
-		for(AptSealaneVector::iterator s = a->sealanes.begin(); s != a->sealanes.end(); ++s)
-		{
-			a->bounds +=  s->ends.source();
-			a->bounds +=  s->ends.target();
-		}
-		for(AptHelipadVector::iterator h = a->helipads.begin(); h != a->helipads.end(); ++h)
-			a->bounds +=  h->location;
+		if (sscanf(line, "END %d", &count) == 1)
+			break;
 
-		for(AptTaxiwayVector::iterator t = a->taxiways.begin(); t != a->taxiways.end(); ++t)
-		for(AptPolygon_t::iterator pt = t->area.begin(); pt != t->area.end(); ++pt)
+		AptFileIndexEntry_t e;
+		unsigned long long	off, len;
+		int					icao_b = -1, icao_e = -1;
+		if (sscanf(line, "%llu %llu %lf %lf %lf %lf %n%*s%n", &off, &len,
+				&e.bounds.p1.x_, &e.bounds.p1.y_, &e.bounds.p2.x_, &e.bounds.p2.y_, &icao_b, &icao_e) < 6 || icao_e < 0)
 		{
-			a->bounds +=  pt->pt;
-			if(pt->code == apt_lin_crv || pt->code == apt_rng_crv || pt-> code == apt_end_crv)
-				a->bounds +=  pt->ctrl;
+			ok = false;
+			break;
 		}
+		e.offset = off;
+		e.length = len;
+		e.icao.assign(line + icao_b, line + icao_e);
+		n = icao_e;
+		if (line[n] == ' ') ++n;
+		e.name = line + n;
+		while (!e.name.empty() && (e.name[e.name.size()-1] == '\n' || e.name[e.name.size()-1] == '\r'))
+			e.name.erase(e.name.size()-1);
+		outIndex.airports.push_back(e);
+	}
+	fclose(fi);
+	return ok && count == outIndex.airports.size();
+}
 
-		for(AptBoundaryVector::iterator b = a->boundaries.begin(); b != a->boundaries.end(); ++b)
-		for(AptPolygon_t::iterator pt = b->area.begin(); pt != b->area.end(); ++pt)
-		{
-			a->bounds +=  pt->pt;
-			if(pt->code == apt_lin_crv || pt->code == apt_rng_crv || pt-> code == apt_end_crv)
-				a->bounds +=  pt->ctrl;
-		}
+static void	SaveAptFileIndex(const string& inPath, const struct stat& inAptFile, const AptFileIndex_t& inIndex)
+{
+	FILE * fo = fopen(inPath.c_str(), "w");
+	if (fo == NULL)
+		return;			// Read-only install - we just rebuild the index next time.
+
+	fprintf(fo, "APTIDX %d %lld %lld %d\n", APT_INDEX_VERSION, (long long) inAptFile.st_size, (long long) inAptFile.st_mtime, inIndex.version);
+	for (vector<AptFileIndexEntry_t>::const_iterator e = inIndex.airports.begin(); e != inIndex.airports.end(); ++e)
+		fprintf(fo, "%llu %llu %.17g %.17g %.17g %.17g %s %s\n", (unsigned long long) e->offset, (unsigned long long) e->length,
+			e->bounds.p1.x_, e->bounds.p1.y_, e->bounds.p2.x_, e->bounds.p2.y_, e->icao.c_str(), e->name.c_str());
+	fprintf(fo, "END %d\n", (int) inIndex.airports.size());
+	if (fclose(fo) != 0)
+		FILE_delete_file(inPath.c_str(), false);
+}
+
+string	ReadAptFileIndex(const char * inFileName, AptFileIndex_t& outIndex)
+{
+	struct stat ss;
+	if (FILE_get_file_meta_data(inFileName, ss) != 0)
+		return string("could not stat ") + inFileName;
+
+	string idx_path = string(inFileName) + ".idx";
+	if (LoadAptFileIndex(idx_path, ss, outIndex))
+		return string();
+
+	MFMemFile * f = MemFile_Open(inFileName);
+	if (f == NULL) return string("memfile_open failed");
+	string err = BuildAptFileIndex(MemFile_GetBegin(f), MemFile_GetEnd(f), outIndex);
+	MemFile_Close(f);
+
+	if (err.empty())
+		SaveAptFileIndex(idx_path, ss, outIndex);
+	return err;
+}
+
+string	ReadAptFileSubset(const char * inFileName, const AptFileIndex_t& inIndex, const vector<int>& inEntries, AptVector& outApts)
+{
+	outApts.clear();
+	MFMemFile * f = MemFile_Open(inFileName);
+	if (f == NULL) return string("memfile_open failed");
 
-		//a->bounds.expand(0.001);
+	const char * file_begin = MemFile_GetBegin(f);
+	size_t file_size = MemFile_GetEnd(f) - file_begin;
 
-		#if OPENGL_MAP
-			GenerateOGL(&*a);
-		#endif
+	vector<AptVector>	apts(inEntries.size());
+	vector<string>		errors(inEntries.size());
+	WorkerPool_ParallelFor(inEntries.size(), [&](int n) {
+		const AptFileIndexEntry_t& e = inIndex.airports.at(inEntries[n]);
+		bool done;
+		if (e.offset + e.length > file_size)
+			errors[n] = "apt.dat index is out of date";
+		else
+			errors[n] = ReadAptRange(file_begin + e.offset, file_begin + e.offset + e.length, inIndex.version, apts[n], done);
+	});
+	MemFile_Close(f);
+
+	for (int n = 0; n < inEntries.size(); ++n)
+	{
+		if (!errors[n].empty())
+			return errors[n] + " (airport " + inIndex.airports[inEntries[n]].icao + ")";
+		outApts.insert(outApts.end(), make_move_iterator(apts[n].begin()), make_move_iterator(apts[n].end()));
 	}
-	return ok;
+	return string();
+}
+
+string	ReadAptFileSubset(const char * inFileName, const set<string>& inIDs, AptVector& outApts)
+{
+	outApts.clear();
+	AptFileIndex_t	idx;
+	string err = ReadAptFileIndex(inFileName, idx);
+	if (!err.empty())
+		return err;
+
+	vector<int>	entries;
+	for (int n = 0; n < idx.airports.size(); ++n)
+	if (inIDs.count(idx.airports[n].icao))
+		entries.push_back(n);
+
+	AptVector	apts;
+	err = ReadAptFileSubset(inFileName, idx, entries, apts);
+	for (AptVector::iterator a = apts.begin(); a != apts.end(); ++a)
+	if (inIDs.count(a->icao))
+		outApts.push_back(*a);
+	return err;
+}
+
+string	ReadAptFileSubset(const char * inFileName, const Bbox2& inBounds, AptVector& outApts)
+{
+	outApts.clear();
+	AptFileIndex_t	idx;
+	string err = ReadAptFileIndex(inFileName, idx);
+	if (!err.empty())
+		return err;
+
+	vector<int>	entries;
+	for (int n = 0; n < idx.airports.size(); ++n)
+	if (idx.airports[n].bounds.overlap(inBounds))
+		entries.push_back(n);
+
+	AptVector	apts;
+	err = ReadAptFileSubset(inFileName, idx, entries, apts);
+	for (AptVector::iterator a = apts.begin(); a != apts.end(); ++a)
+	if (a->bounds.overlap(inBounds))
+		outApts.push_back(*a);
+	return err;
 }
 
 bool	WriteAptFile(const char * inFileName, const AptVector& inApts, int version)
@@ -1185,349 +1616,358 @@ bool	WriteAptFile(const char * inFileName, const AptVector& inApts, int version)
 }
 
 
-bool	WriteAptFileOpen(FILE * fi, const AptVector& inApts, int version)
+// Formats one airport, everything from the blank line ahead of its header to its last record.
+static void	FormatAptRecords(AptRecordWriter& w, const AptInfo_t * apt, int version)
 {
-	return WriteAptFileProcs((int (*)(void *, const char *,...))fprintf,fi,inApts,version);
-}
-
-bool	WriteAptFileProcs(int (* fprintf)(void * fi, const char * fmt, ...), void * fi, const AptVector& inApts, int version)
-{
-	DebugAssert(version == 850 || version == 1000 || version == 1050 || version == 1100 || version == 1130);
-	fprintf(fi, "%c" CRLF, APL ? 'A' : 'I');
-#if TYLER_MODE
-	fprintf(fi, "%d Generated by WorldEditor %s / TY mode" CRLF, version, WED_VERSION_STRING);
-#else
-	fprintf(fi, "%d Generated by WorldEditor %s" CRLF, version, WED_VERSION_STRING);
-#endif
-
 	bool has_atc = (version >= 1000);
 	bool has_atc2 = (version >= 1050);
 	bool has_atc3 = (version >= 1100);
 
-	for (AptVector::const_iterator apt = inApts.begin(); apt != inApts.end(); ++apt)
+	w.eol();
+	w.i(apt->kind_code).c(' ').i(apt->elevation_ft, 6).c(' ').i(version < 1000 ? apt->has_atc_twr : 0).c(' ').i(apt->default_buildings)
+	 .c(' ').s(apt->icao).c(' ').s(apt->name).eol();
+
+	for(int i = 0; i < apt->meta_data.size(); ++i)
 	{
-		fprintf(fi, CRLF);
-		fprintf(fi, "%d %6d %d %d %s %s" CRLF, apt->kind_code, apt->elevation_ft,
-				version < 1000 ? apt->has_atc_twr : 0, apt->default_buildings,
-				apt->icao.c_str(), apt->name.c_str());
-		
-		for(int i = 0; i < apt->meta_data.size(); ++i)
-		{
 #if TYLER_MODE
-			if(apt->meta_data.at(i).second.empty()) continue;
+		if(apt->meta_data.at(i).second.empty()) continue;
 #endif
-			string key = apt->meta_data.at(i).first;
-			string value = apt->meta_data.at(i).second;
-			
-			if (key == "faa_code"  ||
-				key == "iata_code" ||
-				key == "icao_code" ||
-				key == "region_code")
-			{
-				//Convert each to
-				::transform(value.begin(), value.end(), value.begin(), ::toupper);
-			}
-			
-			fprintf(fi, "%d %s %s" CRLF, apt_meta_data, key.c_str(), value.c_str());
-		}
+		const string& key = apt->meta_data.at(i).first;
+		string value = apt->meta_data.at(i).second;
 
-		for (AptRunwayVector::const_iterator rwy = apt->runways.begin(); rwy != apt->runways.end(); ++rwy)
+		if (key == "faa_code"  ||
+			key == "iata_code" ||
+			key == "icao_code" ||
+			key == "region_code")
 		{
-			fprintf(fi,"%d %4.2f %d %d %.2f %d %d %d "
-						"%3s" LLFMT " %.0f %.0f %d %d %d %d "
-						"%s" LLFMT " %.0f %.0f %d %d %d %d" CRLF,
-						apt_rwy_new, rwy->width_mtr, rwy->surf_code, rwy->shoulder_code, rwy->roughness_ratio, rwy->has_centerline, rwy->edge_light_code, rwy->has_distance_remaining,
-						rwy->id[0].c_str(),CGAL2DOUBLE(rwy->ends.source().y()),CGAL2DOUBLE(rwy->ends.source().x()), rwy->disp_mtr[0],rwy->blas_mtr[0], rwy->marking_code[0],rwy->app_light_code[0], rwy->has_tdzl[0], rwy->reil_code[0],
-						rwy->id[1].c_str(),CGAL2DOUBLE(rwy->ends.target().y()),CGAL2DOUBLE(rwy->ends.target().x()), rwy->disp_mtr[1],rwy->blas_mtr[1], rwy->marking_code[1],rwy->app_light_code[1], rwy->has_tdzl[1], rwy->reil_code[1]);
+			//Convert each to
+			::transform(value.begin(), value.end(), value.begin(), ::toupper);
 		}
 
-		for(AptSealaneVector::const_iterator sea = apt->sealanes.begin(); sea != apt->sealanes.end(); ++sea)
-		{
-			fprintf(fi,"%d %4.2f %d %s" LLFMT2 " %s" LLFMT2 CRLF,
-					apt_sea_new, sea->width_mtr, sea->has_buoys,
-					sea->id[0].c_str(), CGAL2DOUBLE(sea->ends.source().y()), CGAL2DOUBLE(sea->ends.source().x()),
-					sea->id[1].c_str(), CGAL2DOUBLE(sea->ends.target().y()), CGAL2DOUBLE(sea->ends.target().x()));
-		}
+		w.i(apt_meta_data).c(' ').s(key).c(' ').s(value).eol();
+	}
 
-		for (AptPavementVector::const_iterator pav = apt->pavements.begin(); pav != apt->pavements.end(); ++pav)
+	// "%d %4.2f %d %d %.2f %d %d %d" then per end "%3s" LLFMT " %.0f %.0f %d %d %d %d" ("%s" for the second end)
+	for (AptRunwayVector::const_iterator rwy = apt->runways.begin(); rwy != apt->runways.end(); ++rwy)
+	{
+		w.i(apt_rwy_new).c(' ').f(rwy->width_mtr, 2, 4).c(' ').i(rwy->surf_code).c(' ').i(rwy->shoulder_code).c(' ').f(rwy->roughness_ratio, 2)
+		 .c(' ').i(rwy->has_centerline).c(' ').i(rwy->edge_light_code).c(' ').i(rwy->has_distance_remaining);
+		for(int e = 0; e < 2; ++e)
 		{
-			double heading, len;
-			POINT2	center;
-			EndsToCenter(pav->ends, center, len, heading);
-			fprintf(fi,"%d" LLFMT " %s %.1lf %6.0lf %4d.%04d %4d.%04d %4.0f "
-					   "%d%d%d%d%d%d %02d %d %d %3.2f %d %3d.%03d" CRLF, apt_rwy_old,
-				CGAL2DOUBLE(center.y()), CGAL2DOUBLE(center.x()), pav->name.c_str(), heading, len * MTR_TO_FT,
-				pav->disp1_ft, pav->disp2_ft, pav->blast1_ft, pav->blast2_ft, pav->width_ft,
-				pav->vap_lites_code1,
-				pav->edge_lites_code1,
-				pav->app_lites_code1,
-				pav->vap_lites_code2,
-				pav->edge_lites_code2,
-				pav->app_lites_code2,
-				pav->surf_code,
-				pav->shoulder_code,
-				pav->marking_code,
-				pav->roughness_ratio, pav->distance_markings, pav->vasi_angle1, pav->vasi_angle2);
+			Point2 p = e ? rwy->ends.target() : rwy->ends.source();
+			w.c(' ').s(rwy->id[e], e ? 0 : 3).ll(CGAL2DOUBLE(p.y()), CGAL2DOUBLE(p.x()))
+			 .c(' ').f(rwy->disp_mtr[e], 0).c(' ').f(rwy->blas_mtr[e], 0).c(' ').i(rwy->marking_code[e]).c(' ').i(rwy->app_light_code[e])
+			 .c(' ').i(rwy->has_tdzl[e]).c(' ').i(rwy->reil_code[e]);
 		}
+		w.eol();
+	}
 
+	// "%d %4.2f %d %s" LLFMT2 " %s" LLFMT2
+	for(AptSealaneVector::const_iterator sea = apt->sealanes.begin(); sea != apt->sealanes.end(); ++sea)
+	{
+		w.i(apt_sea_new).c(' ').f(sea->width_mtr, 2, 4).c(' ').i(sea->has_buoys)
+		 .c(' ').s(sea->id[0]).ll2(CGAL2DOUBLE(sea->ends.source().y()), CGAL2DOUBLE(sea->ends.source().x()))
+		 .c(' ').s(sea->id[1]).ll2(CGAL2DOUBLE(sea->ends.target().y()), CGAL2DOUBLE(sea->ends.target().x())).eol();
+	}
 
-		for(AptHelipadVector::const_iterator heli = apt->helipads.begin(); heli != apt->helipads.end(); ++heli)
-		{
-			fprintf(fi,"%d %s" LLFMT " %.1lf %.2f %.2f %d %d %d %.2f %d" CRLF,
-				apt_heli_new, heli->id.c_str(), CGAL2DOUBLE(heli->location.y()), CGAL2DOUBLE(heli->location.x()), heli->heading, heli->length_mtr, heli->width_mtr,
-						heli->surface_code,heli->marking_code,heli->shoulder_code,heli->roughness_ratio,heli->edge_light_code);
-		}
+	// "%d" LLFMT " %s %.1lf %6.0lf %4d.%04d %4d.%04d %4.0f %d%d%d%d%d%d %02d %d %d %3.2f %d %3d.%03d"
+	for (AptPavementVector::const_iterator pav = apt->pavements.begin(); pav != apt->pavements.end(); ++pav)
+	{
+		double heading, len;
+		POINT2	center;
+		EndsToCenter(pav->ends, center, len, heading);
+		w.i(apt_rwy_old).ll(CGAL2DOUBLE(center.y()), CGAL2DOUBLE(center.x())).c(' ').s(pav->name).c(' ').f(heading, 1).c(' ').f(len * MTR_TO_FT, 0, 6)
+		 .c(' ').i(pav->disp1_ft, 4).c('.').i(pav->disp2_ft, 4, '0').c(' ').i(pav->blast1_ft, 4).c('.').i(pav->blast2_ft, 4, '0').c(' ').f(pav->width_ft, 0, 4)
+		 .c(' ').i(pav->vap_lites_code1).i(pav->edge_lites_code1).i(pav->app_lites_code1)
+		        .i(pav->vap_lites_code2).i(pav->edge_lites_code2).i(pav->app_lites_code2)
+		 .c(' ').i(pav->surf_code, 2, '0').c(' ').i(pav->shoulder_code).c(' ').i(pav->marking_code).c(' ').f(pav->roughness_ratio, 2, 3)
+		 .c(' ').i(pav->distance_markings).c(' ').i(pav->vasi_angle1, 3).c('.').i(pav->vasi_angle2, 3, '0').eol();
+	}
 
-		for (AptTaxiwayVector::const_iterator taxi = apt->taxiways.begin(); taxi != apt->taxiways.end(); ++taxi)
-		{
-			fprintf(fi, "%d %d %.2f %.1f" NFMT CRLF, apt_taxi_new, taxi->surface_code, taxi->roughness_ratio, taxi->heading N(taxi));
-			print_apt_poly(fprintf,fi,taxi->area, version);
-		}
+	// "%d %s" LLFMT " %.1lf %.2f %.2f %d %d %d %.2f %d"
+	for(AptHelipadVector::const_iterator heli = apt->helipads.begin(); heli != apt->helipads.end(); ++heli)
+	{
+		w.i(apt_heli_new).c(' ').s(heli->id).ll(CGAL2DOUBLE(heli->location.y()), CGAL2DOUBLE(heli->location.x()))
+		 .c(' ').f(heli->heading, 1).c(' ').f(heli->length_mtr, 2).c(' ').f(heli->width_mtr, 2)
+		 .c(' ').i(heli->surface_code).c(' ').i(heli->marking_code).c(' ').i(heli->shoulder_code).c(' ').f(heli->roughness_ratio, 2)
+		 .c(' ').i(heli->edge_light_code).eol();
+	}
 
-		for (AptBoundaryVector::const_iterator bound = apt->boundaries.begin(); bound != apt->boundaries.end(); ++bound)
-		{
-			fprintf(fi, "%d" NFMT CRLF, apt_boundary N(bound));
-			print_apt_poly(fprintf,fi,bound->area, version);
-		}
+	for (AptTaxiwayVector::const_iterator taxi = apt->taxiways.begin(); taxi != apt->taxiways.end(); ++taxi)
+	{
+		w.i(apt_taxi_new).c(' ').i(taxi->surface_code).c(' ').f(taxi->roughness_ratio, 2).c(' ').f(taxi->heading, 1).name(taxi->name).eol();
+		write_apt_poly(w, taxi->area, version);
+	}
 
-		for (AptMarkingVector::const_iterator lin = apt->lines.begin(); lin != apt->lines.end(); ++lin)
-		{
-			fprintf(fi, "%d" NFMT CRLF, apt_free_chain N(lin));
-			print_apt_poly(fprintf,fi,lin->area, version);
-		}
+	for (AptBoundaryVector::const_iterator bound = apt->boundaries.begin(); bound != apt->boundaries.end(); ++bound)
+	{
+		w.i(apt_boundary).name(bound->name).eol();
+		write_apt_poly(w, bound->area, version);
+	}
+
+	for (AptMarkingVector::const_iterator lin = apt->lines.begin(); lin != apt->lines.end(); ++lin)
+	{
+		w.i(apt_free_chain).name(lin->name).eol();
+		write_apt_poly(w, lin->area, version);
+	}
+
+	for (AptLightVector::const_iterator light = apt->lights.begin(); light != apt->lights.end(); ++light)
+	{
+		w.i(apt_papi).ll(CGAL2DOUBLE(light->location.y()), CGAL2DOUBLE(light->location.x())).c(' ').i(light->light_code)
+		 .c(' ').f(light->heading, 1).c(' ').f(light->angle, 2).name(light->name).eol();
+	}
 
-		for (AptLightVector::const_iterator light = apt->lights.begin(); light != apt->lights.end(); ++light)
+	for (AptSignVector::const_iterator sign = apt->signs.begin(); sign != apt->signs.end(); ++sign)
+	{
+		w.i(apt_sign).ll(CGAL2DOUBLE(sign->location.y()), CGAL2DOUBLE(sign->location.x())).c(' ').f(sign->heading, 1)
+		 .c(' ').i(sign->style_code).c(' ').i(sign->size_code).c(' ').s(sign->text).eol();
+	}
+
+	if (apt->tower.draw_obj != -1)
+		w.i(apt_tower_loc).ll2(CGAL2DOUBLE(apt->tower.location.y()), CGAL2DOUBLE(apt->tower.location.x()))
+		 .c(' ').f(apt->tower.height_ft, 0).c(' ').i(apt->tower.draw_obj).name(apt->name).eol();
+
+	for (AptGateVector::const_iterator gate = apt->gates.begin(); gate != apt->gates.end(); ++gate)
+	{
+		if((gate->type == atc_ramp_misc && gate->equipment == atc_traffic_all) || gate->equipment == 0 || !has_atc)
 		{
-			fprintf(fi,"%d" LLFMT " %d %.1lf %.2f" NFMT CRLF,
-					apt_papi, CGAL2DOUBLE(light->location.y()), CGAL2DOUBLE(light->location.x()), light->light_code,
-					light->heading, light->angle N(light));
+			w.i(apt_startup_loc).ll(CGAL2DOUBLE(gate->location.y()), CGAL2DOUBLE(gate->location.x()))
+			 .c(' ').f(gate->heading, 1).c(' ').s(gate->name).eol();
 		}
-
-		for (AptSignVector::const_iterator sign = apt->signs.begin(); sign != apt->signs.end(); ++sign)
+		else
 		{
-			fprintf(fi,"%d" LLFMT " %.1lf %d %d %s" CRLF,
-					apt_sign, CGAL2DOUBLE(sign->location.y()), CGAL2DOUBLE(sign->location.x()), sign->heading,
-					sign->style_code, sign->size_code, sign->text.c_str());
+			//--1300 lat lon heading misc|gate|tie_down|hangar traffic name
+			w.i(apt_startup_loc_new).ll2(CGAL2DOUBLE(gate->location.y()), CGAL2DOUBLE(gate->location.x()))
+			 .c(' ').f(gate->heading, 1).c(' ').s(ramp_type_strings[gate->type]).c(' ');
+			write_bitfields(w, gate->equipment, equip_strings);
+			w.c(' ').s(gate->name).eol();
+
+			if(has_atc2)
+			{
+				//--1301 size ramp_operation_type airlines-------------------
+				//Ex:1301 E 3 air del chl <- made up space seperated lines
+				w.i(apt_startup_loc_extended, 2).c(' ').c('A' + gate->width).c(' ').s(ramp_operation_type_strings[gate->ramp_op_type]).c(' ')
+				 .s(gate->airlines).eol();
+			}
 		}
+	}
 
+	if (apt->beacon.color_code != apt_beacon_none)
+		w.i(apt_beacon).ll(CGAL2DOUBLE(apt->beacon.location.y()), CGAL2DOUBLE(apt->beacon.location.x()))
+		 .c(' ').i(apt->beacon.color_code).name(apt->name).eol();
 
-		if (apt->tower.draw_obj != -1)
-			fprintf(fi, "%d" LLFMT2 " %.0f %d" NFMT CRLF, apt_tower_loc,
-				CGAL2DOUBLE(apt->tower.location.y()), CGAL2DOUBLE(apt->tower.location.x()), apt->tower.height_ft,
-				apt->tower.draw_obj N(apt));
+	for (AptWindsockVector::const_iterator sock = apt->windsocks.begin(); sock != apt->windsocks.end(); ++sock)
+	{
+		w.i(apt_windsock).ll(CGAL2DOUBLE(sock->location.y()), CGAL2DOUBLE(sock->location.x())).c(' ').i(sock->lit).name(sock->name).eol();
+	}
+
+	for (AptATCFreqVector::const_iterator atc = apt->atc.begin(); atc != apt->atc.end(); ++atc)
+	{
+		if(version < 1130)
+			w.i(atc->atc_type, 2).c(' ').i(atc->freq / 10, 5).c(' ').s(atc->name).eol();
+		else
+			w.i(atc->atc_type + (apt_freq_awos_1k-apt_freq_awos), 2).c(' ').i(atc->freq, 6).c(' ').s(atc->name).eol();
+	}
 
-		for (AptGateVector::const_iterator gate = apt->gates.begin(); gate != apt->gates.end(); ++gate)
+	if(has_atc)
+	{
+		for(AptFlowVector::const_iterator flow = apt->flows.begin(); flow != apt->flows.end(); ++flow)
 		{
-			if((gate->type == atc_ramp_misc && gate->equipment == atc_traffic_all) || gate->equipment == 0 || !has_atc)
+			w.i(apt_flow_def, 2).c(' ').s(flow->name).eol();
+
+			for(AptWindRuleVector::const_iterator wind = flow->wind_rules.begin(); wind != flow->wind_rules.end(); ++wind)
+				w.i(apt_flow_wind, 2).c(' ').s(wind->icao).c(' ').i(wind->dir_lo_degs_mag, 3, '0').c(' ').i(wind->dir_hi_degs_mag, 3, '0')
+				 .c(' ').i(wind->max_speed_knots).eol();
+
+			w.i(apt_flow_ceil, 2).c(' ').s(flow->icao).c(' ').i(flow->ceiling_ft).eol();
+
+			w.i(apt_flow_vis, 2).c(' ').s(flow->icao).c(' ').f(flow->visibility_sm, 1).eol();
+
+			for(AptTimeRuleVector::const_iterator time = flow->time_rules.begin(); time != flow->time_rules.end(); ++time)
+				w.i(apt_flow_time, 2).c(' ').i(time->start_zulu, 4, '0').c(' ').i(time->end_zulu, 4, '0').eol();
+
+			if(!flow->pattern_runway.empty() && flow->pattern_side)
 			{
-				fprintf(fi, "%d" LLFMT " %.1f %s" CRLF, apt_startup_loc,
-					CGAL2DOUBLE(gate->location.y()), CGAL2DOUBLE(gate->location.x()), gate->heading, gate->name.c_str());
+				w.i(apt_flow_pattern, 2, '0').c(' ').s(flow->pattern_runway).c(' ');
+				write_bitfields(w, flow->pattern_side, pattern_strings);
+				w.eol();
 			}
-			else
+
+			for(AptRunwayRuleVector::const_iterator	rule = flow->runway_rules.begin(); rule != flow->runway_rules.end(); ++rule)
 			{
-				//--1300 lat lon heading misc|gate|tie_down|hangar traffic name
-				fprintf(fi, "%d" LLFMT2 " %.1f %s ", 
-					apt_startup_loc_new, //1300
-					CGAL2DOUBLE(gate->location.y()),//lat
-					CGAL2DOUBLE(gate->location.x()),//lon
-					gate->heading,//heading
-					ramp_type_strings[gate->type]//human readable ramp type name
-				);
-				print_bitfields(fprintf,fi,gate->equipment, equip_strings);
-			
-				fprintf(fi, " %s" CRLF, gate->name.c_str()); //name
-				//-------------------------------------------------------------
-
-				if(has_atc2)
-				{
-					//--1301 size ramp_operation_type airlines-------------------
-					//Ex:1301 E 3 air del chl <- made up space seperated lines
-					fprintf(fi, "%2d %c %s ",
-						apt_startup_loc_extended,//1301
-						'A' + gate->width,//size
-						ramp_operation_type_strings[gate->ramp_op_type]//human readable ramp_operation_type
-					);
-
-					if(gate->airlines.empty() == false)
-					{
-						fprintf(fi,"%s", gate->airlines.c_str());
-					}
-				
-					fputs(CRLF, (FILE *) fi);//Row is over
-					//---------------------------------------------------------
-				}
+				if(version < 1130)
+					w.i(apt_flow_rwy_rule, 2).c(' ').s(rule->runway).c(' ').i(rule->dep_freq / 10, 5).c(' ');
+				else
+					w.i(apt_flow_rwy_rule1k, 2).c(' ').s(rule->runway).c(' ').i(rule->dep_freq, 6).c(' ');
+				write_bitfields(w, rule->operations, op_strings);
+				w.c(' ');
+				write_bitfields(w, rule->equipment, equip_strings);
+				w.c(' ').i(rule->dep_heading_lo, 3, '0').i(rule->dep_heading_hi, 3, '0')
+				 .c(' ').i(rule->ini_heading_lo, 3, '0').i(rule->ini_heading_hi, 3, '0').name(rule->name).eol();
 			}
 		}
 
-		if (apt->beacon.color_code != apt_beacon_none)
-			fprintf(fi, "%d" LLFMT " %d" NFMT CRLF, apt_beacon,CGAL2DOUBLE( apt->beacon.location.y()),
-				CGAL2DOUBLE(apt->beacon.location.x()), apt->beacon.color_code N(apt));
-
-		for (AptWindsockVector::const_iterator sock = apt->windsocks.begin(); sock != apt->windsocks.end(); ++sock)
+		//If we have airplane taxi edges or service roads edges
+		if (!apt->taxi_route.edges.empty() || !apt->taxi_route.service_roads.empty())
 		{
-			fprintf(fi, "%d" LLFMT " %d" NFMT CRLF, apt_windsock, CGAL2DOUBLE(sock->location.y()), CGAL2DOUBLE(sock->location.x()),
-				sock->lit N(sock));
-		}
+			//write taxi route network name
+			w.i(apt_taxi_header, 2).c(' ').s(apt->taxi_route.name).eol();
 
-		for (AptATCFreqVector::const_iterator atc = apt->atc.begin(); atc != apt->atc.end(); ++atc)
-		{
-			if(version < 1130)
-				fprintf(fi, "%2d %5d %s" CRLF, atc->atc_type, atc->freq / 10, atc->name.c_str());
-			else
-				fprintf(fi, "%2d %6d %s" CRLF, atc->atc_type + (apt_freq_awos_1k-apt_freq_awos), atc->freq, atc->name.c_str());
-			
+			//write all nodes in network
+			for (vector<AptRouteNode_t>::const_iterator n = apt->taxi_route.nodes.begin();
+				n != apt->taxi_route.nodes.end();
+				++n)
+			{
+				w.i(apt_taxi_node).ll2(n->location.y(), n->location.x()).s(" both ").i(n->id).name(n->name).eol();
+			}
 		}
 
-		if(has_atc)
+		//If we have any, write all edges
+		if (!apt->taxi_route.edges.empty())
 		{
-			for(AptFlowVector::const_iterator flow = apt->flows.begin(); flow != apt->flows.end(); ++flow)
+			for(vector<AptRouteEdge_t>::const_iterator e = apt->taxi_route.edges.begin(); e != apt->taxi_route.edges.end(); ++e)
 			{
-				fprintf(fi,"%2d %s" CRLF, apt_flow_def, flow->name.c_str());
-				
-				for(AptWindRuleVector::const_iterator wind = flow->wind_rules.begin(); wind != flow->wind_rules.end(); ++wind)
-					fprintf(fi,"%2d %s %03d %03d %d" CRLF, apt_flow_wind, wind->icao.c_str(), wind->dir_lo_degs_mag, wind->dir_hi_degs_mag, wind->max_speed_knots);
-				
-				fprintf(fi,"%2d %s %d" CRLF, apt_flow_ceil, flow->icao.c_str(), flow->ceiling_ft);
-				
-				fprintf(fi,"%2d %s %.1f" CRLF, apt_flow_vis, flow->icao.c_str(), flow->visibility_sm);
-				
-				for(AptTimeRuleVector::const_iterator time = flow->time_rules.begin(); time != flow->time_rules.end(); ++time)
-					fprintf(fi,"%2d %04d %04d" CRLF, apt_flow_time, time->start_zulu, time->end_zulu);
-
-				if(!flow->pattern_runway.empty() && flow->pattern_side)
+				w.i(apt_taxi_edge, 2).c(' ').i(e->src).c(' ').i(e->dst).c(' ').s(e->oneway ? "oneway" : "twoway").c(' ');
+				if(e->runway)
+					w.s("runway");
+				else
 				{
-					fprintf(fi,"%02d %s ", apt_flow_pattern, flow->pattern_runway.c_str());
-					print_bitfields(fprintf,fi,flow->pattern_side,pattern_strings);
-					fprintf(fi,CRLF);
+					w.s("taxiway");
+					if(has_atc2)
+						w.c('_').c('A' + e->width);
 				}
+				w.c(' ').s(e->name).eol();
 
-				for(AptRunwayRuleVector::const_iterator	rule = flow->runway_rules.begin(); rule != flow->runway_rules.end(); ++rule)
+#if HAS_CURVED_ATC_ROUTE
+				for(vector<pair<Point2,bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
+					w.i((s->second && has_atc3) ? apt_taxi_control : apt_taxi_shape).ll2(s->first.y(), s->first.x()).eol();
+#else
+				for(vector<pair<Point2,bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
+					w.i(apt_taxi_shape).ll2(s->first.y(), s->first.x()).eol();
+#endif
+				if(!e->hot_depart.empty())
 				{
-					if(version < 1130)
-						fprintf(fi,"%2d %s %5d ",apt_flow_rwy_rule, rule->runway.c_str(), rule->dep_freq / 10);
-					else
-						fprintf(fi,"%2d %s %6d ",apt_flow_rwy_rule1k, rule->runway.c_str(), rule->dep_freq);
-					print_bitfields(fprintf,fi,rule->operations, op_strings);
-					fprintf(fi," ");
-					print_bitfields(fprintf,fi,rule->equipment, equip_strings);
-					fprintf(fi," %03d%03d %03d%03d" NFMT CRLF, rule->dep_heading_lo, rule->dep_heading_hi, rule->ini_heading_lo, rule->ini_heading_hi N(rule));
+					w.i(apt_taxi_active, 2).s(" departure");
+					for(set<string>::const_iterator s = e->hot_depart.begin(); s != e->hot_depart.end(); ++s)
+						w.c(s == e->hot_depart.begin() ? ' ' : ',').s(*s);
+					w.eol();
 				}
-			}
-
-			//If we have airplane taxi edges or service roads edges
-			if (!apt->taxi_route.edges.empty() || !apt->taxi_route.service_roads.empty())
-			{
-				//write taxi route network name
-				fprintf(fi, "%2d %s" CRLF, apt_taxi_header, apt->taxi_route.name.c_str());
-
-				//write all nodes in network
-				for (vector<AptRouteNode_t>::const_iterator n = apt->taxi_route.nodes.begin();
-					n != apt->taxi_route.nodes.end();
-					++n)
+				if(!e->hot_arrive.empty())
 				{
-					fprintf(fi, "%d" LLFMT2 " both %d" NFMT CRLF, apt_taxi_node, n->location.y(), n->location.x(), n->id N(n));
+					w.i(apt_taxi_active, 2).s(" arrival");
+					for(set<string>::const_iterator s = e->hot_arrive.begin(); s != e->hot_arrive.end(); ++s)
+						w.c(s == e->hot_arrive.begin() ? ' ' : ',').s(*s);
+					w.eol();
 				}
-			}
-
-			//If we have any, write all edges
-			if (!apt->taxi_route.edges.empty())
-			{
-				for(vector<AptRouteEdge_t>::const_iterator e = apt->taxi_route.edges.begin(); e != apt->taxi_route.edges.end(); ++e)
+				if(!e->hot_ils.empty())
 				{
-					fprintf(fi,"%2d %d %d %s ", apt_taxi_edge, e->src, e->dst, e->oneway ? "oneway" : "twoway");
-					if(e->runway)
-						fprintf(fi,"runway");
-					else
-					{
-						fprintf(fi,"taxiway");
-						if(has_atc2)
-							fprintf(fi,"_%c", 'A' + e->width);
-					}
-					fprintf(fi," %s" CRLF, e->name.c_str());
-
-#if HAS_CURVED_ATC_ROUTE
-					for(vector<pair<Point2,bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
-						fprintf(fi,"%d" LLFMT2 CRLF, (s->second && has_atc3) ? apt_taxi_control : apt_taxi_shape, s->first.y(), s->first.x());
-#else
-					for(vector<pair<Point2,bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
-						fprintf(fi,"%d" LLFMT2 CRLF, apt_taxi_shape, s->first.y(), s->first.x());
-#endif
-					if(!e->hot_depart.empty())
-					{
-						fprintf(fi,"%2d departure", apt_taxi_active);
-						for(set<string>::const_iterator s = e->hot_depart.begin(); s != e->hot_depart.end(); ++s)
-							fprintf(fi,"%c%s", s == e->hot_depart.begin() ? ' ' : ',', s->c_str());
-						fprintf(fi,CRLF);
-					}
-					if(!e->hot_arrive.empty())
-					{
-						fprintf(fi,"%2d arrival", apt_taxi_active);
-						for(set<string>::const_iterator s = e->hot_arrive.begin(); s != e->hot_arrive.end(); ++s)
-							fprintf(fi,"%c%s", s == e->hot_arrive.begin() ? ' ' : ',', s->c_str());
-						fprintf(fi,CRLF);
-					}
-					if(!e->hot_ils.empty())
-					{
-						fprintf(fi,"%2d ils", apt_taxi_active);
-						for(set<string>::const_iterator s = e->hot_ils.begin(); s != e->hot_ils.end(); ++s)
-							fprintf(fi,"%c%s", s == e->hot_ils.begin() ? ' ' : ',', s->c_str());
-						fprintf(fi,CRLF);
-					}
+					w.i(apt_taxi_active, 2).s(" ils");
+					for(set<string>::const_iterator s = e->hot_ils.begin(); s != e->hot_ils.end(); ++s)
+						w.c(s == e->hot_ils.begin() ? ' ' : ',').s(*s);
+					w.eol();
 				}
 			}
-			
-			//If we have any, write all service roads
-			if (has_atc3)
+		}
+
+		//If we have any, write all service roads
+		if (has_atc3)
+		{
+			for (vector<AptServiceRoadEdge_t>::const_iterator e = apt->taxi_route.service_roads.begin(); e != apt->taxi_route.service_roads.end(); ++e)
 			{
-				for (vector<AptServiceRoadEdge_t>::const_iterator e = apt->taxi_route.service_roads.begin(); e != apt->taxi_route.service_roads.end(); ++e)
-				{
-					fprintf(fi, "%d %d %d %s" NFMT CRLF, apt_taxi_truck_edge, e->src, e->dst, e->oneway ? "oneway" : "twoway" N(e));
+				w.i(apt_taxi_truck_edge).c(' ').i(e->src).c(' ').i(e->dst).c(' ').s(e->oneway ? "oneway" : "twoway").name(e->name).eol();
 #if HAS_CURVED_ATC_ROUTE
-					for (vector<pair<Point2, bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
-						fprintf(fi, "%d" LLFMT2 CRLF, (s->second && has_atc3) ? apt_taxi_control : apt_taxi_shape, s->first.y(), s->first.x());
+				for (vector<pair<Point2, bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
+					w.i((s->second && has_atc3) ? apt_taxi_control : apt_taxi_shape).ll2(s->first.y(), s->first.x()).eol();
 #else
-					for (vector<pair<Point2, bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
-						fprintf(fi, "%d" LLFMT2 CRLF, apt_taxi_shape, s->first.y(), s->first.x());
+				for (vector<pair<Point2, bool> >::const_iterator s = e->shape.begin(); s != e->shape.end(); ++s)
+					w.i(apt_taxi_shape).ll2(s->first.y(), s->first.x()).eol();
 #endif
-				}
 			}
+		}
 
-			int num_service_truck_pieces = apt->truck_parking.size() + apt->truck_destinations.size();
+		if (has_atc3)
+		{
+			for (AptTruckParkingVector::const_iterator trk = apt->truck_parking.begin(); trk != apt->truck_parking.end(); ++trk)
+			{
+				//Don't export car count unless our type is baggage_train
+				int car_count = trk->parking_type == apt_truck_baggage_train ? trk->train_car_count : 0;
+
+				w.i(apt_truck_parking).ll2(trk->location.y_, trk->location.x_).c(' ').f(trk->heading, 1)
+				 .c(' ').s(truck_type_strings[trk->parking_type]).c(' ').i(car_count).name(trk->name).eol();
+			}
 
-			if (num_service_truck_pieces > 0)
+			for (AptTruckDestinationVector::const_iterator dst = apt->truck_destinations.begin(); dst != apt->truck_destinations.end(); ++dst)
 			{
-				if (has_atc3)
-				{
-					for (AptTruckParkingVector::const_iterator trk = apt->truck_parking.begin(); trk != apt->truck_parking.end(); ++trk)
-					{
-						//Don't export car count unless our type is baggage_train
-						int car_count = trk->parking_type == apt_truck_baggage_train ? trk->train_car_count : 0;
+				w.i(apt_truck_destination).ll2(dst->location.y_, dst->location.x_).c(' ').f(dst->heading, 1).c(' ');
 
-						fprintf(fi, "%d" LLFMT2 " %.1f %s %d" NFMT CRLF,
-							apt_truck_parking, trk->location.y_, trk->location.x_, trk->heading,
-							truck_type_strings[trk->parking_type], car_count N(trk));
-					}
-				}
-				
-				if (has_atc3)
+				for (set<int>::const_iterator tt = dst->truck_types.begin(); tt != dst->truck_types.end(); ++tt)
 				{
-					for (AptTruckDestinationVector::const_iterator dst = apt->truck_destinations.begin(); dst != apt->truck_destinations.end(); ++dst)
-					{
-						fprintf(fi, "%d" LLFMT2 " %.1f ",
-							apt_truck_destination, dst->location.y_, dst->location.x_, dst->heading);
-
-						for (set<int>::const_iterator tt = dst->truck_types.begin(); tt != dst->truck_types.end(); ++tt)
-						{
-							fprintf(fi, tt == dst->truck_types.begin() ? "%s" : "|%s",
-								truck_type_strings[*tt]);
-						}
-						fprintf(fi, NFMT CRLF N(dst));
-					}
+					if(tt != dst->truck_types.begin()) w.c('|');
+					w.s(truck_type_strings[*tt]);
 				}
+				w.name(dst->name).eol();
 			}
 		}
 	}
-	fprintf(fi, "%d" CRLF, apt_done);
+}
+
+// Airports are formatted on the worker pool a window at a time, then handed to the sink in file order, so
+// memory stays at one window of text no matter how big the file is.
+#define APT_WRITE_BATCH 64
+
+static void	WriteAptRecords(const AptVector& inApts, int version, const function<void(const char *, size_t)>& sink)
+{
+	DebugAssert(version == 850 || version == 1000 || version == 1050 || version == 1100 || version == 1130);
+
+	AptRecordWriter	w;
+	w.c(APL ? 'A' : 'I').eol();
+#if TYLER_MODE
+	w.i(version).s(" Generated by WorldEditor ").s(WED_VERSION_STRING).s(" / TY mode").eol();
+#else
+	w.i(version).s(" Generated by WorldEditor ").s(WED_VERSION_STRING).eol();
+#endif
+	sink(w.data(), w.size());
+
+	int total_jobs = (inApts.size() + APT_WRITE_BATCH - 1) / APT_WRITE_BATCH;
+	vector<AptRecordWriter>	jobs(min(total_jobs, WorkerPool_Concurrency() * 4));
+
+	for(int first = 0; first < total_jobs; first += jobs.size())
+	{
+		int window = min((int) jobs.size(), total_jobs - first);
+		WorkerPool_ParallelFor(window, [&](int j) {
+			jobs[j].clear();
+			int a = (first + j) * APT_WRITE_BATCH;
+			int e = min(a + APT_WRITE_BATCH, (int) inApts.size());
+			for(; a < e; ++a)
+				FormatAptRecords(jobs[j], &inApts[a], version);
+		});
+		for(int j = 0; j < window; ++j)
+			sink(jobs[j].data(), jobs[j].size());
+	}
+
+	w.clear();
+	w.i(apt_done).eol();
+	sink(w.data(), w.size());
+}
+
+bool	WriteAptFileOpen(FILE * fi, const AptVector& inApts, int version)
+{
+	WriteAptRecords(inApts, version, [fi](const char * p, size_t n) { fwrite(p, 1, n, fi); });
+	return true;
+}
+
+bool	WriteAptFileProcs(int (* fprintf)(void * fi, const char * fmt, ...), void * fi, const AptVector& inApts, int version)
+{
+	// Print procs may format into a fixed buffer (zip_printf does), so feed them the text a small piece at a time.
+	WriteAptRecords(inApts, version, [fprintf, fi](const char * p, size_t n) {
+		while(n > 0)
+		{
+			int k = min(n, (size_t) 1024);
+			fprintf(fi, "%.*s", k, p);
+			p += k;
+			n -= k;
+		}
+	});
 	return true;
 }
 
@@ -36,6 +36,27 @@ bool	ReadApts(XAtomContainer& container, AptVector& outApts);
 
 string	ReadAptFile(const char * inFileName, AptVector& outApts);
 string	ReadAptFileMem(const char * inBegin, const char * inEnd, AptVector& outApts);
+
+// Random access into big apt.dat files.  The index lives next to the apt.dat as <file>.idx; ReadAptFileIndex
+// loads it, or rebuilds it (and tries to save it) if it is missing or the apt.dat changed size or date since.
+// The subset readers parse only the byte ranges they need and give the same airports ReadAptFile would.
+struct AptFileIndexEntry_t {
+	string		icao;
+	string		name;
+	size_t		offset;			// Byte range of the airport's records, from its 1/16/17 header up to the next one.
+	size_t		length;
+	Bbox2		bounds;			// Same as AptInfo_t::bounds.
+};
+
+struct AptFileIndex_t {
+	int							version;	// apt.dat format version from the file header
+	vector<AptFileIndexEntry_t>	airports;
+};
+
+string	ReadAptFileIndex(const char * inFileName, AptFileIndex_t& outIndex);
+string	ReadAptFileSubset(const char * inFileName, const set<string>& inIDs, AptVector& outApts);
+string	ReadAptFileSubset(const char * inFileName, const Bbox2& inBounds, AptVector& outApts);
+string	ReadAptFileSubset(const char * inFileName, const AptFileIndex_t& inIndex, const vector<int>& inEntries, AptVector& outApts);
 bool	WriteAptFile(const char * inFileName, const AptVector& outApts, int version);  
 bool	WriteAptFileOpen(FILE * inFile, const AptVector& outApts, int version);
 bool	WriteAptFileProcs(int (* print_func)(void *, const char *, ...), void * ref, const AptVector& outApts, int version);
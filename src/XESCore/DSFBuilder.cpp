@@ -51,7 +51,7 @@
 #define TIMER(x)
 #endif
 
-DSFBuildPrefs_t	gDSFBuildPrefs = { 1 };
+DSFBuildPrefs_t	gDSFBuildPrefs = { 1, dsf_PatchPrims_Strip, 0 };
 
 #if PHONE
 	// Ben syas: 32x32 is definitely a good bucket size - when we go 16x16 our vertex count goes way up and fps tank.
@@ -1032,6 +1032,16 @@ set<int>					sLoResLU[PATCH_DIM_LO * PATCH_DIM_LO];
 	writer2 = inFileName2 ? ((inFileName1 && strcmp(inFileName1,inFileName2)==0) ? writer1 : DSFCreateWriter(inElevation.mWest, inElevation.mSouth, inElevation.mEast, inElevation.mNorth,use_min, use_max, DSF_DIVISIONS)) : NULL;
 	StNukeWriter	dontLeakWriter1(writer1);
 	StNukeWriter	dontLeakWriter2(writer2==writer1 ? NULL : writer2);
+	if(writer1)
+	{
+		DSFSetWriterPatchPrimitives(writer1, gDSFBuildPrefs.patch_primitives);
+		DSFSetWriterStats(writer1, gDSFBuildPrefs.print_stats);
+	}
+	if(writer2 && writer2 != writer1)
+	{
+		DSFSetWriterPatchPrimitives(writer2, gDSFBuildPrefs.patch_primitives);
+		DSFSetWriterStats(writer2, gDSFBuildPrefs.print_stats);
+	}
  	DSFGetWriterCallbacks(&cbs);
 
 	/****************************************************************
@@ -30,6 +30,8 @@
 
 struct	DSFBuildPrefs_t {
 	int	export_roads;
+	int	patch_primitives;		// dsf_PatchPrims_ mode for the base mesh
+	int	print_stats;			// Print primitive and command-byte stats for each DSF written
 };
 
 extern DSFBuildPrefs_t	gDSFBuildPrefs;
@@ -23,6 +23,8 @@
 #include "EnumSystem.h"
 #include "XChunkyFileUtils.h"
 #include "DEMDefs.h"	// For NO_DATA
+#include <atomic>
+#include <mutex>
 
 #define	TOKEN(x)		#x,
 #define EXTRACT_TOKENS 1
@@ -37,9 +39,118 @@
 #undef TOKEN
 #undef EXTRACT_TOKENS
 
+/************************************************************************************************************************
+ * CONCURRENT TOKEN TABLE
+ ************************************************************************************************************************
 
-TokenMap		gTokens;
-TokenReverseMap	gReverse;
+	Almost every XES algorithm looks up tokens, so the table has to be readable from many threads without a lock.
+
+	Forward map: strings are interned (copied once, never moved or freed) and their ptrs are kept in an append-only
+	array of fixed size chunks.  A writer fills in the slot and allocates chunks first, THEN publishes the new count
+	with a release store, so a reader that sees an id < count also sees its string.
+
+	Reverse map: an open-addressed hash table of token ids.  Slots go from empty (-1) to an id exactly once, except
+	that NewToken on an existing string repoints the slot to the newer id, same as the old map did.  Growing the table
+	builds a whole new one and swaps the ptr; the old tables are kept until InitEnumSystem since a reader may still be
+	walking them.
+
+	All writes go through sLock.
+
+ */
+
+enum {
+	kTokenChunkBits	= 10,
+	kTokenChunkSize	= 1 << kTokenChunkBits,
+	kTokenMaxChunks	= 4096						// 4M tokens - way more than any config we have ever seen.
+};
+
+struct token_hash_table {
+	int				mask;
+	atomic<int> *	slots;
+};
+
+static atomic<const char **>			sChunks[kTokenMaxChunks];
+static atomic<int>						sCount(0);
+static atomic<token_hash_table *>		sHash(NULL);
+static vector<token_hash_table *>		sRetiredHashes;
+static mutex							sLock;
+
+static inline unsigned int	token_hash(const char * s)
+{
+	unsigned int h = 2166136261u;							// FNV-1a
+	while(*s)
+	{
+		h ^= (unsigned char) *s++;
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static inline const char *	token_string(int id)
+{
+	return sChunks[id >> kTokenChunkBits].load(memory_order_relaxed)[id & (kTokenChunkSize-1)];
+}
+
+static token_hash_table *	make_hash_table(int capacity)
+{
+	token_hash_table * t = new token_hash_table;
+	t->mask = capacity - 1;
+	t->slots = new atomic<int>[capacity];
+	for(int n = 0; n < capacity; ++n)
+		t->slots[n].store(-1, memory_order_relaxed);
+	return t;
+}
+
+static void	free_hash_table(token_hash_table * t)
+{
+	delete [] t->slots;
+	delete t;
+}
+
+// Writer side - sLock must be held.  Points the string's slot at id, replacing an older id for the same string.
+static void	hash_insert_locked(token_hash_table * t, int id)
+{
+	const char * s = token_string(id);
+	unsigned int i = token_hash(s) & t->mask;
+	while(1)
+	{
+		int old = t->slots[i].load(memory_order_relaxed);
+		if(old == -1 || strcmp(token_string(old), s) == 0)
+		{
+			t->slots[i].store(id, memory_order_release);
+			return;
+		}
+		i = (i + 1) & t->mask;
+	}
+}
+
+// Writer side - sLock must be held.
+static int	add_token_locked(const char * inString)
+{
+	int id = sCount.load(memory_order_relaxed);
+	int chunk = id >> kTokenChunkBits;
+	Assert(chunk < kTokenMaxChunks);
+	if(sChunks[chunk].load(memory_order_relaxed) == NULL)
+		sChunks[chunk].store(new const char *[kTokenChunkSize], memory_order_relaxed);
+	sChunks[chunk].load(memory_order_relaxed)[id & (kTokenChunkSize-1)] = strdup(inString);
+	sCount.store(id+1, memory_order_release);
+
+	// Keep the load factor under 1/2 so probe runs stay short.
+	token_hash_table * t = sHash.load(memory_order_relaxed);
+	if(t == NULL || (id+1) * 2 > t->mask + 1)
+	{
+		int capacity = t ? (t->mask + 1) * 2 : 1024;
+		token_hash_table * bigger = make_hash_table(capacity);
+		for(int n = 0; n <= id; ++n)
+			hash_insert_locked(bigger, n);
+		sHash.store(bigger, memory_order_release);
+		if(t)
+			sRetiredHashes.push_back(t);
+	}
+	else
+		hash_insert_locked(t, id);
+	return id;
+}
 
 static bool ConfirmNotNumber(const char * t)
 {
@@ -56,33 +167,76 @@ static bool ConfirmNotNumber(const char * t)
 
 void InitEnumSystem()
 {
-	gTokens.clear();
+	lock_guard<mutex> guard(sLock);
+
+	int count = sCount.load(memory_order_relaxed);
+	for(int n = 0; n < count; ++n)
+		free((void *) token_string(n));
+	for(int c = 0; c < kTokenMaxChunks; ++c)
+	if(const char ** chunk = sChunks[c].load(memory_order_relaxed))
+	{
+		delete [] chunk;
+		sChunks[c].store(NULL, memory_order_relaxed);
+	}
+	sCount.store(0, memory_order_relaxed);
+
+	if(token_hash_table * t = sHash.load(memory_order_relaxed))
+		free_hash_table(t);
+	sHash.store(NULL, memory_order_relaxed);
+	for(vector<token_hash_table *>::iterator t = sRetiredHashes.begin(); t != sRetiredHashes.end(); ++t)
+		free_hash_table(*t);
+	sRetiredHashes.clear();
+
 	for (int i = 0; i < NUMBER_OF_DEFAULT_TOKENS; ++i)
-		gTokens.push_back(kDefaultTokens[i]);
-	BuildTokenReverseMap(gTokens, gReverse);
+		add_token_locked(kDefaultTokens[i]);
 }
 
 const char *	FetchTokenString(int x)
 {
 	if (x == DEM_NO_DATA) return "NO DATA";
-	if (x < 0 || x >= gTokens.size()) return "unknown token";
-	return gTokens[x].c_str();
+	if (x < 0 || x >= sCount.load(memory_order_acquire)) return "unknown token";
+	return token_string(x);
 }
 
 int				LookupToken(const char * inString)
 {
-	if (gTokens.size() != gReverse.size())
-		BuildTokenReverseMap(gTokens, gReverse);
-	TokenReverseMap::iterator i = gReverse.find(inString);
-	if (i == gReverse.end()) return -1;
-	return i->second;
+	token_hash_table * t = sHash.load(memory_order_acquire);
+	if (t == NULL) return -1;
+	unsigned int i = token_hash(inString) & t->mask;
+	while(1)
+	{
+		int id = t->slots[i].load(memory_order_acquire);
+		if (id == -1) return -1;
+		if (strcmp(token_string(id), inString) == 0) return id;
+		i = (i + 1) & t->mask;
+	}
 }
 
 int				LookupTokenCreate(const char * inString)
 {
 	int n = LookupToken(inString);
 	if (n != -1) return n;
-	return NewToken(inString);
+
+	// Someone may have beaten us to it between the lookup and the lock, so check again once we own the table.
+	lock_guard<mutex> guard(sLock);
+	n = LookupToken(inString);
+	if (n != -1) return n;
+	Assert(ConfirmNotNumber(inString));
+	return add_token_locked(inString);
+}
+
+int				CountTokens(void)
+{
+	return sCount.load(memory_order_acquire);
+}
+
+void			CopyTokens(TokenMap& outTokens)
+{
+	int count = sCount.load(memory_order_acquire);
+	outTokens.clear();
+	outTokens.reserve(count);
+	for (int n = 0; n < count; ++n)
+		outTokens.push_back(token_string(n));
 }
 
 void	BuildTokenReverseMap(
@@ -124,6 +278,16 @@ void	WriteEnumsAtomToFile(FILE * inFile, const TokenMap& inTokens, int atomCode)
 			fwrite(i->c_str(), i->size() + 1, 1, inFile);
 }
 
+void	WriteEnumsAtomToFile(FILE * inFile, int atomCode)
+{
+	StAtomWriter	tertAtom(inFile, atomCode);
+	int count = sCount.load(memory_order_acquire);
+	for (int n = 0; n < count; ++n)
+	{
+		const char * s = token_string(n);
+		fwrite(s, strlen(s) + 1, 1, inFile);
+	}
+}
 
 void	ReadEnumsAtomFromFile(XAtomContainer& inAtomContainer, TokenMap& outTokens, int atomCode)
 {
@@ -139,23 +303,35 @@ void	ReadEnumsAtomFromFile(XAtomContainer& inAtomContainer, TokenMap& outTokens,
 	}
 }
 
+void	ReadEnumsAtomFromFile(XAtomContainer& inAtomContainer, TokenConversionMap& outConversion, int atomCode)
+{
+	XAtomStringTable	strings;
+	outConversion.clear();
+	if (inAtomContainer.GetNthAtomOfID(atomCode, 0, strings))
+	{
+		const char * i;
+		for (i = strings.GetFirstString(); i; i = strings.GetNextString(i))
+		{
+			outConversion.push_back(LookupTokenCreate(i));
+		}
+	}
+}
+
 int				NewToken(const char * inString)
 {
 	Assert(ConfirmNotNumber(inString));
-	int v = gTokens.size();
-	gTokens.push_back(inString);
-	gReverse[inString] = gTokens.size()-1;
-
-	return v;
+	lock_guard<mutex> guard(sLock);
+	return add_token_locked(inString);
 }
 
 void EnumSystemSelfCheck(void)
 {
 	set<string>	dummy;
-	for (int n = 0; n < gTokens.size(); ++n)
+	int count = CountTokens();
+	for (int n = 0; n < count; ++n)
 	{
-		Assert(dummy.count(gTokens[n]) == 0);
-		dummy.insert(gTokens[n]);
+		Assert(dummy.count(token_string(n)) == 0);
+		dummy.insert(token_string(n));
+		Assert(LookupToken(token_string(n)) == n);
 	}
 }
-
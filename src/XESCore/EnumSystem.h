@@ -50,12 +50,18 @@ typedef	vector<string>			TokenMap;
 typedef hash_map<string, int>	TokenReverseMap;
 typedef	vector<int>				TokenConversionMap;
 
-extern	TokenMap		gTokens;
+/* The global token table.  It is safe to use from any number of threads at once:
+ * FetchTokenString, LookupToken and CountTokens never take a lock, while creating
+ * a token (NewToken, or LookupTokenCreate for an unknown string) takes a lock.
+ * Token ids are handed out in order and never change or go away.  InitEnumSystem
+ * resets the table and must not run while anyone else is using tokens. */
 
 const char *	FetchTokenString(int);
 int				NewToken(const char * inString);
 int				LookupToken(const char * inString);
 int				LookupTokenCreate(const char * inString);
+int				CountTokens(void);
+void			CopyTokens(TokenMap& outTokens);
 
 void	InitEnumSystem(void);
 
@@ -75,6 +81,11 @@ void	BuildTokenConversionMap(
 void	WriteEnumsAtomToFile(FILE * inFile, const TokenMap& inTokens, int atomID);
 void	ReadEnumsAtomFromFile(XAtomContainer& inAtomContainer, TokenMap& outTokens, int atomID);
 
+// Same as above, but for the global token table.  Reading maps every token in the file to the
+// global table (creating the ones we don't have) and returns the file-to-global conversion.
+void	WriteEnumsAtomToFile(FILE * inFile, int atomID);
+void	ReadEnumsAtomFromFile(XAtomContainer& inAtomContainer, TokenConversionMap& outConversion, int atomID);
+
 void	EnumSystemSelfCheck(void);
 
 #endif /* ENUMSYSTEM_H */
@@ -82,7 +82,7 @@ void WriteParamMap				(IOWriter& inWriter, const GISParamMap& m)
 	inWriter.WriteInt(m.size());
 	for (GISParamMap::const_iterator i = m.begin(); i != m.end(); ++i)
 	{
-		DebugAssert(i->first >= 0 && i->first < gTokens.size());
+		DebugAssert(i->first >= 0 && i->first < CountTokens());
 		inWriter.WriteInt(i->first);
 		inWriter.WriteDouble(i->second);
 	}
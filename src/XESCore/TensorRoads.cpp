@@ -37,6 +37,8 @@
 #include "MapCreate.h"
 
 #include "XUtils.h"
+#include <thread>
+#include <atomic>
 
 #define	ADVANCE_RATIO 0.0005
 
@@ -261,7 +263,7 @@ void BulkZapRoads(const DEMGeo& inUrbanDensity, Pmwx& io_map)
 	printf("AFTER ZAP: %llu generated roads.\n",(unsigned long long)io_map.number_of_halfedges() / 2);
 }
 
-void BulkInsertRoads(vector<Segment2>	roads, Pmwx& io_map)
+void BulkInsertRoads(const vector<Segment2>& roads, Pmwx& io_map)
 {
 	GIS_halfedge_data	hed;
 	hed.mSegments.push_back(GISNetworkSegment_t());
@@ -569,6 +571,63 @@ void	RasterEdge(
 	}
 }
 
+struct linear_tensor_pixel_t {
+	int				x;
+	int				y;
+	Vector2			t;
+};
+
+// One face's worth of linear-tensor work: the face outline with a tensor per vertex, the raster of the face
+// and, once rasterized, the summed tensor for each pixel the face covers.
+struct linear_tensor_face_t {
+	vector<Point2>					poly;
+	vector<Vector2>					tensors;
+	double							sz;
+	int								y;
+	PolyRasterizer<double>			raster;
+	vector<linear_tensor_pixel_t>	pixels;
+};
+
+// Thread safe - only reads the DEMs and writes to the face's own pixel buffer.
+static void	RasterLinearTensors(
+					linear_tensor_face_t&	tf,
+					const DEMGeo&			road_restrict,
+					const DEMGeo&			inUrbanSquare)
+{
+	int rx1, rx2, x, y = tf.y;
+	tf.raster.StartScanline(y);
+	while (!tf.raster.DoneScan())
+	{
+		while (tf.raster.GetRange(rx1, rx2))
+		{
+			rx1 = intlim(rx1,0,road_restrict.mWidth-1);
+			rx2 = intlim(rx2,0,road_restrict.mWidth-1);
+			for (x = rx1; x < rx2; ++x)
+			if(road_restrict.get(x,y) != 3.0)
+			{
+				float sq = inUrbanSquare.get(
+							inUrbanSquare.lon_to_x(road_restrict.x_to_lon(x)),
+							inUrbanSquare.lat_to_y(road_restrict.y_to_lat(y)));
+				if(sq == 1.0)
+				{
+					linear_tensor_pixel_t px;
+					px.x = x;
+					px.y = y;
+					px.t = Vector2(0.0, 0.0);
+					Point2 p(road_restrict.x_to_lon(x),road_restrict.y_to_lat(y));
+					for (int n = 0; n < tf.poly.size(); ++n)
+						px.t += (Linear_Tensor(tf.poly[n],tf.tensors[n], 4.0 / tf.sz, p));
+					tf.pixels.push_back(px);
+				}
+			}
+		}
+		++y;
+		if (y >= road_restrict.mHeight)
+			break;
+		tf.raster.AdvanceScanline(y);
+	}
+}
+
 void	BuildRoadsForFace(
 					Pmwx&			ioMap,
 					const DEMGeo&	inElevation,
@@ -673,19 +732,25 @@ void	BuildRoadsForFace(
 	// each polygon's interior using its own internal tensor func, which simplifies the cost of building this.  This lowers the accuracy
 	// of the grid tensor field, but we don't care that much anyway.
 
+	// The raster pass is by far the most expensive part (every pixel of a face looks at every vertex of that face) and faces don't
+	// share any state, so the faces are farmed out to worker threads.  The face outlines and rasterizers are set up here on the main
+	// thread since that walks the arrangement; each worker writes its tensor sums into its face's own buffer and we add the buffers
+	// into the grid in face order afterward, so the result does not depend on thread timing.
+
 	{
 		TIMER(calc_linear_tensors)
-//		int tcalcs = 0;
+
+		vector<linear_tensor_face_t>	tensor_faces;
 
 		for(f = ioMap.faces_begin(); f != ioMap.faces_end(); ++f)
 		if (!f->is_unbounded())
 		if(RoadsForThisFace(f))
 		{
 			// First build a polygon with tensor weights for the face we're working on.
-			vector<Point2>			poly;
-			vector<Vector2>			tensors;
-			PolyRasterizer<double>	raster;
-
+			tensor_faces.push_back(linear_tensor_face_t());
+			linear_tensor_face_t& tf(tensor_faces.back());
+			vector<Point2>&			poly(tf.poly);
+			vector<Vector2>&		tensors(tf.tensors);
 
 			Pmwx::Ccb_halfedge_circulator	circ = f->outer_ccb();
 			Pmwx::Ccb_halfedge_circulator	start = circ;
@@ -720,43 +785,29 @@ void	BuildRoadsForFace(
 				} while(circ != start);
 			}
 
-			// Now rasterize into the polygon...
-			double sz = (bounds.p2.y() - bounds.p1.y()) * (bounds.p2.x() - bounds.p1.x());
-			y = SetupRasterizerForDEM(f, road_restrict, raster);
-			raster.StartScanline(y);
-			while (!raster.DoneScan())
-			{
-				while (raster.GetRange(rx1, rx2))
-				{
-					rx1 = intlim(rx1,0,road_restrict.mWidth-1);
-					rx2 = intlim(rx2,0,road_restrict.mWidth-1);
-					for (x = rx1; x < rx2; ++x)
-					if(road_restrict.get(x,y) != 3.0)
-					{
-						float sq = inUrbanSquare.get(
-									inUrbanSquare.lon_to_x(grid_x.x_to_lon(x)),
-									inUrbanSquare.lat_to_y(grid_x.y_to_lat(y)));
-						if(sq == 1.0)
-						{
-							Vector2	t(grid_x.get(x,y),grid_y.get(x,y));
-							for (int n = 0; n < poly.size(); ++n)
-							{
-//								++tcalcs;
-								t += (Linear_Tensor(poly[n],tensors[n], 4.0 / sz, Point2(road_restrict.x_to_lon(x),road_restrict.y_to_lat(y))));
-							}
-							grid_x(x,y) = t.dx;
-							grid_y(x,y) = t.dy;
-						}
-					}
-				}
-				++y;
-				if (y >= road_restrict.mHeight)
-					break;
-				raster.AdvanceScanline(y);
-			}
+			tf.sz = (bounds.p2.y() - bounds.p1.y()) * (bounds.p2.x() - bounds.p1.x());
+			tf.y = SetupRasterizerForDEM(f, road_restrict, tf.raster);
 		}
 
-//		printf("Total tensor calcs for road grid: %d\n",tcalcs);
+		// Now rasterize into each polygon...
+		atomic<int>		next_face(0);
+		vector<thread>	workers;
+		int				num_threads = max(1, min((int) thread::hardware_concurrency(), (int) tensor_faces.size()));
+		for(int n = 0; n < num_threads; ++n)
+			workers.push_back(thread([&]() {
+				int i;
+				while((i = next_face++) < tensor_faces.size())
+					RasterLinearTensors(tensor_faces[i], road_restrict, inUrbanSquare);
+			}));
+		for(vector<thread>::iterator w = workers.begin(); w != workers.end(); ++w)
+			w->join();
+
+		for(vector<linear_tensor_face_t>::iterator tf = tensor_faces.begin(); tf != tensor_faces.end(); ++tf)
+		for(vector<linear_tensor_pixel_t>::iterator px = tf->pixels.begin(); px != tf->pixels.end(); ++px)
+		{
+			grid_x(px->x,px->y) += px->t.dx;
+			grid_y(px->x,px->y) += px->t.dy;
+		}
 	}
 
 
@@ -46,7 +46,7 @@ void	WriteXESFile(
 	FILE * fi = fopen(inFileName, "wb");
 	if (!fi) return;
 
-	WriteEnumsAtomToFile(fi, gTokens, kTokensID);
+	WriteEnumsAtomToFile(fi, kTokensID);
 	WriteMap(fi, inMap, inFunc, kMapID);
 	WriteMesh(fi, inMesh, kMeshID, inFunc);
 
@@ -88,11 +88,9 @@ void	ReadXESFile(
 	container.begin = (char *) MemFile_GetBegin(inFile);
 	container.end = (char *) MemFile_GetEnd(inFile);
 
-	TokenMap			fileTokens;
 	TokenConversionMap 	conversionMap;
 
-	ReadEnumsAtomFromFile(container, fileTokens, kTokensID);
-	BuildTokenConversionMap(gTokens, fileTokens, conversionMap);
+	ReadEnumsAtomFromFile(container, conversionMap, kTokensID);
 
 	XAtom	mapAtom, demAtom, demDirAtom, aptAtom;
 	XSpan	mapAtomData, demAtomData, demDirAtomData, aptAtomData;
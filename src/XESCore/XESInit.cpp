@@ -54,11 +54,11 @@ void	XESInit(rf_region inRegion, bool want_forests)
 	}
 	#endif
 
-	int old_mark = gTokens.size();
+	int old_mark = CountTokens();
 	LoadNetFeatureTables(inRegion);
 	LoadDEMTables();
 	LoadObjTables();
-	int new_mark = gTokens.size();
+	int new_mark = CountTokens();
 
 	if (old_mark != new_mark)
 	{
@@ -36,6 +36,7 @@
 #include "GISTool_ImageCmds.h"
 #include "GISTool_ProcessingCmds.h"
 #include "GISTool_VectorCmds.h"
+#include "GISTool_BatchCmds.h"
 #if USE_CHUD
 #include <CHUD/CHUD.h>
 #endif
@@ -115,6 +116,7 @@ int	main(int argc, char * argv[])
 		int start_arg = 1;
 
 		GISTool_RegisterCommands(sUtilCmds);
+		GISTool_SetExecutablePath(argv[0]);
 
 		RegisterDemCmds();
 		RegisterCoreCmds();
@@ -124,6 +126,7 @@ int	main(int argc, char * argv[])
 		RegisterObsCmds();
 		RegisterMiscCmds();
 		RegisterImageCmds();
+		RegisterBatchCmds();
 		
 		vector<const char *>	args;
 
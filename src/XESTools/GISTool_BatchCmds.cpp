@@ -0,0 +1,362 @@
+/*
+ * Copyright (c) 2026, Laminar Research.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ *
+ */
+
+#include "GISTool_BatchCmds.h"
+#include "GISTool_Utils.h"
+#include "GISTool_Globals.h"
+#include "PerfUtils.h"
+
+#if !IBM
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+/*
+	BATCH DRIVER
+
+	GISTool keeps all of its work in globals (gMap, gDem, the meshes) so one process can only ever work on one tile.  The batch
+	driver runs a command script for a list of tiles by launching one GISTool worker process per tile, up to N at a time.  An
+	optional per-worker address-space limit keeps a bad tile from taking the whole box down with it.
+
+	Mesh border matching reads the "border" cache files of the four neighbors and writes our own, so two neighbors must never run
+	at the same time.  With border ordering on, a tile waits for its west and south neighbors (if they are in the list) - this is
+	exactly the order a serial west-to-east, south-to-north run would produce, but tiles along each diagonal run in parallel.
+
+	Tile list format: one "west south" pair per line; blank lines and lines starting with # are ignored.
+
+	Script format: GISTool arguments separated by white space, # starts a comment to end of line.  These tokens are substituted:
+
+	{west} {south} {east} {north}	The tile bounds, as integers.
+	{tile}							The tile name, e.g. +47-122, the way the cache file paths name it.
+
+ */
+
+static string	sExecutablePath;
+
+void GISTool_SetExecutablePath(const char * argv0)
+{
+	sExecutablePath = argv0;
+}
+
+struct batch_tile_t {
+	int					west;
+	int					south;
+	vector<int>			deps;			// Tiles that must finish before we can start.
+	vector<int>			waiters;		// Tiles that are waiting on us.
+	int					blocked;		// Number of deps that are not done yet.
+	int					pid;
+	int					status;			// 0 = ok, otherwise the worker's exit code or signal.
+	unsigned long long	start;
+	double				seconds;
+};
+
+static bool	load_batch_tiles(const char * path, vector<batch_tile_t>& out_tiles)
+{
+	FILE * fi = fopen(path, "r");
+	if(!fi)
+	{
+		fprintf(stderr,"Could not open tile list %s\n", path);
+		return false;
+	}
+	char	line[1024];
+	while(fgets(line, sizeof(line), fi))
+	{
+		char * p = line;
+		while(*p == ' ' || *p == '\t') ++p;
+		if(*p == '#' || *p == '\r' || *p == '\n' || *p == 0)
+			continue;
+		batch_tile_t t;
+		if(sscanf(p, "%d %d", &t.west, &t.south) != 2 ||
+			t.west < -180 || t.west >= 180 || t.south < -90 || t.south >= 90)
+		{
+			fprintf(stderr,"Bad tile line in %s: %s", path, line);
+			fclose(fi);
+			return false;
+		}
+		t.blocked = 0;
+		t.pid = 0;
+		t.status = 0;
+		t.start = 0;
+		t.seconds = 0.0;
+		out_tiles.push_back(t);
+	}
+	fclose(fi);
+	return true;
+}
+
+static bool	load_batch_script(const char * path, vector<string>& out_tokens)
+{
+	FILE * fi = fopen(path, "r");
+	if(!fi)
+	{
+		fprintf(stderr,"Could not open batch script %s\n", path);
+		return false;
+	}
+	char	line[4096];
+	while(fgets(line, sizeof(line), fi))
+	{
+		if(char * c = strchr(line, '#'))
+			*c = 0;
+		const char * sep = "\r\n \t";
+		for(char * tok = strtok(line, sep); tok; tok = strtok(NULL, sep))
+			out_tokens.push_back(tok);
+	}
+	fclose(fi);
+	return true;
+}
+
+static void	substitute_token(string& io_str, const char * key, const char * value)
+{
+	string::size_type p;
+	while((p = io_str.find(key)) != io_str.npos)
+		io_str.replace(p, strlen(key), value);
+}
+
+static void	make_tile_args(const vector<string>& script, const batch_tile_t& t, vector<string>& out_args)
+{
+	char	west[16], south[16], east[16], north[16], tile[16];
+	snprintf(west, sizeof(west), "%d", t.west);
+	snprintf(south, sizeof(south), "%d", t.south);
+	snprintf(east, sizeof(east), "%d", t.west+1);
+	snprintf(north, sizeof(north), "%d", t.south+1);
+	snprintf(tile, sizeof(tile), "%+03d%+04d", t.south, t.west);
+
+	out_args = script;
+	for(vector<string>::iterator a = out_args.begin(); a != out_args.end(); ++a)
+	{
+		substitute_token(*a, "{west}", west);
+		substitute_token(*a, "{south}", south);
+		substitute_token(*a, "{east}", east);
+		substitute_token(*a, "{north}", north);
+		substitute_token(*a, "{tile}", tile);
+	}
+}
+
+// Wire up the west and south neighbors as dependencies.  Duplicate tiles are an error - they would race on the same outputs.
+static bool	order_batch_tiles(vector<batch_tile_t>& tiles, bool border_order)
+{
+	map<pair<int,int>, int>	index;
+	for(int n = 0; n < tiles.size(); ++n)
+	{
+		pair<int,int> k(tiles[n].west, tiles[n].south);
+		if(index.count(k))
+		{
+			fprintf(stderr,"Tile %d,%d is listed more than once.\n", tiles[n].west, tiles[n].south);
+			return false;
+		}
+		index[k] = n;
+	}
+
+	if(border_order)
+	for(int n = 0; n < tiles.size(); ++n)
+	{
+		pair<int,int>	nbrs[2] = { pair<int,int>(tiles[n].west-1, tiles[n].south),
+									pair<int,int>(tiles[n].west, tiles[n].south-1) };
+		for(int k = 0; k < 2; ++k)
+		{
+			map<pair<int,int>, int>::iterator i = index.find(nbrs[k]);
+			if(i != index.end())
+			{
+				tiles[n].deps.push_back(i->second);
+				tiles[i->second].waiters.push_back(n);
+				++tiles[n].blocked;
+			}
+		}
+	}
+	return true;
+}
+
+#if !IBM
+
+static int	launch_tile(const vector<string>& args, long mem_limit_mb)
+{
+	vector<char *>	argv;
+	argv.push_back(const_cast<char *>(sExecutablePath.c_str()));
+	for(vector<string>::const_iterator a = args.begin(); a != args.end(); ++a)
+		argv.push_back(const_cast<char *>(a->c_str()));
+	argv.push_back(NULL);
+
+	fflush(stdout);
+	fflush(stderr);
+	pid_t pid = fork();
+	if(pid == 0)
+	{
+		if(mem_limit_mb > 0)
+		{
+			struct rlimit lim;
+			lim.rlim_cur = lim.rlim_max = (rlim_t) mem_limit_mb * 1024 * 1024;
+			setrlimit(RLIMIT_AS, &lim);
+		}
+		execvp(argv[0], &argv[0]);						// argv[0] may be a bare name if we were found via PATH
+		fprintf(stderr,"Could not launch %s: %s\n", argv[0], strerror(errno));
+		_exit(127);
+	}
+	return pid;
+}
+
+// Bail-out path: stop every worker still running and reap it, so nothing is left behind when we return early.
+static void	abort_batch(map<pid_t, int>& running)
+{
+	for(map<pid_t, int>::iterator r = running.begin(); r != running.end(); ++r)
+		kill(r->first, SIGTERM);
+	for(map<pid_t, int>::iterator r = running.begin(); r != running.end(); ++r)
+	{
+		int wstatus;
+		while(waitpid(r->first, &wstatus, 0) < 0 && errno == EINTR)
+			;
+	}
+	running.clear();
+}
+
+static int DoBatch(const vector<const char *>& args)
+{
+	vector<batch_tile_t>	tiles;
+	vector<string>			script;
+	int						jobs = atoi(args[2]);
+	long					mem_limit_mb = args.size() > 3 ? atol(args[3]) : 0;
+	bool					border_order = args.size() > 4 ? atoi(args[4]) != 0 : true;
+
+	if(sExecutablePath.empty())
+	{
+		fprintf(stderr,"Batch mode does not know where GISTool lives.\n");
+		return 1;
+	}
+	if(!load_batch_tiles(args[0], tiles))	return 1;
+	if(!load_batch_script(args[1], script))	return 1;
+	if(!order_batch_tiles(tiles, border_order))	return 1;
+	if(jobs <= 0)
+		jobs = max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+
+	if(gVerbose)
+		printf("Batch: %zd tiles, %d workers, %ld MB per worker, border ordering %s.\n",
+			tiles.size(), jobs, mem_limit_mb, border_order ? "on" : "off");
+
+	unsigned long long	batch_start = query_hpc();
+	vector<int>			ready;
+	map<pid_t, int>		running;
+	int					done = 0, failed = 0;
+
+	// Run tiles in list order as far as the dependencies allow - ready is kept as a stack, so we seed it backwards.
+	for(int n = tiles.size()-1; n >= 0; --n)
+	if(tiles[n].blocked == 0)
+		ready.push_back(n);
+
+	while(done < tiles.size())
+	{
+		while(!ready.empty() && running.size() < jobs)
+		{
+			int n = ready.back();
+			ready.pop_back();
+			vector<string> tile_args;
+			make_tile_args(script, tiles[n], tile_args);
+			tiles[n].start = query_hpc();
+			int pid = launch_tile(tile_args, mem_limit_mb);
+			if(pid < 0)
+			{
+				fprintf(stderr,"Could not fork worker for tile %d,%d: %s\n", tiles[n].west, tiles[n].south, strerror(errno));
+				abort_batch(running);
+				return 1;
+			}
+			tiles[n].pid = pid;
+			running[pid] = n;
+			if(gVerbose)
+				printf("Batch: started %d,%d (pid %d).\n", tiles[n].west, tiles[n].south, pid);
+		}
+
+		if(running.empty())
+		{
+			fprintf(stderr,"Batch: tiles left but nothing can run - dependency cycle?\n");
+			abort_batch(running);
+			return 1;
+		}
+
+		int		wstatus;
+		pid_t	pid = waitpid(-1, &wstatus, 0);
+		if(pid < 0)
+		{
+			if(errno == EINTR) continue;
+			fprintf(stderr,"Batch: waitpid failed: %s\n", strerror(errno));
+			abort_batch(running);
+			return 1;
+		}
+		map<pid_t, int>::iterator r = running.find(pid);
+		if(r == running.end())
+			continue;
+
+		batch_tile_t& t(tiles[r->second]);
+		running.erase(r);
+		++done;
+		t.seconds = hpc_to_microseconds(query_hpc() - t.start) / 1000000.0;
+		if(WIFEXITED(wstatus))
+			t.status = WEXITSTATUS(wstatus);
+		else if(WIFSIGNALED(wstatus))
+			t.status = 128 + WTERMSIG(wstatus);
+		else
+			t.status = 1;
+
+		if(t.status)
+		{
+			++failed;
+			fprintf(stderr,"Batch: tile %d,%d FAILED with status %d after %.1f seconds.\n", t.west, t.south, t.status, t.seconds);
+		}
+		else if(gVerbose)
+			printf("Batch: tile %d,%d done in %.1f seconds (%d of %zd).\n", t.west, t.south, t.seconds, done, tiles.size());
+
+		// A failed neighbor leaves no border file - the waiters still run, they just won't match that edge.
+		for(vector<int>::iterator w = t.waiters.begin(); w != t.waiters.end(); ++w)
+		if(--tiles[*w].blocked == 0)
+			ready.push_back(*w);
+	}
+
+	double total = hpc_to_microseconds(query_hpc() - batch_start) / 1000000.0;
+	double busy = 0.0;
+	printf("Tile      Status  Seconds\n");
+	for(vector<batch_tile_t>::iterator t = tiles.begin(); t != tiles.end(); ++t)
+	{
+		printf("%+03d%+04d  %6d  %7.1f\n", t->south, t->west, t->status, t->seconds);
+		busy += t->seconds;
+	}
+	printf("Batch: %zd tiles (%d failed) in %.1f seconds, %.1f tile-seconds of work.\n", tiles.size(), failed, total, busy);
+	return failed ? 1 : 0;
+}
+
+#endif /* !IBM */
+
+static GISTool_RegCmd_t		sBatchCmds[] = {
+#if !IBM
+{ "-batch",		3, 5, DoBatch,		"tile_list script jobs [mem_mb] [border_order] - run a script for many tiles in parallel.",
+	"Runs the GISTool commands in 'script' once per tile in 'tile_list', in up to 'jobs' worker processes at a time (0 = one per core).\n"
+	"The tile list has one 'west south' pair per line.  In the script, {west} {south} {east} {north} and {tile} are replaced per tile.\n"
+	"mem_mb caps the address space of each worker (0 = no limit).  With border_order on (the default), a tile waits for its west and\n"
+	"south neighbors so that mesh border files are always written before they are read.  Prints per-tile timings at the end.\n" },
+#endif
+{ 0, 0, 0, 0, 0, 0 }
+};
+
+void	RegisterBatchCmds(void)
+{
+	GISTool_RegisterCommands(sBatchCmds);
+}
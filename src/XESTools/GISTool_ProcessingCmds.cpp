@@ -31,6 +31,7 @@
 #include "Airports.h"
 #include "NetAlgs.h"
 #include "DSFBuilder.h"
+#include "DSFLib.h"
 #include "SceneryPackages.h"
 #include "CompGeomUtils.h"
 //#include "TensorRoads.h"
@@ -543,6 +544,20 @@ static int DoAssignLandUse(const vector<const char *>& args)
 }
 
 
+static int DoDSFPrims(const vector<const char *>& args)
+{
+		 if(strcmp(args[0],"strip") == 0)		gDSFBuildPrefs.patch_primitives = dsf_PatchPrims_Strip;
+	else if(strcmp(args[0],"tris") == 0)		gDSFBuildPrefs.patch_primitives = dsf_PatchPrims_CacheTris;
+	else if(strcmp(args[0],"tri_stripper") == 0)gDSFBuildPrefs.patch_primitives = dsf_PatchPrims_TriStripper;
+	else
+	{
+		fprintf(stderr,"Unknown patch primitive mode %s - use strip, tris or tri_stripper.\n", args[0]);
+		return 1;
+	}
+	gDSFBuildPrefs.print_stats = args.size() > 1 && strcmp(args[1],"stats") == 0;
+	return 0;
+}
+
 static int DoBuildDSF(const vector<const char *>& args)
 {
 	char buf1[1024], buf2[1024];
@@ -577,6 +592,7 @@ static	GISTool_RegCmd_t		sProcessCmds[] = {
 { "-instobjs", 		0, 0, DoInstantiateObjs, "Instantiate Objects.", 			  "" },
 { "-buildroads", 	0, 0, DoBuildRoads, 	"Pick Road Types.", 	  			"" },
 { "-assignterrain", 1, 1, DoAssignLandUse, 	"Assign Terrain to Mesh.", 	 		 "" },
+{ "-dsf_prims",		1, 2, DoDSFPrims,		"Set DSF patch primitive mode.",	  "-dsf_prims strip|tris|tri_stripper [stats]\nSets how -exportdsf builds terrain patch primitives: greedy strips (the default), vertex-cache ordered triangles, or\nthe old tri_stripper library.  With 'stats', primitive counts and command bytes per command type are printed for each DSF.\n" },
 { "-exportdsf", 	2, 2, DoBuildDSF, 		"Build DSF file.", 					  "" },
 
 
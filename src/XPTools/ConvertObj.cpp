@@ -123,6 +123,13 @@ void	PostProcessObj(XObj& ioObj, bool inReverse)
 	}
 }
 
+static void	OptimizeObj8(XObj8& obj8)
+{
+	float acmr_before = Obj8_CalcACMR(obj8);
+	if (Obj8_Optimize(obj8))
+		printf("Vertex cache ACMR: %.3f before, %.3f after optimization.\n", acmr_before, Obj8_CalcACMR(obj8));
+}
+
 void	XGrindFile(const char * inConvertFlag, const char * inSrcFile, const char * inDstFile)
 {
 	XObj	obj;
@@ -155,7 +162,7 @@ void	XGrindFile(const char * inConvertFlag, const char * inSrcFile, const char *
 			else if (!XObj8Read(inSrcFile, obj8))				{ printf("Error: unable to open OBJ file %s\n",inSrcFile); exit(1); }
 
 			if(gOptimize)
-				Obj8_Optimize(obj8);
+				OptimizeObj8(obj8);
 			if (!XObj8Write(inDstFile, obj8))					{ printf("Error: unable to write OBJ file %s\n",inDstFile); exit(1); }
 		}
 		else
@@ -173,7 +180,7 @@ void	XGrindFile(const char * inConvertFlag, const char * inSrcFile, const char *
 		else if (!XObj8Read(inSrcFile, obj8))				{ printf("Error: unable to open OBJ file %s\n",inSrcFile); exit(1); }
 
 		if(gOptimize)
-			Obj8_Optimize(obj8);
+			OptimizeObj8(obj8);
 		if (!XObjWriteEmbedded(inDstFile, obj8))			{ printf("Error: unable to write OBJ file %s\n",inDstFile); exit(1); }
 	}
 #endif
@@ -188,7 +195,7 @@ void	XGrindFile(const char * inConvertFlag, const char * inSrcFile, const char *
 			Obj7ToObj8(obj,obj8);
 
 			if(gOptimize)
-				Obj8_Optimize(obj8);
+				OptimizeObj8(obj8);
 
 			if (!XObj8Write(inDstFile, obj8))				{ printf("Error: unable to write OBJ file %s\n",inDstFile); exit(1); }
 		}
@@ -208,7 +215,7 @@ void	XGrindFile(const char * inConvertFlag, const char * inSrcFile, const char *
 			Obj7ToObj8(obj,obj8);
 
 			if(gOptimize)
-				Obj8_Optimize(obj8);
+				OptimizeObj8(obj8);
 
 			if (!XObj8Write(inDstFile, obj8))				{ printf("Error: unable to write OBJ file %s\n",inDstFile); exit(1); }
 		}
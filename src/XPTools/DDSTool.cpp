@@ -26,6 +26,11 @@
 #include "QuiltUtils.h"
 #include "FileUtils.h"
 #include "MathUtils.h"
+#include "PlatformUtils.h"
+#include "WorkerPool.h"
+
+#include <sys/stat.h>
+#include <chrono>
 
 #if PHONE
 	#define WANT_PVR 1
@@ -336,6 +341,16 @@ inline float from_srgb(float p)
 		return powf(p * (1.0/1.055f) + (0.055f/1.055f),2.4f);
 }
 
+// from_srgb of every 8-bit value, so the filter below doesn't call powf for every sample.
+static const float * srgb_lut()
+{
+	static struct lut_t {
+		float v[256];
+		lut_t() { for(int i = 0; i < 256; ++i) v[i] = from_srgb((float) i / 255.0f); }
+	} lut;
+	return lut.v;
+}
+
 unsigned char srgb_filter(unsigned char src[], int count, int channel, int level)
 {
 	if(channel == 3)	// alpha is not corrected
@@ -346,14 +361,10 @@ unsigned char srgb_filter(unsigned char src[], int count, int channel, int level
 		return min(255,total / count);
 	}
 	
+	const float * lut = srgb_lut();
 	float total = 0.f;
 	for(int i = 0; i < count; ++i)
-	{
-		float p = src[i];
-		p /= 255.0f;
-		p = from_srgb(p);
-		total += p;
-	}
+		total += lut[src[i]];
 	
 	total /= ((float) count);
 	
@@ -406,6 +417,257 @@ unsigned char fade_2_black_filter(unsigned char src[], int count, int channel, i
 }
 
 
+/*
+	PNG -> DXT conversion, shared by the single file and --batch modes.
+*/
+
+struct dxt_opts_t {
+	int		dxt_type;		// 1, 3 or 5, 0 = pick from the PNG's alpha
+	int		has_mips;		// 0 = std, 1 = pre, 2 = night, 3 = fade, 4 = ctl
+	float	gamma;
+	bool	scale_up;
+	bool	scale_down;
+	bool	scale_half;
+};
+
+// argv[0] is the --png2dxt mode; returns the index of the first file name after the options.
+static int ParseDXTOptions(char * argv[], dxt_opts_t& opts)
+{
+	int arg_base = 1;
+	opts.dxt_type = argv[0][9] ? argv[0][9]-'0' : 0;
+	opts.has_mips = 0;
+
+	if(strcmp(argv[arg_base], "--std_mips") == 0)
+	{
+		opts.has_mips = 0;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--pre_mips") == 0)
+	{
+		opts.has_mips = 1;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--night_mips") == 0)
+	{
+		opts.has_mips = 2;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--fade_mips") == 0)
+	{
+		opts.has_mips = 3;
+		++arg_base;
+	}
+	else if(strcmp(argv[arg_base], "--ctl_mips") == 0)
+	{
+		opts.has_mips = 4;
+		++arg_base;
+	}
+
+	opts.gamma = (strcmp(argv[arg_base], "--gamma_22") == 0) ? 2.2f : 1.8f;
+	arg_base +=1;
+
+	opts.scale_up = strcmp(argv[arg_base], "--scale_up") == 0;
+	opts.scale_down = strcmp(argv[arg_base], "--scale_down") == 0;
+	opts.scale_half = strcmp(argv[arg_base], "--scale_half") == 0;
+	arg_base +=1;
+	
+	return arg_base;
+}
+
+// Returns 0 on success, 1 on failure (after saying why).  out_pixels, if not NULL, gets the size of the source image.
+static int ConvertPNGToDXT(const char * inf, const char * outf, const dxt_opts_t& opts, long * out_pixels)
+{
+	// Stream the PNG through the DDS writer band by band when we can, so a huge orthophoto doesn't have to fit in memory
+	// a few times over.  Scaling and pre-made mips need the whole image.
+	if(opts.has_mips != 1 && !opts.scale_up && !opts.scale_down && !opts.scale_half)
+	{
+		static const mip_filter_f filters[5] = { srgb_filter, NULL, night_filter, fade_filter, fade_2_black_filter };
+		int w, h;
+		int r = WritePNGToDDS(inf, opts.dxt_type, outf, opts.gamma, opts.gamma == GAMMA_SRGB, filters[opts.has_mips], &w, &h);
+		if(r == 0)
+		{
+			if(out_pixels)
+				*out_pixels = (long) w * h;
+			return 0;
+		}
+		if(r < 0)
+		{
+			printf("Unable to convert png file %s to DDS file %s\n", inf, outf);
+			return 1;
+		}
+	}
+
+	ImageInfo	info;
+	if (CreateBitmapFromPNG(inf, &info, false, opts.gamma)!=0)
+	{
+		printf("Unable to open png file %s\n", inf);
+		return 1;
+	}
+	if(out_pixels)
+		*out_pixels = info.width * info.height;
+
+	if (!HandleScale(info, opts.scale_up, opts.scale_down, opts.scale_half, false))
+	{
+		// Image does NOT meet our power of 2 needs.
+		if(!opts.scale_up && !opts.scale_down && !opts.scale_half)
+		{
+			printf("The imager is not a power of 2.  It is: %ld by %ld\n", info.width, info.height);
+			DestroyBitmap(&info);
+			return 1;
+		}
+	}
+
+	if(info.channels == 1)
+	{
+		printf("Unable to write DDS file from alpha-only PNG %s\n", outf);
+	}
+	int dxt_type = opts.dxt_type;
+	if(dxt_type == 0)
+	{
+		if(info.channels == 3)  dxt_type=1;
+		else					dxt_type=5;
+	}
+
+	ConvertBitmapToAlpha(&info,false);
+	switch(opts.has_mips) {
+//	case 0:			MakeMipmapStack(&info);							break;
+	case 0:			MakeMipmapStackWithFilter(&info,srgb_filter);	break;
+	case 1:			MakeMipmapStackFromImage(&info);				break;
+	case 2:			MakeMipmapStackWithFilter(&info,night_filter);	break;
+	case 3:			MakeMipmapStackWithFilter(&info,fade_filter);	break;
+	case 4:			MakeMipmapStackWithFilter(&info,fade_2_black_filter);	break;
+	}
+
+	int result = 0;
+	if (WriteBitmapToDDS(info, dxt_type, outf, opts.gamma == GAMMA_SRGB)!=0)
+	{
+		printf("Unable to write DDS file %s\n", outf);
+		result = 1;
+	}
+	DestroyBitmap(&info);
+	return result;
+}
+
+/*
+	Batch mode - convert a whole list of PNGs in one process.  The source is either a directory (every .png
+	under it, recursively) or a manifest file with one "input.png" or "input.png<TAB>output.dds" per line;
+	blank lines and lines starting with # are ignored.  Outputs go next to their PNG, or, with an output
+	directory, into the same relative place under it.
+
+	Files are converted as jobs on the worker pool - several PNGs get decoded and mipped at once while
+	the DDS writer runs its DXT bands on whatever cores are left.  An output that is newer than its PNG
+	and more than just a DDS header is taken as up-to-date and skipped.
+*/
+
+struct dxt_job_t {
+	string	src;
+	string	dst;
+};
+
+static bool is_up_to_date(const dxt_job_t& job)
+{
+	struct stat src_info, dst_info;
+	if(FILE_get_file_meta_data(job.src, src_info) != 0) return false;
+	if(FILE_get_file_meta_data(job.dst, dst_info) != 0) return false;
+	return dst_info.st_mtime >= src_info.st_mtime && dst_info.st_size > 128;
+}
+
+static string replace_extension(const string& path, const char * ext)
+{
+	string::size_type dot = path.find_last_of('.');
+	string::size_type sep = path.find_last_of("/\\");
+	if(dot == path.npos || (sep != path.npos && dot < sep))
+		return path + ext;
+	return path.substr(0, dot) + ext;
+}
+
+static int BatchPNGToDXT(const char * source, const char * out_dir, const dxt_opts_t& opts)
+{
+	vector<dxt_job_t>	jobs;
+	struct stat			source_info;
+	if(FILE_get_file_meta_data(source, source_info) != 0)
+	{
+		printf("Unable to open %s\n", source);
+		return 1;
+	}
+
+	if(source_info.st_mode & S_IFDIR)
+	{
+		string root(source);
+		while(root.size() > 1 && (root[root.size()-1] == '/' || root[root.size()-1] == '\\'))
+			root.erase(root.size()-1);
+
+		vector<string> files, dirs;
+		FILE_get_directory_recursive(root, files, dirs);
+		sort(files.begin(), files.end());
+		for(vector<string>::iterator f = files.begin(); f != files.end(); ++f)
+		if(FILE_get_file_extension(*f) == "png")
+		{
+			dxt_job_t job;
+			job.src = *f;
+			job.dst = replace_extension(out_dir ? string(out_dir) + f->substr(root.size()) : *f, ".dds");
+			jobs.push_back(job);
+		}
+	}
+	else
+	{
+		string manifest;
+		if(FILE_read_file_to_string(source, manifest) != 0)
+		{
+			printf("Unable to read manifest %s\n", source);
+			return 1;
+		}
+		string::size_type p = 0;
+		while(p < manifest.size())
+		{
+			string::size_type e = manifest.find_first_of("\r\n", p);
+			if(e == manifest.npos) e = manifest.size();
+			string line(manifest, p, e - p);
+			p = e + 1;
+
+			if(line.empty() || line[0] == '#') continue;
+			dxt_job_t job;
+			string::size_type tab = line.find('\t');
+			job.src = line.substr(0, tab);
+			if(tab != line.npos)
+				job.dst = line.substr(tab + 1);
+			else
+				job.dst = replace_extension(out_dir ? string(out_dir) + DIR_STR + FILE_get_file_name(job.src) : job.src, ".dds");
+			jobs.push_back(job);
+		}
+	}
+
+	atomic<int>		converted(0), skipped(0), failed(0);
+	atomic<long>	pixels(0);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	WorkerPool_ParallelFor(jobs.size(), [&](int n) {
+		const dxt_job_t& job(jobs[n]);
+		if(is_up_to_date(job))
+		{
+			++skipped;
+			return;
+		}
+		if(out_dir)
+			FILE_make_dir_exist(FILE_get_dir_name(job.dst).c_str());
+
+		long job_pixels = 0;
+		if(ConvertPNGToDXT(job.src.c_str(), job.dst.c_str(), opts, &job_pixels) == 0)
+		{
+			++converted;
+			pixels += job_pixels;
+		}
+		else
+			++failed;
+	});
+
+	double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	printf("Converted %d, skipped %d up-to-date, %d failed of %d files in %.1f sec.\n", (int) converted, (int) skipped, (int) failed, (int) jobs.size(), secs);
+	if(secs > 0.0)
+		printf("%.1f files/sec, %.1f Mpixels/sec.\n", converted / secs, pixels / secs / 1.0e6);
+	return failed ? 1 : 0;
+}
+
 int main(int argc, char * argv[])
 {
 	char	my_dir[2048];
@@ -478,6 +740,7 @@ int main(int argc, char * argv[])
 	if (argc < 4) {
 		printf("Usage: %s <convert mode> <options> <input_file> <output_file>|-\n",argv[0]);
 		printf("Usage: %s --quilt <input_file> <width> <height> <patch size> <overlap> <trials> <output_files>\n",argv[0]);
+		printf("Usage: %s --batch <dxt mode> <options> <manifest_file|input_dir> [output_dir]\n",argv[0]);
 		printf("       %s --version\n",argv[0]);
 		exit(1);
 	}
@@ -664,60 +927,8 @@ int main(int argc, char * argv[])
 	   strcmp(argv[1],"--png2dxt3")==0 ||
 	   strcmp(argv[1],"--png2dxt5")==0)
 	{
-		int arg_base = 2;
-		int has_mips = 0;
-
-		if(strcmp(argv[arg_base], "--std_mips") == 0)
-		{
-			has_mips = 0;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--pre_mips") == 0)
-		{
-			has_mips = 1;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--night_mips") == 0)
-		{
-			has_mips = 2;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--fade_mips") == 0)
-		{
-			has_mips = 3;
-			++arg_base;
-		}
-		else if(strcmp(argv[arg_base], "--ctl_mips") == 0)
-		{
-			has_mips = 4;
-			++arg_base;
-		}
-
-		float gamma = (strcmp(argv[arg_base], "--gamma_22") == 0) ? 2.2f : 1.8f;
-		arg_base +=1;
-
-
-		bool scale_up = strcmp(argv[arg_base], "--scale_up") == 0;
-		bool scale_down = strcmp(argv[arg_base], "--scale_down") == 0;
-		bool scale_half = strcmp(argv[arg_base], "--scale_half") == 0;
-		arg_base +=1;
-
-		ImageInfo	info;
-		if (CreateBitmapFromPNG(argv[arg_base], &info, false, gamma)!=0)
-		{
-			printf("Unable to open png file %s\n", argv[arg_base]);
-			return 1;
-		}
-
-		if (!HandleScale(info, scale_up, scale_down, scale_half, false))
-		{
-			// Image does NOT meet our power of 2 needs.
-			if(!scale_up && !scale_down && !scale_half)
-			{
-				printf("The imager is not a power of 2.  It is: %ld by %ld\n", info.width, info.height);
-				return 1;
-			}
-		}
+		dxt_opts_t opts;
+		int arg_base = ParseDXTOptions(argv + 1, opts) + 1;
 
 		char buf[1024];
 		const char * outf = argv[arg_base+1];
@@ -729,33 +940,21 @@ int main(int argc, char * argv[])
 			outf=buf;
 		}
 
-		if(info.channels == 1)
-		{
-			printf("Unable to write DDS file from alpha-only PNG %s\n", argv[arg_base+1]);
-		}
-		int dxt_type = argv[1][9]-'0';
-		if(argv[1][9]==0)
-		{
-			if(info.channels == 3)  dxt_type=1;
-			else					dxt_type=5;
-		}
-
-		ConvertBitmapToAlpha(&info,false);
-		switch(has_mips) {
-//		case 0:			MakeMipmapStack(&info);							break;
-		case 0:			MakeMipmapStackWithFilter(&info,srgb_filter);	break;
-		case 1:			MakeMipmapStackFromImage(&info);				break;
-		case 2:			MakeMipmapStackWithFilter(&info,night_filter);	break;
-		case 3:			MakeMipmapStackWithFilter(&info,fade_filter);	break;
-		case 4:			MakeMipmapStackWithFilter(&info,fade_2_black_filter);	break;
-		}
-
-		if (WriteBitmapToDDS(info, dxt_type, outf, gamma == GAMMA_SRGB)!=0)
+		return ConvertPNGToDXT(argv[arg_base], outf, opts, NULL);
+	}
+	else if(strcmp(argv[1],"--batch")==0)
+	{
+		// DDSTool --batch <dxt mode> <options> <manifest_file|input_dir> [output_dir]
+		dxt_opts_t opts;
+		int arg_base = argc;
+		if(argc >= 6 && strncmp(argv[2], "--png2dxt", 9) == 0)
+			arg_base = ParseDXTOptions(argv + 2, opts) + 2;
+		if(arg_base >= argc)
 		{
-			printf("Unable to write DDS file %s\n", argv[arg_base+1]);
+			printf("Usage: %s --batch <dxt mode> <options> <manifest_file|input_dir> [output_dir]\n",argv[0]);
 			return 1;
 		}
-		return 0;
+		return BatchPNGToDXT(argv[arg_base], arg_base + 1 < argc ? argv[arg_base+1] : NULL, opts);
 	}
 	else if(strcmp(argv[1],"--png2rgb")==0)
 	{
@@ -0,0 +1,158 @@
+/*
+ *  curl_http_test.cpp
+ *
+ *  Stand-alone driver for the curl_http request engine, run against http_standin.py - see howto_test.txt.
+ *  Prints one line per check and exits with the number of failed checks.
+ *
+ */
+
+#include "curl_http.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+static mutex			s_lock;
+static vector<int>		s_order;		// done callback refs, in the order the requests finished
+static atomic<int>		s_done(0);
+static int				s_failed = 0;
+
+static void	done_cb(void * ref)
+{
+	lock_guard<mutex> guard(s_lock);
+	s_order.push_back((int) (intptr_t) ref);
+	++s_done;
+}
+
+static double	now(void)
+{
+	return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void	wait_done(int n)
+{
+	while(s_done < n)
+		this_thread::sleep_for(chrono::milliseconds(5));
+}
+
+static void	check(bool ok, const char * what)
+{
+	printf("%s: %s\n", ok ? "ok  " : "FAIL", what);
+	if(!ok) ++s_failed;
+}
+
+static string	url(const char * path, int n)
+{
+	char buf[100];
+	snprintf(buf, sizeof(buf), "http://127.0.0.1:8765/%s%d", path, n);
+	return buf;
+}
+
+// 12 requests of 0.3 s each, 6 at a time: two rounds, not twelve.
+static void	test_concurrency(void)
+{
+	s_done = 0;
+	vector<vector<char> > bufs(12);
+	vector<curl_http_get_file *> reqs;
+	double t0 = now();
+	for(int i = 0; i < 12; ++i)
+		reqs.push_back(new curl_http_get_file(url("c", i), &bufs[i], 0.0f, done_cb, (void *) (intptr_t) i));
+	wait_done(12);
+	double elapsed = now() - t0;
+
+	int good = 0;
+	for(int i = 0; i < 12; ++i)
+	{
+		// the body is the path 1000 times: "/c0" .. "/c9", then "/c10", "/c11"
+		if(reqs[i]->is_done() && reqs[i]->is_ok() && bufs[i].size() == (i < 10 ? 3000 : 4000))
+			++good;
+		delete reqs[i];
+	}
+	printf("      12 requests took %.2lf s\n", elapsed);
+	check(good == 12, "12 parallel requests deliver their bodies");
+	check(elapsed < 1.5, "requests run side by side");
+}
+
+// One slot: after the first request, the queue drains lowest priority value first - including a priority
+// that was changed while the request was waiting.
+static void	test_priority(void)
+{
+	curl_http_set_max_transfers(1);
+	s_done = 0;
+	s_order.clear();
+	float prio[6] = { 5, 3, 9, 1, 7, 2 };
+	vector<vector<char> > bufs(6);
+	vector<curl_http_get_file *> reqs;
+	for(int i = 0; i < 6; ++i)
+		reqs.push_back(new curl_http_get_file(url("p", i), &bufs[i], prio[i], done_cb, (void *) (intptr_t) i));
+	reqs[2]->set_priority(0.5f);
+	prio[2] = 0.5f;
+	wait_done(6);
+
+	bool sorted = true;
+	printf("      finished:");
+	for(int i = 0; i < (int) s_order.size(); ++i)
+	{
+		printf(" %d", s_order[i]);
+		if(i > 1 && prio[s_order[i]] < prio[s_order[i-1]])
+			sorted = false;
+	}
+	printf("\n");
+	check(sorted, "queued requests start lowest priority value first");
+	for(auto r : reqs)
+		delete r;
+	curl_http_set_max_transfers(6);
+}
+
+static void	test_errors_and_cancel(void)
+{
+	s_done = 0;
+	vector<char> slow_buf, missing_buf, refused_buf;
+
+	double t0 = now();
+	curl_http_get_file * slow = new curl_http_get_file("http://127.0.0.1:8765/slow", &slow_buf, 0.0f, done_cb, NULL);
+	this_thread::sleep_for(chrono::milliseconds(200));
+	delete slow;
+	check(now() - t0 < 1.0, "deleting a running request cancels it");
+
+	curl_http_get_file * missing = new curl_http_get_file("http://127.0.0.1:8765/404", &missing_buf, 0.0f, done_cb, NULL);
+	curl_http_get_file * refused = new curl_http_get_file("http://127.0.0.1:1/x", &refused_buf, 0.0f, done_cb, NULL);
+	wait_done(2);
+	check(!missing->is_ok() && missing->get_error() == 404, "a 404 is reported as error 404");
+	check(!refused->is_ok() && refused->is_net_fail(), "a refused connection is a net failure");
+	delete missing;
+	delete refused;
+
+	curl_http_set_max_transfers(1);
+	vector<vector<char> > bufs(5);
+	vector<curl_http_get_file *> reqs;
+	for(int i = 0; i < 5; ++i)
+		reqs.push_back(new curl_http_get_file(url("q", i), &bufs[i]));
+	for(auto r : reqs)
+		delete r;
+	check(true, "requests deleted while still queued");
+	curl_http_set_max_transfers(6);
+}
+
+int main(int argc, char * argv[])
+{
+	test_concurrency();
+	test_priority();
+	test_errors_and_cancel();
+	return s_failed;
+}
+
+// curl_http pulls these in from the rest of the app.
+FILE *	gLogFile = NULL;
+
+void	__DebugAssertHandler(const char * condition, const char * file, int line)
+{
+	fprintf(stderr, "Debug assert %s (%s:%d)\n", condition, file, line);
+	++s_failed;
+}
+
+#undef fopen
+FILE *	x_fopen(const char * path, const char * mode)
+{
+	return fopen(path, mode);
+}
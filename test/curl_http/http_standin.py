@@ -0,0 +1,31 @@
+# Stand-in HTTP server for curl_http_test.cpp - see howto_test.txt.
+#
+# HTTP/1.1 with keep-alive on 127.0.0.1:8765, one thread per connection.  Every request waits 0.3 s before
+# answering (5 s for paths starting with /slow), so requests that run side by side finish measurably sooner
+# than ones that queue.  /404... answers 404, everything else gets the path repeated 1000 times as its body.
+
+import http.server, socketserver, time
+
+class Handler(http.server.BaseHTTPRequestHandler):
+	protocol_version = "HTTP/1.1"
+
+	def do_GET(self):
+		time.sleep(5 if self.path.startswith('/slow') else 0.3)
+		if self.path.startswith('/404'):
+			self.send_response(404)
+			self.send_header('Content-Length', '0')
+			self.end_headers()
+			return
+		body = (self.path * 1000).encode()
+		self.send_response(200)
+		self.send_header('Content-Length', str(len(body)))
+		self.end_headers()
+		self.wfile.write(body)
+
+	def log_message(self, *args):
+		pass
+
+class Server(socketserver.ThreadingMixIn, http.server.HTTPServer):
+	daemon_threads = True
+
+Server(('127.0.0.1', 8765), Handler).serve_forever()
@@ -0,0 +1,69 @@
+/*
+ *  copy_mip_srgb_test.cpp
+ *
+ *  Checks the fast sRGB mip filter in BitmapUtils.cpp pixel for pixel against the reference filter - see howto_test.txt.
+ *  Exits with the number of image shapes that came out different.
+ *
+ */
+
+// The filters are file-local, so the test compiles them in.
+#include "BitmapUtils.cpp"
+
+#if !SRGB_APPROX_24
+	#error copy_mip_srgb only exists with the gamma 2.4 approximation selected in BitmapUtils.cpp
+#endif
+
+// Compares copy_mip_srgb, with and without SSE2, against copy_mip_with_filter(..., average_with_gamma) for every source
+// size up to 19x19 - odd ones take the fallback or leave a tail for the scalar loop - with 1 to 4 channels, with and
+// without row padding, and filtered as the whole image and as 2 row bands.
+int main(int argc, char * argv[])
+{
+	vector<unsigned char> sbuf, ref, fast;
+	unsigned int seed = 1;
+	int checked = 0, failed = 0;
+
+	for(int ch = 1; ch <= 4; ++ch)
+	for(int pad = 0; pad <= 3; pad += 3)
+	for(int h = 1; h < 20; ++h)
+	for(int w = 1; w < 20; ++w)
+	{
+		ImageInfo src = { NULL, w, h, pad, (short) ch };
+		ImageInfo dst = { NULL, w > 1 ? w / 2 : 1, h > 1 ? h / 2 : 1, pad, (short) ch };
+		int dst_bytes = (dst.width * ch + pad) * dst.height;
+
+		sbuf.resize((w * ch + pad) * h);
+		for(auto& b : sbuf)
+		{
+			seed = seed * 1103515245 + 12345;
+			b = seed >> 16;
+		}
+		src.data = sbuf.data();
+
+		ref.assign(dst_bytes, 0);
+		dst.data = ref.data();
+		copy_mip_with_filter(src, dst, 0, average_with_gamma);
+
+		for(int use_sse = 0; use_sse < 2; ++use_sse)
+		for(int bands = 1; bands <= 2; ++bands)
+		{
+			fast.assign(dst_bytes, 0);
+			dst.data = fast.data();
+			int split = bands == 1 ? dst.height : dst.height / 2;
+			copy_mip_srgb(src, dst, 0, split, use_sse);
+			copy_mip_srgb(src, dst, split, dst.height, use_sse);
+			++checked;
+			if(fast != ref)
+			{
+				printf("FAIL: %dx%d, %d channels, pad %d, %s, %d band(s)\n", w, h, ch, pad, use_sse ? "SSE2" : "scalar", bands);
+				++failed;
+			}
+		}
+	}
+
+#if SRGB_SSE2
+	printf("%d of %d checks matched (scalar and SSE2 paths).\n", checked - failed, checked);
+#else
+	printf("%d of %d checks matched (no SSE2 in this build - scalar path twice).\n", checked - failed, checked);
+#endif
+	return failed;
+}